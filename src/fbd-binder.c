@@ -36,41 +36,819 @@ fbd_binder_reply_status_is_ok (GBinderRemoteReply *reply)
   return fbd_binder_status_is_ok (&reader);
 }
 
+typedef struct {
+  FbdBinderReplyFunc callback;
+  gpointer           user_data;
+} FbdBinderTransaction;
+
+static void
+on_transaction_reply (GBinderClient      *client,
+                      GBinderRemoteReply *reply,
+                      int                 status,
+                      void               *user_data)
+{
+  FbdBinderTransaction *transaction = user_data;
+  gboolean success;
+
+  success = status == GBINDER_STATUS_OK && reply && fbd_binder_reply_status_is_ok (reply);
+  if (transaction->callback)
+    transaction->callback (success, transaction->user_data);
+}
+
+/**
+ * fbd_binder_transact_async:
+ * @client: The client
+ * @code: The transaction code
+ * @req: The request
+ * @callback: (nullable): Invoked with the result of the transaction
+ * @user_data: User data for @callback
+ *
+ * Starts a transaction without waiting for the reply. The transaction
+ * can be cancelled via gbinder_client_cancel() in which case @callback
+ * isn't invoked.
+ *
+ * Returns: The transaction id or `0` on error
+ */
+gulong
+fbd_binder_transact_async (GBinderClient       *client,
+                           guint32              code,
+                           GBinderLocalRequest *req,
+                           FbdBinderReplyFunc   callback,
+                           gpointer             user_data)
+{
+  FbdBinderTransaction *transaction = g_new0 (FbdBinderTransaction, 1);
+
+  transaction->callback = callback;
+  transaction->user_data = user_data;
+
+  return gbinder_client_transact (client, code, 0, req,
+                                  on_transaction_reply,
+                                  g_free,
+                                  transaction);
+}
+
+/**
+ * FbdBinderService:
+ *
+ * A binder service shared by all droid backends
+ *
+ * The service managers for `/dev/binder` and `/dev/hwbinder` are only
+ * opened once per process and services are looked up once and shared
+ * between all users. Lookups of several services can happen in
+ * parallel via fbd_binder_service_resolve_async(). Once the service went
+ * away fbd_binder_service_invalidate() allows to look it up again.
+ *
+ * Lookups never iterate a main context: fbd_binder_service_resolve()
+ * blocks while fbd_binder_service_resolve_async() gets the result in
+ * the main context.
+ *
+ * The registry of services, their lookups and their state changes are
+ * main thread only as the service managers deliver their results in
+ * the default main context. Only transactions and the availability
+ * checks can be used from other threads.
+ *
+ * When the remote dies (e.g. because the HAL restarted)
+ * #FbdBinderService::died is emitted and the service is looked up again
+ * in the background, retrying with exponential backoff until it's back
+ * which is signaled by #FbdBinderService::reconnected. A service that
+ * wasn't found in the first place (e.g. because the HAL is still
+ * starting up) is retried the same way a limited number of times.
+ */
+
+enum {
+  SIGNAL_DIED,
+  SIGNAL_RECONNECTED,
+  N_SIGNALS
+};
+static guint signals[N_SIGNALS];
+
+/* Delay between attempts to look up a service that died */
+#define FBD_BINDER_REBIND_BACKOFF_MIN_MS 10
+#define FBD_BINDER_REBIND_BACKOFF_MAX_MS 5000
+/* How often to look for a service that was never found, about a minute */
+#define FBD_BINDER_LOOKUP_RETRIES_MAX    20
+
+typedef enum {
+  FBD_BINDER_SERVICE_STATE_UNKNOWN,
+  FBD_BINDER_SERVICE_STATE_RESOLVING,
+  FBD_BINDER_SERVICE_STATE_AVAILABLE,
+  FBD_BINDER_SERVICE_STATE_MISSING,
+} FbdBinderServiceState;
+
+struct _FbdBinderService {
+  GObject                parent;
+
+  char                  *device;
+  char                  *iface;
+  char                  *fqname;
+  GBinderServiceManager *service_manager;
+  gulong                 resolve_id;
+  gulong                 death_id;
+  gboolean               rebind;
+  guint                  rebind_id;
+  guint                  backoff_ms;
+  gboolean               found;      /* was available at least once */
+  guint                  n_retries;  /* lookups since the first one failed */
+
+  /* Protected by mutex as transactions can happen in io workers */
+  GMutex                 mutex;
+  FbdBinderServiceState  state;
+  GBinderRemoteObject   *remote;
+  GBinderClient         *client;
+
+  GList                 *tasks;  /* Pending fbd_binder_service_resolve_async() */
+};
+
+G_DEFINE_TYPE (FbdBinderService, fbd_binder_service, G_TYPE_OBJECT)
+
+/* Service managers by device, kept for the lifetime of the process */
+static GHashTable *service_managers;
+/* Services by fqname, entries are dropped once the service goes away */
+static GHashTable *services;
+/* The thread using the above, see fbd_binder_is_main_thread() */
+static GThread *main_thread;
+
+
+/* The registry isn't locked so only the main thread may use it */
+static gboolean
+fbd_binder_is_main_thread (void)
+{
+  if (main_thread == NULL)
+    main_thread = g_thread_self ();
+
+  return main_thread == g_thread_self ();
+}
+
+
+static GBinderServiceManager *
+get_service_manager (const char *device)
+{
+  GBinderServiceManager *service_manager;
+
+  if (service_managers == NULL) {
+    service_managers = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                              (GDestroyNotify) gbinder_servicemanager_unref);
+  }
+
+  service_manager = g_hash_table_lookup (service_managers, device);
+  if (service_manager == NULL) {
+    service_manager = gbinder_servicemanager_new (device);
+    if (service_manager == NULL) {
+      g_warning ("Failed to init servicemanager on %s", device);
+      return NULL;
+    }
+    g_hash_table_insert (service_managers, g_strdup (device), service_manager);
+  }
+
+  return gbinder_servicemanager_ref (service_manager);
+}
+
+
+static void fbd_binder_service_start_resolve (FbdBinderService *self);
+
+
+/* Completes pending asynchronous lookups */
+static void
+fbd_binder_service_complete_tasks (FbdBinderService *self)
+{
+  GList *tasks = g_steal_pointer (&self->tasks);
+
+  for (GList *l = tasks; l; l = l->next) {
+    GTask *task = G_TASK (l->data);
+    GSource *timeout = g_task_get_task_data (task);
+
+    g_source_destroy (timeout);
+    if (g_task_return_error_if_cancelled (task))
+      continue;
+
+    if (self->state == FBD_BINDER_SERVICE_STATE_AVAILABLE) {
+      g_task_return_boolean (task, TRUE);
+    } else {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                               "Failed to get hal service remote for %s", self->fqname);
+    }
+  }
+  g_list_free_full (tasks, g_object_unref);
+}
+
+
+static gboolean
+on_rebind_timeout (gpointer user_data)
+{
+  FbdBinderService *self = FBD_BINDER_SERVICE (user_data);
+
+  self->rebind_id = 0;
+
+  g_mutex_lock (&self->mutex);
+  self->state = FBD_BINDER_SERVICE_STATE_UNKNOWN;
+  g_mutex_unlock (&self->mutex);
+
+  g_debug ("Looking up %s again", self->fqname);
+  fbd_binder_service_start_resolve (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+
+static void
+fbd_binder_service_lookup_failed (FbdBinderService *self)
+{
+  g_mutex_lock (&self->mutex);
+  self->state = FBD_BINDER_SERVICE_STATE_MISSING;
+  g_mutex_unlock (&self->mutex);
+
+  fbd_binder_service_complete_tasks (self);
+
+  if (self->rebind_id)
+    return;
+
+  /* Keep looking for a service that didn't show up yet */
+  if (!self->rebind) {
+    if (self->found || self->n_retries >= FBD_BINDER_LOOKUP_RETRIES_MAX)
+      return;
+    if (self->n_retries == 0)
+      self->backoff_ms = FBD_BINDER_REBIND_BACKOFF_MIN_MS;
+    self->n_retries++;
+  }
+
+  self->rebind_id = g_timeout_add (self->backoff_ms, on_rebind_timeout, self);
+  g_source_set_name_by_id (self->rebind_id, "[feedbackd] binder rebind");
+  self->backoff_ms = MIN (self->backoff_ms * 2, FBD_BINDER_REBIND_BACKOFF_MAX_MS);
+}
+
+
+static void
+on_remote_died (GBinderRemoteObject *remote, void *user_data)
+{
+  FbdBinderService *self = FBD_BINDER_SERVICE (user_data);
+
+  g_warning ("%s died, reconnecting", self->fqname);
+
+  fbd_binder_service_invalidate (self);
+  self->rebind = TRUE;
+  self->backoff_ms = FBD_BINDER_REBIND_BACKOFF_MIN_MS;
+  g_signal_emit (self, signals[SIGNAL_DIED], 0);
+
+  fbd_binder_service_start_resolve (self);
+}
+
+
+static void
+fbd_binder_service_set_remote (FbdBinderService *self, GBinderRemoteObject *remote)
+{
+  GBinderClient *client, *old_client;
+  GBinderRemoteObject *old_remote;
+
+  client = gbinder_client_new (remote, self->iface);
+  if (client == NULL) {
+    g_warning ("Failed to get hal service client for %s", self->iface);
+    fbd_binder_service_lookup_failed (self);
+    return;
+  }
+
+  if (self->death_id) {
+    gbinder_remote_object_remove_handler (self->remote, self->death_id);
+    self->death_id = 0;
+  }
+  self->death_id = gbinder_remote_object_add_death_handler (remote, on_remote_died, self);
+
+  g_mutex_lock (&self->mutex);
+  old_remote = self->remote;
+  old_client = self->client;
+  self->remote = gbinder_remote_object_ref (remote);
+  self->client = client;
+  self->state = FBD_BINDER_SERVICE_STATE_AVAILABLE;
+  g_mutex_unlock (&self->mutex);
+
+  if (old_client)
+    gbinder_client_unref (old_client);
+  if (old_remote)
+    gbinder_remote_object_unref (old_remote);
+
+  fbd_binder_service_complete_tasks (self);
+
+  self->found = TRUE;
+  if (self->rebind || self->n_retries) {
+    g_message ("%s %s", self->rebind ? "Reconnected to" : "Found", self->fqname);
+    self->rebind = FALSE;
+    self->n_retries = 0;
+    g_signal_emit (self, signals[SIGNAL_RECONNECTED], 0);
+  }
+}
+
+
+static void
+on_get_service (GBinderServiceManager *service_manager,
+                GBinderRemoteObject   *remote,
+                int                    status,
+                void                  *user_data)
+{
+  FbdBinderService *self = FBD_BINDER_SERVICE (user_data);
+
+  self->resolve_id = 0;
+
+  if (remote == NULL) {
+    g_debug ("Service %s not available: %d", self->fqname, status);
+    fbd_binder_service_lookup_failed (self);
+    return;
+  }
+
+  g_debug ("Resolved %s", self->fqname);
+  fbd_binder_service_set_remote (self, remote);
+}
+
+
+static void
+fbd_binder_service_start_resolve (FbdBinderService *self)
+{
+  if (self->state != FBD_BINDER_SERVICE_STATE_UNKNOWN)
+    return;
+
+  if (self->service_manager) {
+    self->resolve_id = gbinder_servicemanager_get_service (self->service_manager,
+                                                           self->fqname,
+                                                           on_get_service,
+                                                           self);
+  }
+
+  if (self->resolve_id == 0) {
+    fbd_binder_service_lookup_failed (self);
+    return;
+  }
+
+  g_mutex_lock (&self->mutex);
+  self->state = FBD_BINDER_SERVICE_STATE_RESOLVING;
+  g_mutex_unlock (&self->mutex);
+}
+
+
+static void
+fbd_binder_service_cancel_resolve (FbdBinderService *self)
+{
+  if (self->resolve_id == 0)
+    return;
+
+  gbinder_servicemanager_cancel (self->service_manager, self->resolve_id);
+  self->resolve_id = 0;
+}
+
+
+static void
+fbd_binder_service_finalize (GObject *object)
+{
+  FbdBinderService *self = FBD_BINDER_SERVICE (object);
+
+  if (services && g_hash_table_lookup (services, self->fqname) == self)
+    g_hash_table_remove (services, self->fqname);
+
+  fbd_binder_service_cancel_resolve (self);
+  g_clear_handle_id (&self->rebind_id, g_source_remove);
+  if (self->death_id)
+    gbinder_remote_object_remove_handler (self->remote, self->death_id);
+  g_clear_pointer (&self->client, gbinder_client_unref);
+  g_clear_pointer (&self->remote, gbinder_remote_object_unref);
+  g_clear_pointer (&self->service_manager, gbinder_servicemanager_unref);
+  g_mutex_clear (&self->mutex);
+
+  g_free (self->device);
+  g_free (self->iface);
+  g_free (self->fqname);
+
+  G_OBJECT_CLASS (fbd_binder_service_parent_class)->finalize (object);
+}
+
+
+static void
+fbd_binder_service_class_init (FbdBinderServiceClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = fbd_binder_service_finalize;
+
+  /**
+   * FbdBinderService::died:
+   *
+   * Emitted when the service's remote died. Transactions fail until
+   * #FbdBinderService::reconnected got emitted.
+   */
+  signals[SIGNAL_DIED] =
+    g_signal_new ("died",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+                  NULL,
+                  G_TYPE_NONE,
+                  0);
+
+  /**
+   * FbdBinderService::reconnected:
+   *
+   * Emitted when the service is available again after it died or
+   * when it showed up after the first lookup failed.
+   */
+  signals[SIGNAL_RECONNECTED] =
+    g_signal_new ("reconnected",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+                  NULL,
+                  G_TYPE_NONE,
+                  0);
+}
+
+
+static void
+fbd_binder_service_init (FbdBinderService *self)
+{
+  g_mutex_init (&self->mutex);
+}
+
+/**
+ * fbd_binder_service_get:
+ * @device: The binder device
+ * @iface: The interface name
+ * @fqname: The fully qualified service name
+ *
+ * Gets the shared service object for @fqname. The service isn't looked
+ * up yet, use fbd_binder_service_resolve() for that. This must be called
+ * from the main thread.
+ *
+ * Returns:(transfer full): The service
+ */
+FbdBinderService *
+fbd_binder_service_get (const char *device,
+                        const char *iface,
+                        const char *fqname)
+{
+  FbdBinderService *self;
+
+  g_return_val_if_fail (device, NULL);
+  g_return_val_if_fail (iface, NULL);
+  g_return_val_if_fail (fqname, NULL);
+  g_return_val_if_fail (fbd_binder_is_main_thread (), NULL);
+
+  if (services == NULL)
+    services = g_hash_table_new (g_str_hash, g_str_equal);
+
+  self = g_hash_table_lookup (services, fqname);
+  if (self) {
+    g_return_val_if_fail (g_str_equal (self->device, device), NULL);
+    return g_object_ref (self);
+  }
+
+  self = g_object_new (FBD_TYPE_BINDER_SERVICE, NULL);
+  self->device = g_strdup (device);
+  self->iface = g_strdup (iface);
+  self->fqname = g_strdup (fqname);
+  self->service_manager = get_service_manager (device);
+  g_hash_table_insert (services, self->fqname, self);
+
+  return self;
+}
+
+
+/* Looks up the service in the calling thread */
+static void
+fbd_binder_service_resolve_sync (FbdBinderService *self)
+{
+  GBinderRemoteObject *remote = NULL;
+  int status = 0;
+
+  /* Don't wait for a lookup in flight, that would need a main loop */
+  if (self->state == FBD_BINDER_SERVICE_STATE_RESOLVING) {
+    fbd_binder_service_cancel_resolve (self);
+    g_mutex_lock (&self->mutex);
+    self->state = FBD_BINDER_SERVICE_STATE_UNKNOWN;
+    g_mutex_unlock (&self->mutex);
+  }
+
+  if (self->state != FBD_BINDER_SERVICE_STATE_UNKNOWN)
+    return;
+
+  /* The remote is owned by the service manager, set_remote takes a ref */
+  if (self->service_manager)
+    remote = gbinder_servicemanager_get_service_sync (self->service_manager, self->fqname, &status);
+
+  if (remote == NULL) {
+    g_debug ("Service %s not available: %d", self->fqname, status);
+    fbd_binder_service_lookup_failed (self);
+    return;
+  }
+
+  g_debug ("Resolved %s", self->fqname);
+  fbd_binder_service_set_remote (self, remote);
+}
+
+/**
+ * fbd_binder_services_resolve:
+ * @services: The services to look up
+ * @n_services: The number of services
+ *
+ * Looks up all @services one after another blocking the main thread
+ * but without iterating any main context. Services that were already
+ * looked up aren't looked up again. Prefer
+ * fbd_binder_service_resolve_async() once the main loop runs. This
+ * must be called from the main thread.
+ *
+ * Returns: %TRUE if at least one of the services is available
+ */
 gboolean
-fbd_binder_init (char                   *device,
-                 char                   *iface,
-                 char                   *fqname,
-                 GBinderServiceManager **service_manager,
-                 GBinderRemoteObject   **remote,
-                 GBinderClient         **client)
+fbd_binder_services_resolve (FbdBinderService **services,
+                             guint              n_services)
 {
+  gboolean available = FALSE;
 
+  g_return_val_if_fail (fbd_binder_is_main_thread (), FALSE);
 
-  *service_manager = gbinder_servicemanager_new (device);
-  if (!*service_manager) {
-    g_warning ("Failed to init servicemanager on %s", device);
-    return FALSE;
+  for (guint i = 0; i < n_services; i++) {
+    fbd_binder_service_resolve_sync (services[i]);
+
+    if (services[i]->state == FBD_BINDER_SERVICE_STATE_AVAILABLE)
+      available = TRUE;
   }
-  
-  *remote = gbinder_servicemanager_get_service_sync (*service_manager,
-                                                     fqname, NULL);
-  if (!*remote) {
-    g_warning ("Failed to get hal service remote for %s", fqname);
-    g_clear_object (&*service_manager);
-    *service_manager = NULL;
+
+  return available;
+}
+
+/**
+ * fbd_binder_service_resolve:
+ * @self: The service
+ * @error: Return location for an error
+ *
+ * Looks up the service unless that happened already. See
+ * fbd_binder_services_resolve().
+ *
+ * Returns: %TRUE if the service is available
+ */
+gboolean
+fbd_binder_service_resolve (FbdBinderService  *self,
+                            GError           **error)
+{
+  g_return_val_if_fail (FBD_IS_BINDER_SERVICE (self), FALSE);
+
+  if (!fbd_binder_services_resolve (&self, 1)) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                 "Failed to get hal service remote for %s", self->fqname);
     return FALSE;
   }
-  
-  *client = gbinder_client_new (*remote, iface);
-  if (!*client) {
-    g_warning ("Failed to get hal service client for %s", iface);
-    g_clear_object (&*remote);
-    g_clear_object (&*service_manager);
-    return FALSE;
+
+  return TRUE;
+}
+
+
+static gboolean
+on_resolve_task_timeout (gpointer user_data)
+{
+  GTask *task = G_TASK (user_data);
+  FbdBinderService *self = g_task_get_source_object (task);
+
+  if (self->state == FBD_BINDER_SERVICE_STATE_RESOLVING) {
+    g_warning ("Timed out looking up %s", self->fqname);
+    fbd_binder_service_cancel_resolve (self);
+    fbd_binder_service_lookup_failed (self);
   }
 
-  /* Ensure we keep a reference on the remote */
-  gbinder_remote_object_ref (*remote);
+  return G_SOURCE_REMOVE;
+}
 
-  return TRUE;
+/**
+ * fbd_binder_service_resolve_async:
+ * @self: The service
+ * @timeout_ms: How long to wait for the service to show up
+ * @cancellable: (nullable): A cancellable
+ * @callback: Invoked once the service was looked up
+ * @user_data: User data for @callback
+ *
+ * Looks up the service unless that happened already without blocking.
+ * Lookups of different services run in parallel.
+ */
+void
+fbd_binder_service_resolve_async (FbdBinderService    *self,
+                                  guint                timeout_ms,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data)
+{
+  g_autoptr (GTask) task = NULL;
+  GSource *timeout;
+
+  g_return_if_fail (FBD_IS_BINDER_SERVICE (self));
+  g_return_if_fail (fbd_binder_is_main_thread ());
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, fbd_binder_service_resolve_async);
+
+  fbd_binder_service_start_resolve (self);
+  if (self->state == FBD_BINDER_SERVICE_STATE_AVAILABLE) {
+    g_task_return_boolean (task, TRUE);
+    return;
+  } else if (self->state != FBD_BINDER_SERVICE_STATE_RESOLVING) {
+    g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                             "Failed to get hal service remote for %s", self->fqname);
+    return;
+  }
+
+  timeout = g_timeout_source_new (timeout_ms);
+  g_task_set_task_data (task, g_source_ref (timeout), (GDestroyNotify) g_source_unref);
+  g_task_attach_source (task, timeout, on_resolve_task_timeout);
+  g_source_unref (timeout);
+
+  self->tasks = g_list_prepend (self->tasks, g_steal_pointer (&task));
+}
+
+
+gboolean
+fbd_binder_service_resolve_finish (FbdBinderService  *self,
+                                   GAsyncResult      *res,
+                                   GError           **error)
+{
+  g_return_val_if_fail (FBD_IS_BINDER_SERVICE (self), FALSE);
+  g_return_val_if_fail (g_task_is_valid (res, self), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+/**
+ * fbd_binder_service_invalidate:
+ * @self: The service
+ *
+ * Marks the service as gone (e.g. because the HAL restarted) so the
+ * next call to fbd_binder_service_resolve() looks it up again. This
+ * must be called from the main thread.
+ */
+void
+fbd_binder_service_invalidate (FbdBinderService *self)
+{
+  g_return_if_fail (FBD_IS_BINDER_SERVICE (self));
+  g_return_if_fail (fbd_binder_is_main_thread ());
+
+  fbd_binder_service_cancel_resolve (self);
+  g_clear_handle_id (&self->rebind_id, g_source_remove);
+
+  /* Keep the client around so pending transactions can still be cancelled */
+  g_mutex_lock (&self->mutex);
+  self->state = FBD_BINDER_SERVICE_STATE_UNKNOWN;
+  g_mutex_unlock (&self->mutex);
+}
+
+
+/**
+ * fbd_binder_service_is_available:
+ * @self: The service
+ *
+ * Whether transactions can currently be sent to the service. This can
+ * be called from any thread.
+ *
+ * Returns: %TRUE if the service is available
+ */
+gboolean
+fbd_binder_service_is_available (FbdBinderService *self)
+{
+  gboolean available;
+
+  g_return_val_if_fail (FBD_IS_BINDER_SERVICE (self), FALSE);
+
+  g_mutex_lock (&self->mutex);
+  available = self->state == FBD_BINDER_SERVICE_STATE_AVAILABLE;
+  g_mutex_unlock (&self->mutex);
+
+  return available;
+}
+
+
+GBinderServiceManager *
+fbd_binder_service_get_service_manager (FbdBinderService *self)
+{
+  g_return_val_if_fail (FBD_IS_BINDER_SERVICE (self), NULL);
+
+  return self->service_manager;
+}
+
+/**
+ * fbd_binder_service_dup_client:
+ * @self: The service
+ *
+ * Gets the client to talk to the service. This can be called from any
+ * thread.
+ *
+ * Returns:(transfer full)(nullable): The client or %NULL if the service
+ *    isn't available
+ */
+GBinderClient *
+fbd_binder_service_dup_client (FbdBinderService *self)
+{
+  GBinderClient *client = NULL;
+
+  g_return_val_if_fail (FBD_IS_BINDER_SERVICE (self), NULL);
+
+  g_mutex_lock (&self->mutex);
+  if (self->state == FBD_BINDER_SERVICE_STATE_AVAILABLE)
+    client = gbinder_client_ref (self->client);
+  g_mutex_unlock (&self->mutex);
+
+  return client;
+}
+
+/**
+ * fbd_binder_service_new_request:
+ * @self: The service
+ *
+ * Returns:(transfer full)(nullable): A new request or %NULL if the
+ *    service isn't available
+ */
+GBinderLocalRequest *
+fbd_binder_service_new_request (FbdBinderService *self)
+{
+  GBinderClient *client = fbd_binder_service_dup_client (self);
+  GBinderLocalRequest *req;
+
+  if (client == NULL)
+    return NULL;
+
+  req = gbinder_client_new_request (client);
+  gbinder_client_unref (client);
+
+  return req;
+}
+
+/**
+ * fbd_binder_service_transact_sync:
+ * @self: The service
+ * @code: The transaction code
+ * @req: The request
+ * @status: Return location for the transaction status
+ *
+ * Like gbinder_client_transact_sync_reply() but using the service's
+ * current client.
+ *
+ * Returns:(transfer full)(nullable): The reply
+ */
+GBinderRemoteReply *
+fbd_binder_service_transact_sync (FbdBinderService    *self,
+                                  guint32              code,
+                                  GBinderLocalRequest *req,
+                                  int                 *status)
+{
+  GBinderClient *client = fbd_binder_service_dup_client (self);
+  GBinderRemoteReply *reply;
+
+  if (client == NULL) {
+    *status = GBINDER_STATUS_DEAD_OBJECT;
+    return NULL;
+  }
+
+  reply = gbinder_client_transact_sync_reply (client, code, req, status);
+  gbinder_client_unref (client);
+
+  return reply;
+}
+
+/**
+ * fbd_binder_service_transact_async:
+ * @self: The service
+ * @code: The transaction code
+ * @req: The request
+ * @callback: (nullable): Invoked with the result of the transaction
+ * @user_data: User data for @callback
+ *
+ * Like fbd_binder_transact_async() but using the service's current
+ * client.
+ *
+ * Returns: The transaction id or `0` on error
+ */
+gulong
+fbd_binder_service_transact_async (FbdBinderService    *self,
+                                   guint32              code,
+                                   GBinderLocalRequest *req,
+                                   FbdBinderReplyFunc   callback,
+                                   gpointer             user_data)
+{
+  GBinderClient *client = fbd_binder_service_dup_client (self);
+  gulong id;
+
+  if (client == NULL)
+    return 0;
+
+  id = fbd_binder_transact_async (client, code, req, callback, user_data);
+  gbinder_client_unref (client);
+
+  return id;
+}
+
+/**
+ * fbd_binder_service_cancel:
+ * @self: The service
+ * @id: The transaction id
+ *
+ * Cancels a transaction started via
+ * fbd_binder_service_transact_async().
+ */
+void
+fbd_binder_service_cancel (FbdBinderService *self, gulong id)
+{
+  g_return_if_fail (FBD_IS_BINDER_SERVICE (self));
+
+  g_mutex_lock (&self->mutex);
+  /* Transaction ids are per binder device so any client will do */
+  if (self->client)
+    gbinder_client_cancel (self->client, id);
+  g_mutex_unlock (&self->mutex);
 }
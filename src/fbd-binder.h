@@ -6,7 +6,7 @@
 
 #pragma once
 
-#include <glib.h>
+#include <gio/gio.h>
 #include <gbinder.h>
 
 G_BEGIN_DECLS
@@ -20,13 +20,61 @@ enum BinderStability {
   BINDER_STABILITY_VINTF  = 0b111111,
 };
 
-gboolean fbd_binder_init (char                   *device,
-                          char                   *iface,
-                          char                   *fqname,
-                          GBinderServiceManager **service_manager,
-                          GBinderRemoteObject   **remote,
-                          GBinderClient         **client);
 gboolean fbd_binder_status_is_ok (GBinderReader *reader);
 gboolean fbd_binder_reply_status_is_ok (GBinderRemoteReply *reply);
 
+/**
+ * FbdBinderReplyFunc:
+ * @success: Whether the transaction succeeded and the reply's status is ok
+ * @user_data: The user data passed to fbd_binder_transact_async()
+ *
+ * Invoked in the main context once the reply arrived.
+ */
+typedef void (*FbdBinderReplyFunc) (gboolean success, gpointer user_data);
+
+gulong   fbd_binder_transact_async (GBinderClient       *client,
+                                    guint32              code,
+                                    GBinderLocalRequest *req,
+                                    FbdBinderReplyFunc   callback,
+                                    gpointer             user_data);
+
+/* How long to wait for a service to show up */
+#define FBD_BINDER_RESOLVE_TIMEOUT_MS 2000
+
+#define FBD_TYPE_BINDER_SERVICE (fbd_binder_service_get_type ())
+
+G_DECLARE_FINAL_TYPE (FbdBinderService, fbd_binder_service, FBD, BINDER_SERVICE, GObject)
+
+FbdBinderService      *fbd_binder_service_get                  (const char          *device,
+                                                                const char          *iface,
+                                                                const char          *fqname);
+gboolean               fbd_binder_services_resolve             (FbdBinderService   **services,
+                                                                guint                n_services);
+gboolean               fbd_binder_service_resolve              (FbdBinderService    *self,
+                                                                GError             **error);
+void                   fbd_binder_service_resolve_async        (FbdBinderService    *self,
+                                                                guint                timeout_ms,
+                                                                GCancellable        *cancellable,
+                                                                GAsyncReadyCallback  callback,
+                                                                gpointer             user_data);
+gboolean               fbd_binder_service_resolve_finish       (FbdBinderService    *self,
+                                                                GAsyncResult        *res,
+                                                                GError             **error);
+void                   fbd_binder_service_invalidate           (FbdBinderService    *self);
+gboolean               fbd_binder_service_is_available         (FbdBinderService    *self);
+GBinderServiceManager *fbd_binder_service_get_service_manager  (FbdBinderService    *self);
+GBinderClient         *fbd_binder_service_dup_client           (FbdBinderService    *self);
+GBinderLocalRequest   *fbd_binder_service_new_request          (FbdBinderService    *self);
+GBinderRemoteReply    *fbd_binder_service_transact_sync        (FbdBinderService    *self,
+                                                                guint32              code,
+                                                                GBinderLocalRequest *req,
+                                                                int                 *status);
+gulong                 fbd_binder_service_transact_async       (FbdBinderService    *self,
+                                                                guint32              code,
+                                                                GBinderLocalRequest *req,
+                                                                FbdBinderReplyFunc   callback,
+                                                                gpointer             user_data);
+void                   fbd_binder_service_cancel               (FbdBinderService    *self,
+                                                                gulong               id);
+
 G_END_DECLS
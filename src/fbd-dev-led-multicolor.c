@@ -96,7 +96,6 @@ fbd_dev_led_multicolor_set_color (FbdDevLed           *led,
 {
   FbdDevLedMulticolor *self = FBD_DEV_LED_MULTICOLOR (led);
   FbdDevLedMulticolorPrivate *priv = fbd_dev_led_multicolor_get_instance_private (self);
-  GUdevDevice *dev = fbd_dev_led_get_device (led);
   g_autofree char *intensity = NULL;
   g_autoptr (GError) err = NULL;
   gboolean success = FALSE;
@@ -139,10 +138,7 @@ fbd_dev_led_multicolor_set_color (FbdDevLed           *led,
   g_debug ("Multicolor intensity: %s", intensity);
 
   fbd_dev_led_set_brightness (led, max_brightness);
-  success = fbd_udev_set_sysfs_path_attr_as_string (dev,
-                                                    LED_MULTI_INTENSITY_ATTR,
-                                                    intensity,
-                                                    &err);
+  success = fbd_dev_led_set_attr (led, LED_MULTI_INTENSITY_ATTR, intensity, &err);
   if (!success) {
     g_warning ("Failed to set multi intensity: %s", err->message);
     return FALSE;
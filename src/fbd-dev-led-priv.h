@@ -18,5 +18,9 @@ G_BEGIN_DECLS
 GUdevDevice      *fbd_dev_led_get_device  (FbdDevLed *led);
 void              fbd_dev_led_set_max_brightness (FbdDevLed *led, guint max_brightness);
 void              fbd_dev_led_set_supported_color (FbdDevLed *led, FbdFeedbackLedColor color);
+gboolean          fbd_dev_led_set_attr (FbdDevLed   *led,
+                                        const char  *attr,
+                                        const char  *value,
+                                        GError     **error);
 
 G_END_DECLS
@@ -17,6 +17,33 @@
 
 #define LED_BRIGHTNESS_ATTR      "brightness"
 #define LED_PATTERN_ATTR         "pattern"
+#define LED_HW_PATTERN_ATTR      "hw_pattern"
+#define LED_REPEAT_ATTR          "repeat"
+#define LED_REPEAT_INFINITY      "-1"
+#define LED_DRIVER_PROP          "DRIVER"
+
+/* The pattern trigger doesn't ramp between entries shorter than 50ms */
+static const FbdLedPatternLimits pattern_limits = {
+  .max_entries = 1024,
+  .min_duration_ms = 50,
+};
+
+/*
+ * The format of the hw_pattern attribute is driver specific. Drivers
+ * listed here take `brightness duration` pairs within the given limits.
+ */
+typedef struct {
+  const char          *driver;
+  FbdLedPatternLimits  limits;
+} FbdDevLedHwPattern;
+
+static const FbdDevLedHwPattern hw_patterns[] = {
+  /*
+   * The QCOM LPG steps through its lookup table at a fixed rate of at
+   * most 511ms per entry. 24 brightness values reliably fit into the table.
+   */
+  { "qcom-spmi-lpg", { .max_entries = 24, .max_duration_ms = 511, .hold = TRUE } },
+};
 
 enum {
   PROP_0,
@@ -35,6 +62,18 @@ typedef struct _FbdDevLedPrivate {
   guint               max_brightness;
 
   FbdFeedbackLedColor color;
+  /* The driver's hw_pattern limits, NULL if patterns run in software */
+  const FbdDevLedHwPattern *hw_pattern;
+
+  /* Key: attribute name, value: FbdUdevAttr */
+  GHashTable         *attrs;
+
+  /* Shadow state of what the LED was programmed to show last */
+  gboolean            shown_color_valid;
+  FbdFeedbackLedColor shown_color;
+  FbdLedRgbColor      shown_rgb;
+  gboolean            shown_has_rgb;
+  GArray             *shown_blinks;
 } FbdDevLedPrivate;
 
 
@@ -44,6 +83,22 @@ G_DEFINE_TYPE_WITH_CODE (FbdDevLed, fbd_dev_led, G_TYPE_OBJECT,
                          G_ADD_PRIVATE (FbdDevLed)
                          G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, initable_iface_init))
 
+static FbdUdevAttr *
+fbd_dev_led_lookup_attr (FbdDevLed *led, const char *name)
+{
+  FbdDevLedPrivate *priv = fbd_dev_led_get_instance_private (led);
+  FbdUdevAttr *attr;
+
+  attr = g_hash_table_lookup (priv->attrs, name);
+  if (attr == NULL) {
+    attr = fbd_udev_attr_new (priv->dev, name);
+    g_hash_table_insert (priv->attrs, g_strdup (name), attr);
+  }
+
+  return attr;
+}
+
+
 static gboolean
 fbd_dev_led_probe_default (FbdDevLed *led, GError **error)
 {
@@ -109,29 +164,223 @@ fbd_dev_led_supports_color_default (FbdDevLed           *led,
 }
 
 
+static const FbdDevLedHwPattern *
+fbd_dev_led_find_hw_pattern (GUdevDevice *dev)
+{
+  g_autoptr (GUdevDevice) parent = NULL;
+
+  if (g_udev_device_get_sysfs_attr_as_strv (dev, LED_HW_PATTERN_ATTR) == NULL)
+    return NULL;
+
+  /* The driver is bound to one of the LED's parents */
+  parent = g_object_ref (dev);
+  do {
+    g_autoptr (GUdevDevice) next = NULL;
+    const char *driver = g_udev_device_get_property (parent, LED_DRIVER_PROP);
+
+    for (int i = 0; driver && i < G_N_ELEMENTS (hw_patterns); i++) {
+      if (g_str_equal (driver, hw_patterns[i].driver))
+        return &hw_patterns[i];
+    }
+
+    next = g_udev_device_get_parent (parent);
+    g_set_object (&parent, next);
+  } while (parent);
+
+  g_debug ("Driver of %s has unknown hw_pattern format", g_udev_device_get_name (dev));
+  return NULL;
+}
+
+/* The half period of a simple blink in ms */
+static guint
+fbd_dev_led_get_blink_time (const FbdLedPatternLimits *limits, const FbdDevLedBlink *blink)
+{
+  /*  ms     mHz           T/2 */
+  gdouble t = 1000.0 * 1000.0 / blink->freq / 2.0;
+
+  if (limits->max_duration_ms && t > limits->max_duration_ms)
+    t = limits->max_duration_ms;
+
+  return t;
+}
+
+/* Concatenates the blinks, each one rendered on its own */
+static char *
+fbd_dev_led_render_blinks_concat (FbdDevLed                 *led,
+                                  const FbdLedPatternLimits *limits,
+                                  const FbdDevLedBlink      *blinks,
+                                  guint                      n_blinks)
+{
+  FbdDevLedPrivate *priv = fbd_dev_led_get_instance_private (led);
+  g_autoptr (GString) str = g_string_new (NULL);
+
+  for (guint i = 0; i < n_blinks; i++) {
+    const char *rendered = NULL;
+    gdouble max;
+    gint t;
+
+    if (i)
+      g_string_append_c (str, ' ');
+
+    max = priv->max_brightness * (blinks[i].max_brightness_percentage / 100.0);
+    if (blinks[i].pattern)
+      rendered = fbd_led_pattern_render (blinks[i].pattern, limits, max);
+    if (rendered) {
+      g_string_append (str, rendered);
+      continue;
+    }
+
+    t = fbd_dev_led_get_blink_time (limits, &blinks[i]);
+    if (limits->hold)
+      g_string_append_printf (str, "0 %d 0 0 %d %d %d 0", t, (gint)max, t, (gint)max);
+    else
+      g_string_append_printf (str, "0 %d %d %d", t, (gint)max, t);
+    g_debug ("Freq %d mHz, Brightness: %d%%", blinks[i].freq, blinks[i].max_brightness_percentage);
+  }
+
+  /* The limit applies to the whole pattern, not to each blink */
+  if (limits->max_entries && !limits->hold) {
+    guint n_entries = 1;
+
+    for (const char *c = str->str; *c; c++) {
+      if (*c == ' ')
+        n_entries++;
+    }
+    n_entries /= 2;
+
+    if (n_entries > limits->max_entries) {
+      g_debug ("Blinks need %u entries, driver supports %u", n_entries, limits->max_entries);
+      return NULL;
+    }
+  }
+
+  return g_string_free (g_steal_pointer (&str), FALSE);
+}
+
+/*
+ * Hardware holding values needs a single time step for the whole
+ * pattern so render the blinks as one sequence.
+ */
+static char *
+fbd_dev_led_render_blinks_hold (FbdDevLed                 *led,
+                                const FbdLedPatternLimits *limits,
+                                const FbdDevLedBlink      *blinks,
+                                guint                      n_blinks)
+{
+  FbdDevLedPrivate *priv = fbd_dev_led_get_instance_private (led);
+  g_autoptr (GPtrArray) patterns = NULL;
+  g_autofree guint *max = g_new0 (guint, n_blinks);
+
+  patterns = g_ptr_array_new_with_free_func ((GDestroyNotify) fbd_led_pattern_unref);
+
+  for (guint i = 0; i < n_blinks; i++) {
+    FbdLedPattern *pattern = blinks[i].pattern;
+
+    max[i] = priv->max_brightness * (blinks[i].max_brightness_percentage / 100.0);
+    if (pattern) {
+      fbd_led_pattern_ref (pattern);
+    } else {
+      g_autofree char *desc = NULL;
+      guint t = fbd_dev_led_get_blink_time (limits, &blinks[i]);
+
+      desc = g_strdup_printf ("0 %u 100 %u", t, t);
+      pattern = fbd_led_pattern_new_from_string (desc, FBD_LED_PATTERN_CURVE_STEP, NULL);
+      g_return_val_if_fail (pattern, NULL);
+    }
+    g_ptr_array_add (patterns, pattern);
+  }
+
+  return fbd_led_pattern_render_sequence ((FbdLedPattern **) patterns->pdata, max, n_blinks,
+                                          limits);
+}
+
+/*
+ * Renders the blinks as `brightness duration` pairs within the given
+ * limits. If they don't fit only the top priority one is shown.
+ */
+static char *
+fbd_dev_led_render_blinks (FbdDevLed                 *led,
+                           const FbdLedPatternLimits *limits,
+                           const FbdDevLedBlink      *blinks,
+                           guint                      n_blinks)
+{
+  g_autofree char *pattern = NULL;
+
+  for (guint i = 0; i < n_blinks; i++)
+    g_return_val_if_fail (blinks[i].max_brightness_percentage <= 100, NULL);
+
+  if (limits->hold && n_blinks > 1)
+    pattern = fbd_dev_led_render_blinks_hold (led, limits, blinks, n_blinks);
+  else
+    pattern = fbd_dev_led_render_blinks_concat (led, limits, blinks, n_blinks);
+
+  if (pattern == NULL) {
+    if (n_blinks < 2)
+      return NULL;
+
+    g_debug ("%u blinks don't fit into one pattern, showing the top one only", n_blinks);
+    return fbd_dev_led_render_blinks (led, limits, blinks, 1);
+  }
+
+  return g_strconcat (pattern, "\n", NULL);
+}
+
+
+static gboolean
+fbd_dev_led_start_hw_pattern (FbdDevLed            *led,
+                              const FbdDevLedBlink *blinks,
+                              guint                 n_blinks)
+{
+  FbdDevLedPrivate *priv = fbd_dev_led_get_instance_private (led);
+  g_autoptr (GError) err = NULL;
+  g_autofree char *pattern = NULL;
+
+  pattern = fbd_dev_led_render_blinks (led, &priv->hw_pattern->limits, blinks, n_blinks);
+  if (pattern == NULL)
+    return FALSE;
+
+  if (!fbd_dev_led_set_attr (led, LED_REPEAT_ATTR, LED_REPEAT_INFINITY, &err)) {
+    g_warning ("Failed to set LED repeat: %s", err->message);
+    return FALSE;
+  }
+
+  if (!fbd_dev_led_set_attr (led, LED_HW_PATTERN_ATTR, pattern, &err)) {
+    g_warning ("Failed to set LED hw_pattern: %s", err->message);
+    return FALSE;
+  }
+
+  g_debug ("Blink pattern: %s, HW: yes", pattern);
+  return TRUE;
+}
+
+
 static gboolean
-fbd_dev_led_start_periodic_default (FbdDevLed *led,
-                                    guint      max_brightness_percentage,
-                                    guint      freq)
+fbd_dev_led_start_pattern_default (FbdDevLed            *led,
+                                   const FbdDevLedBlink *blinks,
+                                   guint                 n_blinks)
 {
   FbdDevLedPrivate *priv;
   g_autoptr (GError) err = NULL;
-  g_autofree gchar *str = NULL;
+  g_autofree char *pattern = NULL;
   gboolean success = FALSE;
-  gdouble max;
-  gdouble t;
 
   g_return_val_if_fail (FBD_IS_DEV_LED (led), FALSE);
-  g_return_val_if_fail (max_brightness_percentage <= 100, FALSE);
   priv = fbd_dev_led_get_instance_private (led);
 
-  max =  priv->max_brightness * (max_brightness_percentage / 100.0);
-  /*  ms     mHz           T/2 */
-  t = 1000.0 * 1000.0 / freq / 2.0;
-  str = g_strdup_printf ("0 %d %d %d\n", (gint)t, (gint)max, (gint)t);
-  g_debug ("Freq %d mHz, Brightness: %d%%, Blink pattern: %s", freq, max_brightness_percentage, str);
+  if (priv->hw_pattern) {
+    if (fbd_dev_led_start_hw_pattern (led, blinks, n_blinks))
+      return TRUE;
 
-  success = fbd_udev_set_sysfs_path_attr_as_string (priv->dev, LED_PATTERN_ATTR, str, &err);
+    g_warning ("Falling back to software pattern");
+  }
+
+  pattern = fbd_dev_led_render_blinks (led, &pattern_limits, blinks, n_blinks);
+  if (pattern == NULL)
+    return FALSE;
+
+  g_debug ("Blink pattern: %s", pattern);
+
+  success = fbd_dev_led_set_attr (led, LED_PATTERN_ATTR, pattern, &err);
   if (!success)
     g_warning ("Failed to set led pattern: %s", err->message);
 
@@ -139,6 +388,35 @@ fbd_dev_led_start_periodic_default (FbdDevLed *led,
 }
 
 
+static void
+clear_blink (FbdDevLedBlink *blink)
+{
+  g_clear_pointer (&blink->pattern, fbd_led_pattern_unref);
+}
+
+
+static gboolean
+fbd_dev_led_shows_blinks (FbdDevLed *led, const FbdDevLedBlink *blinks, guint n_blinks)
+{
+  FbdDevLedPrivate *priv = fbd_dev_led_get_instance_private (led);
+
+  if (priv->shown_blinks->len != n_blinks)
+    return FALSE;
+
+  for (guint i = 0; i < n_blinks; i++) {
+    FbdDevLedBlink *shown = &g_array_index (priv->shown_blinks, FbdDevLedBlink, i);
+
+    if (shown->max_brightness_percentage != blinks[i].max_brightness_percentage ||
+        shown->freq != blinks[i].freq ||
+        shown->pattern != blinks[i].pattern) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+
 static void
 fbd_dev_led_set_property (GObject      *object,
                           guint         property_id,
@@ -186,6 +464,8 @@ fbd_dev_led_finalize (GObject *object)
   FbdDevLedPrivate *priv = fbd_dev_led_get_instance_private (self);
 
   g_clear_object (&priv->dev);
+  g_clear_pointer (&priv->attrs, g_hash_table_destroy);
+  g_clear_pointer (&priv->shown_blinks, g_array_unref);
 
   G_OBJECT_CLASS (fbd_dev_led_parent_class)->finalize (object);
 }
@@ -197,8 +477,17 @@ initable_init (GInitable    *initable,
                GError      **error)
 {
   FbdDevLedClass *fbd_dev_led_class = FBD_DEV_LED_GET_CLASS (initable);
+  FbdDevLed *led = FBD_DEV_LED (initable);
+  FbdDevLedPrivate *priv = fbd_dev_led_get_instance_private (led);
+
+  if (!fbd_dev_led_class->probe (led, error))
+    return FALSE;
+
+  priv->hw_pattern = fbd_dev_led_find_hw_pattern (priv->dev);
+  if (priv->hw_pattern)
+    g_debug ("Using hw_pattern of %s driver", priv->hw_pattern->driver);
 
-  return fbd_dev_led_class->probe (FBD_DEV_LED (initable), error);
+  return TRUE;
 }
 
 
@@ -220,7 +509,7 @@ fbd_dev_led_class_init (FbdDevLedClass *klass)
   object_class->finalize = fbd_dev_led_finalize;
 
   fbd_dev_led_class->probe = fbd_dev_led_probe_default;
-  fbd_dev_led_class->start_periodic = fbd_dev_led_start_periodic_default;
+  fbd_dev_led_class->start_pattern = fbd_dev_led_start_pattern_default;
   fbd_dev_led_class->set_color = fbd_dev_led_set_color_default;
   fbd_dev_led_class->supports_color = fbd_dev_led_supports_color_default;
 
@@ -236,6 +525,12 @@ fbd_dev_led_class_init (FbdDevLedClass *klass)
 static void
 fbd_dev_led_init (FbdDevLed *self)
 {
+  FbdDevLedPrivate *priv = fbd_dev_led_get_instance_private (self);
+
+  priv->attrs = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                       g_free, (GDestroyNotify) fbd_udev_attr_free);
+  priv->shown_blinks = g_array_new (FALSE, FALSE, sizeof (FbdDevLedBlink));
+  g_array_set_clear_func (priv->shown_blinks, (GDestroyNotify) clear_blink);
 }
 
 
@@ -250,16 +545,33 @@ gboolean
 fbd_dev_led_set_brightness (FbdDevLed *led, guint brightness)
 {
   FbdDevLedPrivate *priv;
+  FbdUdevAttr *attr;
   g_autoptr (GError) err = NULL;
 
   g_return_val_if_fail (FBD_IS_DEV_LED (led), FALSE);
   priv = fbd_dev_led_get_instance_private (led);
 
-  if (!fbd_udev_set_sysfs_path_attr_as_int (priv->dev, LED_BRIGHTNESS_ATTR, brightness, &err)) {
+  attr = fbd_dev_led_lookup_attr (led, LED_BRIGHTNESS_ATTR);
+  if (!fbd_udev_attr_set_int (attr, brightness, &err)) {
     g_warning ("Failed to setup brightness: %s", err->message);
     return FALSE;
   }
 
+  /* Turning the LED off removes its trigger and with it the pattern */
+  if (brightness == 0) {
+    GHashTableIter iter;
+    FbdUdevAttr *other;
+
+    priv->shown_color_valid = FALSE;
+    g_array_set_size (priv->shown_blinks, 0);
+
+    g_hash_table_iter_init (&iter, priv->attrs);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&other)) {
+      if (other != attr)
+        fbd_udev_attr_invalidate (other);
+    }
+  }
+
   return TRUE;
 }
 
@@ -268,25 +580,92 @@ gboolean
 fbd_dev_led_start_periodic (FbdDevLed *led,
                             guint      max_brightness_percentage,
                             guint      freq)
+{
+  FbdDevLedBlink blink = { max_brightness_percentage, freq };
+
+  return fbd_dev_led_start_pattern (led, &blink, 1);
+}
+
+/**
+ * fbd_dev_led_start_pattern:
+ * @led: The LED
+ * @blinks: (array length=n_blinks): The blinks making up the pattern
+ * @n_blinks: The number of blinks
+ *
+ * Repeatedly plays the given blinks one after another. The whole
+ * pattern is written to the LED at once. If the LED already plays
+ * these blinks nothing is written so the pattern isn't restarted.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+fbd_dev_led_start_pattern (FbdDevLed            *led,
+                           const FbdDevLedBlink *blinks,
+                           guint                 n_blinks)
 {
   FbdDevLedClass *fbd_dev_led_class = FBD_DEV_LED_GET_CLASS (led);
+  FbdDevLedPrivate *priv;
 
   g_return_val_if_fail (FBD_IS_DEV_LED (led), FALSE);
+  g_return_val_if_fail (blinks && n_blinks, FALSE);
+  priv = fbd_dev_led_get_instance_private (led);
+
+  if (fbd_dev_led_shows_blinks (led, blinks, n_blinks)) {
+    g_debug ("LED pattern unchanged");
+    return TRUE;
+  }
 
-  return fbd_dev_led_class->start_periodic (led, max_brightness_percentage, freq);
+  g_array_set_size (priv->shown_blinks, 0);
+  if (!fbd_dev_led_class->start_pattern (led, blinks, n_blinks))
+    return FALSE;
+
+  for (guint i = 0; i < n_blinks; i++) {
+    FbdDevLedBlink blink = blinks[i];
+
+    if (blink.pattern)
+      fbd_led_pattern_ref (blink.pattern);
+    g_array_append_val (priv->shown_blinks, blink);
+  }
+
+  return TRUE;
 }
 
 
+/**
+ * fbd_dev_led_set_color:
+ * @led: The LED
+ * @color: The color to show
+ * @rgb: (nullable): The RGB value for %FBD_FEEDBACK_LED_COLOR_RGB
+ *
+ * Sets the LED's color. Setting the color the LED already shows is
+ * a no-op.
+ *
+ * Returns: %TRUE on success
+ */
 gboolean
 fbd_dev_led_set_color (FbdDevLed           *led,
                        FbdFeedbackLedColor  color,
                        FbdLedRgbColor      *rgb)
 {
   FbdDevLedClass *fbd_dev_led_class = FBD_DEV_LED_GET_CLASS (led);
+  FbdDevLedPrivate *priv;
 
   g_return_val_if_fail (FBD_IS_DEV_LED (led), FALSE);
+  priv = fbd_dev_led_get_instance_private (led);
+
+  if (priv->shown_color_valid && priv->shown_color == color &&
+      priv->shown_has_rgb == !!rgb &&
+      (!rgb || memcmp (&priv->shown_rgb, rgb, sizeof (FbdLedRgbColor)) == 0)) {
+    return TRUE;
+  }
+
+  priv->shown_color_valid = fbd_dev_led_class->set_color (led, color, rgb);
+  priv->shown_color = color;
+  priv->shown_has_rgb = !!rgb;
+  if (rgb)
+    priv->shown_rgb = *rgb;
 
-  return fbd_dev_led_class->set_color (led, color, rgb);
+  return priv->shown_color_valid;
 }
 
 
@@ -314,6 +693,33 @@ fbd_dev_led_get_max_brightness (FbdDevLed *led)
 
 /* Functions for derived classes */
 
+/**
+ * fbd_dev_led_set_attr:
+ * @led: The LED
+ * @attr: The sysfs attribute
+ * @value: The value to write
+ * @error: Return location for an error
+ *
+ * Writes @value to the LED's sysfs attribute @attr. Writing the value
+ * that was written last is a no-op.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+fbd_dev_led_set_attr (FbdDevLed *led, const char *attr, const char *value, GError **error)
+{
+  g_return_val_if_fail (FBD_IS_DEV_LED (led), FALSE);
+
+  if (!fbd_udev_attr_set_string (fbd_dev_led_lookup_attr (led, attr), value, error))
+    return FALSE;
+
+  /* Patterns change the brightness behind our back */
+  fbd_udev_attr_invalidate (fbd_dev_led_lookup_attr (led, LED_BRIGHTNESS_ATTR));
+
+  return TRUE;
+}
+
+
 GUdevDevice *
 fbd_dev_led_get_device (FbdDevLed *led)
 {
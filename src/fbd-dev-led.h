@@ -6,6 +6,7 @@
 #pragma once
 
 #include "fbd-feedback-led.h"
+#include "fbd-led-pattern.h"
 
 #include <gudev/gudev.h>
 
@@ -17,6 +18,21 @@ G_BEGIN_DECLS
 
 G_DECLARE_DERIVABLE_TYPE (FbdDevLed, fbd_dev_led, FBD, DEV_LED, GObject)
 
+/**
+ * FbdDevLedBlink:
+ * @max_brightness_percentage: The max brightness (in percent) of the blink
+ * @freq: The blink frequency in mHz
+ * @pattern: (nullable): A pattern to play instead of a periodic blink
+ *
+ * A single blink of a LED pattern. Patterns consisting of several
+ * blinks play them one after another.
+ */
+typedef struct {
+  guint          max_brightness_percentage;
+  guint          freq;
+  FbdLedPattern *pattern;
+} FbdDevLedBlink;
+
 FbdDevLed          *fbd_dev_led_new  (GUdevDevice *dev, GError **err);
 gboolean            fbd_dev_led_set_brightness (FbdDevLed *led, guint brightness);
 guint               fbd_dev_led_get_max_brightness (FbdDevLed *led);
@@ -26,15 +42,18 @@ gboolean            fbd_dev_led_set_color (FbdDevLed           *led,
 gboolean            fbd_dev_led_start_periodic (FbdDevLed      *led,
                                                 guint           max_brightness_percentage,
                                                 guint           freq);
+gboolean            fbd_dev_led_start_pattern (FbdDevLed            *led,
+                                               const FbdDevLedBlink *blinks,
+                                               guint                 n_blinks);
 gboolean            fbd_dev_led_supports_color (FbdDevLed *led, FbdFeedbackLedColor color);
 
 struct _FbdDevLedClass {
   GObjectClass parent_class;
 
   gboolean (*probe)          (FbdDevLed            *led, GError **error);
-  gboolean (*start_periodic) (FbdDevLed           *led,
-                              guint                max_brightness_percentage,
-                              guint                freq);
+  gboolean (*start_pattern)  (FbdDevLed            *led,
+                              const FbdDevLedBlink *blinks,
+                              guint                 n_blinks);
   gboolean (*set_color)      (FbdDevLed            *led,
                               FbdFeedbackLedColor   color,
                               FbdLedRgbColor       *rgb);
@@ -11,43 +11,84 @@
 #include "fbd.h"
 #include "fbd-enums.h"
 #include "fbd-dev-led.h"
+#include "fbd-dev-led-priv.h"
 #include "fbd-dev-led-flash.h"
 #include "fbd-dev-led-multicolor.h"
-#include "fbd-dev-led-qcom.h"
-#include "fbd-dev-led-qcom-multicolor.h"
 #include "fbd-dev-leds.h"
 #include "fbd-feedback-led.h"
+#include "fbd-io-worker.h"
 #include "fbd-udev.h"
 
 #include <gio/gio.h>
 
 #define LED_SUBSYSTEM            "leds"
+#define N_LED_COLORS             (FBD_FEEDBACK_LED_COLOR_FLASH + 1)
+/* Max number of claims combined into a LED's pattern */
+#define MAX_COMPOSITE_BLINKS     4
 
 /**
  * FbdDevLeds:
  *
  * LED device interface
  *
- * #FbdDevLeds is used to interface with all LEDs detected in sysfs
- * It currently only supports one pattern per led at a time.
+ * #FbdDevLeds is used to interface with all LEDs detected in sysfs.
+ * Feedbacks claim a LED color via fbd_dev_leds_claim(). All claims
+ * ending up on the same LED are combined into a single pattern that
+ * plays their blinks one after another, ordered by priority. The most
+ * important claim determines the LED's color, on a multicolor LED claims
+ * in another color are left out. The sysfs writes happen
+ * in an #FbdIoWorker, a newer state for a LED supersedes a not yet
+ * applied one. Which LED shows which color is determined once when the
+ * set of LEDs changes. LEDs showing up or going away later on are
+ * picked up via udev events.
  */
 typedef struct _FbdDevLeds {
   GObject      parent;
 
   GUdevClient *client;
+  FbdIoWorker *worker;
+
+  /* Guards against uevents while initializing in a thread */
+  GMutex       mutex;
   GSList      *leds;
+
+  /* The LED used for each color, owned by leds */
+  FbdDevLed   *routes[N_LED_COLORS];
+  /* Bitmask of colors that have a LED */
+  guint        available;
+
+  /* Active claims, most important first */
+  GPtrArray   *claims;
 } FbdDevLeds;
 
+typedef struct {
+  gconstpointer       owner;
+  guint               priority;
+  FbdFeedbackLedColor color;
+  FbdLedRgbColor      rgb;
+  gboolean            has_rgb;
+  FbdDevLedBlink      blink;
+} FbdDevLedsClaim;
+
+typedef struct {
+  FbdDevLed          *led;
+  FbdFeedbackLedColor color;
+  FbdLedRgbColor      rgb;
+  gboolean            has_rgb;
+  FbdDevLedBlink      blinks[MAX_COMPOSITE_BLINKS];
+  guint               n_blinks;  /* 0 turns the LED off */
+} FbdDevLedsCmd;
+
 static void initable_iface_init (GInitableIface *iface);
 
+/* Asynchronous initialization runs the #GInitable implementation in a thread */
 G_DEFINE_TYPE_WITH_CODE (FbdDevLeds, fbd_dev_leds, G_TYPE_OBJECT,
-                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, initable_iface_init));
+                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, initable_iface_init)
+                         G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_INITABLE, NULL));
 
 static FbdDevLed *
 find_led_by_color (FbdDevLeds *self, FbdFeedbackLedColor color)
 {
-  g_return_val_if_fail (self->leds, NULL);
-
   for (GSList *l = self->leds; l != NULL; l = l->next) {
     FbdDevLed *led = FBD_DEV_LED (l->data);
     if (fbd_dev_led_supports_color (led, color))
@@ -65,24 +106,166 @@ find_led_by_color (FbdDevLeds *self, FbdFeedbackLedColor color)
   return NULL;
 }
 
+/* Must be invoked whenever the list of LEDs changes */
+static void
+fbd_dev_leds_update_routes (FbdDevLeds *self)
+{
+  self->available = 0;
 
-static FbdDevLed*
-probe_led (GUdevDevice *dev, GError **error) {
-  FbdDevLed *led = NULL;
+  for (int i = 0; i < N_LED_COLORS; i++) {
+    self->routes[i] = find_led_by_color (self, i);
+    if (self->routes[i])
+      self->available |= 1 << i;
+  }
+}
 
-  led = fbd_dev_led_qcom_multicolor_new (dev, error);
-  if (led != NULL) {
-    g_debug ("Discovered QCOM multicolor LED");
-    return led;
+
+static FbdDevLed *
+fbd_dev_leds_lookup (FbdDevLeds *self, FbdFeedbackLedColor color)
+{
+  g_return_val_if_fail (color < N_LED_COLORS, NULL);
+
+  return self->routes[color];
+}
+
+
+static void
+fbd_dev_leds_claim_free (FbdDevLedsClaim *claim)
+{
+  g_clear_pointer (&claim->blink.pattern, fbd_led_pattern_unref);
+  g_free (claim);
+}
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FbdDevLedsClaim, fbd_dev_leds_claim_free)
+
+
+static void
+fbd_dev_leds_cmd_free (FbdDevLedsCmd *cmd)
+{
+  for (guint i = 0; i < cmd->n_blinks; i++)
+    g_clear_pointer (&cmd->blinks[i].pattern, fbd_led_pattern_unref);
+  g_object_unref (cmd->led);
+  g_free (cmd);
+}
+
+/* Runs in the io worker's thread */
+static gboolean
+fbd_dev_leds_run_cmd (gpointer data, GError **error)
+{
+  FbdDevLedsCmd *cmd = data;
+
+  if (cmd->n_blinks == 0)
+    return fbd_dev_led_set_brightness (cmd->led, 0);
+
+  fbd_dev_led_set_color (cmd->led, cmd->color, cmd->has_rgb ? &cmd->rgb : NULL);
+  return fbd_dev_led_start_pattern (cmd->led, cmd->blinks, cmd->n_blinks);
+}
+
+
+static void
+on_cmd_done (gpointer data, const GError *error)
+{
+  if (error && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    g_debug ("LED state superseded");
+  /* Other failures were already reported by the LED */
+}
+
+
+static void
+fbd_dev_leds_push_cmd (FbdDevLeds *self, FbdDevLedsCmd *cmd)
+{
+  fbd_io_worker_push (self->worker,
+                      cmd->led,
+                      fbd_dev_leds_run_cmd,
+                      on_cmd_done,
+                      cmd,
+                      (GDestroyNotify) fbd_dev_leds_cmd_free);
+}
+
+
+/* Whether @led shows @claim in the same color as @top */
+static gboolean
+fbd_dev_leds_claim_matches (FbdDevLed *led, FbdDevLedsClaim *top, FbdDevLedsClaim *claim)
+{
+  /* A single color LED shows all claims in its color anyway */
+  if (!FBD_IS_DEV_LED_MULTICOLOR (led))
+    return TRUE;
+
+  if (claim->color != top->color || claim->has_rgb != top->has_rgb)
+    return FALSE;
+
+  return !claim->has_rgb || (claim->rgb.r == top->rgb.r &&
+                             claim->rgb.g == top->rgb.g &&
+                             claim->rgb.b == top->rgb.b);
+}
+
+
+/*
+ * Combines the claims shown on @led into one pattern. Claims the LED
+ * would show in another color than the most important one are left
+ * out rather than shown in the wrong color.
+ */
+static void
+fbd_dev_leds_render (FbdDevLeds *self, FbdDevLed *led)
+{
+  FbdDevLedsClaim *top = NULL;
+  FbdDevLedsCmd *cmd;
+
+  cmd = g_new0 (FbdDevLedsCmd, 1);
+  cmd->led = g_object_ref (led);
+
+  for (guint i = 0; i < self->claims->len; i++) {
+    FbdDevLedsClaim *claim = g_ptr_array_index (self->claims, i);
+
+    if (fbd_dev_leds_lookup (self, claim->color) != led)
+      continue;
+
+    if (top == NULL) {
+      top = claim;
+      cmd->color = claim->color;
+      cmd->rgb = claim->rgb;
+      cmd->has_rgb = claim->has_rgb;
+    } else if (!fbd_dev_leds_claim_matches (led, top, claim)) {
+      continue;
+    }
+
+    cmd->blinks[cmd->n_blinks] = claim->blink;
+    if (claim->blink.pattern)
+      fbd_led_pattern_ref (claim->blink.pattern);
+    cmd->n_blinks++;
+    if (cmd->n_blinks == MAX_COMPOSITE_BLINKS)
+      break;
   }
-  g_clear_error (error);
 
-  led = fbd_dev_led_qcom_new (dev, error);
-  if (led != NULL) {
-    g_debug ("Discovered QCOM single color LED");
-    return led;
+  g_debug ("Combined %u claims into LED pattern", cmd->n_blinks);
+  fbd_dev_leds_push_cmd (self, cmd);
+}
+
+
+static void
+fbd_dev_leds_render_all (FbdDevLeds *self)
+{
+  for (GSList *l = self->leds; l != NULL; l = l->next)
+    fbd_dev_leds_render (self, FBD_DEV_LED (l->data));
+}
+
+
+static FbdDevLedsClaim *
+fbd_dev_leds_steal_claim (FbdDevLeds *self, gconstpointer owner)
+{
+  for (guint i = 0; i < self->claims->len; i++) {
+    FbdDevLedsClaim *claim = g_ptr_array_index (self->claims, i);
+
+    if (claim->owner == owner)
+      return g_ptr_array_steal_index (self->claims, i);
   }
-  g_clear_error (error);
+
+  return NULL;
+}
+
+
+static FbdDevLed*
+probe_led (GUdevDevice *dev, GError **error) {
+  FbdDevLed *led = NULL;
 
   led = fbd_dev_led_multicolor_new (dev, error);
   if (led != NULL) {
@@ -109,47 +292,133 @@ probe_led (GUdevDevice *dev, GError **error) {
 }
 
 
+static GSList *
+find_led_by_path (FbdDevLeds *self, const char *sysfs_path)
+{
+  for (GSList *l = self->leds; l != NULL; l = l->next) {
+    GUdevDevice *dev = fbd_dev_led_get_device (FBD_DEV_LED (l->data));
+
+    if (g_strcmp0 (g_udev_device_get_sysfs_path (dev), sysfs_path) == 0)
+      return l;
+  }
+
+  return NULL;
+}
+
+
 static gboolean
-initable_init (GInitable    *initable,
-               GCancellable *cancellable,
-               GError      **error)
+fbd_dev_leds_remove_device (FbdDevLeds *self, GUdevDevice *dev)
 {
-  const gchar * const subsystems[] = { LED_SUBSYSTEM, NULL };
-  FbdDevLeds *self = FBD_DEV_LEDS (initable);
-  g_autolist (GUdevDevice) leds = NULL;
-  gboolean found = FALSE;
+  GSList *link;
 
-  self->client = g_udev_client_new (subsystems);
+  link = find_led_by_path (self, g_udev_device_get_sysfs_path (dev));
+  if (link == NULL)
+    return FALSE;
 
-  leds = g_udev_client_query_by_subsystem (self->client, LED_SUBSYSTEM);
+  g_debug ("LED %s removed", g_udev_device_get_sysfs_path (dev));
+  g_object_unref (link->data);
+  self->leds = g_slist_delete_link (self->leds, link);
 
-  for (GList *l = leds; l != NULL; l = l->next) {
-    g_autoptr (GError) err = NULL;
-    GUdevDevice *dev = G_UDEV_DEVICE (l->data);
-    FbdDevLed *led;
+  return TRUE;
+}
 
-    if (g_strcmp0 (g_udev_device_get_property (dev, FEEDBACKD_UDEV_ATTR),
-                   FEEDBACKD_UDEV_VAL_LED)) {
-      continue;
-    }
 
+/*
+ * Adds the LED backed by @dev or replaces the LED we already know about.
+ * Devices that aren't (or no longer are) usable LEDs are dropped.
+ *
+ * Returns: %TRUE if the set of LEDs changed
+ */
+static gboolean
+fbd_dev_leds_add_device (FbdDevLeds *self, GUdevDevice *dev)
+{
+  g_autoptr (GError) err = NULL;
+  FbdDevLed *led = NULL;
+  GSList *link;
+
+  link = find_led_by_path (self, g_udev_device_get_sysfs_path (dev));
+
+  if (g_strcmp0 (g_udev_device_get_property (dev, FEEDBACKD_UDEV_ATTR),
+                 FEEDBACKD_UDEV_VAL_LED) == 0) {
     led = probe_led (dev, &err);
+  }
 
-    if (led) {
-      self->leds = g_slist_append (self->leds, led);
-      found = TRUE;
-    }
+  if (link && led) {
+    g_object_unref (link->data);
+    link->data = led;
+  } else if (link) {
+    fbd_dev_leds_remove_device (self, dev);
+  } else if (led) {
+    self->leds = g_slist_append (self->leds, led);
+  } else {
+    return FALSE;
   }
 
-  /* TODO: listen for new leds via udev events */
+  return TRUE;
+}
+
 
-  if (!found) {
-    g_set_error (error,
-                 G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                 "No usable LEDs found");
+static void
+on_uevent (FbdDevLeds  *self,
+           const char  *action,
+           GUdevDevice *dev,
+           GUdevClient *client)
+{
+  gboolean changed = FALSE;
+
+  g_debug ("LED uevent: '%s' for %s", action, g_udev_device_get_sysfs_path (dev));
+
+  g_mutex_lock (&self->mutex);
+  if (g_strcmp0 (action, "remove") == 0) {
+    changed = fbd_dev_leds_remove_device (self, dev);
+  } else if (g_strcmp0 (action, "add") == 0) {
+    changed = fbd_dev_leds_add_device (self, dev);
+  } else if (g_strcmp0 (action, "change") == 0) {
+    /* Trigger changes are caused by ourselves when (un)setting patterns */
+    if (g_udev_device_get_property (dev, "TRIGGER") == NULL ||
+        find_led_by_path (self, g_udev_device_get_sysfs_path (dev)) == NULL) {
+      changed = fbd_dev_leds_add_device (self, dev);
+    }
   }
 
-  return found;
+  if (changed) {
+    fbd_dev_leds_update_routes (self);
+    /* Claims might have moved to another LED */
+    fbd_dev_leds_render_all (self);
+  }
+  g_mutex_unlock (&self->mutex);
+}
+
+
+static gboolean
+initable_init (GInitable    *initable,
+               GCancellable *cancellable,
+               GError      **error)
+{
+  FbdDevLeds *self = FBD_DEV_LEDS (initable);
+  g_autoptr (GUdevClient) client = NULL;
+  g_autolist (GUdevDevice) leds = NULL;
+
+  /*
+   * This can run in a thread while self->client's monitor is dispatched
+   * in the main context. libudev isn't thread safe so enumerate via a
+   * separate client.
+   */
+  client = g_udev_client_new (NULL);
+  leds = g_udev_client_query_by_subsystem (client, LED_SUBSYSTEM);
+
+  g_mutex_lock (&self->mutex);
+  /* LEDs might already have been added via uevents so go via add_device */
+  for (GList *l = leds; l != NULL; l = l->next)
+    fbd_dev_leds_add_device (self, G_UDEV_DEVICE (l->data));
+
+  fbd_dev_leds_update_routes (self);
+
+  if (self->leds == NULL)
+    g_debug ("No usable LEDs found yet");
+  g_mutex_unlock (&self->mutex);
+
+  return TRUE;
 }
 
 static void
@@ -163,24 +432,52 @@ fbd_dev_leds_dispose (GObject *object)
 {
   FbdDevLeds *self = FBD_DEV_LEDS (object);
 
+  g_clear_object (&self->worker);
+  if (self->client)
+    g_signal_handlers_disconnect_by_data (self->client, self);
   g_clear_object (&self->client);
   g_slist_free_full (self->leds, (GDestroyNotify)g_object_unref);
   self->leds = NULL;
+  fbd_dev_leds_update_routes (self);
+  g_clear_pointer (&self->claims, g_ptr_array_unref);
 
   G_OBJECT_CLASS (fbd_dev_leds_parent_class)->dispose (object);
 }
 
+static void
+fbd_dev_leds_finalize (GObject *object)
+{
+  FbdDevLeds *self = FBD_DEV_LEDS (object);
+
+  g_mutex_clear (&self->mutex);
+
+  G_OBJECT_CLASS (fbd_dev_leds_parent_class)->finalize (object);
+}
+
 static void
 fbd_dev_leds_class_init (FbdDevLedsClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
   object_class->dispose = fbd_dev_leds_dispose;
+  object_class->finalize = fbd_dev_leds_finalize;
 }
 
 static void
 fbd_dev_leds_init (FbdDevLeds *self)
 {
+  const gchar * const subsystems[] = { LED_SUBSYSTEM, NULL };
+
+  g_mutex_init (&self->mutex);
+  self->worker = fbd_io_worker_new ("fbd-leds-io");
+  self->claims = g_ptr_array_new_with_free_func ((GDestroyNotify) fbd_dev_leds_claim_free);
+
+  /*
+   * Created here so uevents are delivered to the constructing thread's
+   * main context. Only used for uevents, see initable_init().
+   */
+  self->client = g_udev_client_new (subsystems);
+  g_signal_connect_swapped (self->client, "uevent", G_CALLBACK (on_uevent), self);
 }
 
 FbdDevLeds *
@@ -192,52 +489,138 @@ fbd_dev_leds_new (GError **error)
                                        NULL));
 }
 
+void
+fbd_dev_leds_new_async (GCancellable        *cancellable,
+                        GAsyncReadyCallback  callback,
+                        gpointer             user_data)
+{
+  g_async_initable_new_async (FBD_TYPE_DEV_LEDS,
+                              G_PRIORITY_DEFAULT,
+                              cancellable,
+                              callback,
+                              user_data,
+                              NULL);
+}
+
+FbdDevLeds *
+fbd_dev_leds_new_finish (GAsyncResult *res, GError **error)
+{
+  g_autoptr (GObject) source = g_async_result_get_source_object (res);
+  GObject *object;
+
+  object = g_async_initable_new_finish (G_ASYNC_INITABLE (source), res, error);
+  if (object == NULL)
+    return NULL;
+
+  return FBD_DEV_LEDS (object);
+}
+
 /**
- * fbd_dev_leds_start_periodic:
+ * fbd_dev_leds_claim:
  * @self: The #FbdDevLeds
+ * @owner: The owner of the claim
+ * @priority: The claim's priority, higher values are more important
  * @color: The color LED to use for the LED pattern
- * @rgb: The rgb value to set (if `color` indicates an RGB led)
+ * @rgb: (nullable): The rgb value to set (if `color` indicates an RGB led)
  * @max_brightness_percentage: The max brightness (in percent) to use for the pattern
  * @freq: The pattern's frequency in mHz
+ * @pattern: (nullable): A pattern to show instead of periodic blinking
+ *
+ * Claim a LED to show periodic feedback. Claiming again with the same
+ * @owner replaces the former claim. The claim is combined with the
+ * other claims shown by the same LED in the same color and the LED is
+ * updated asynchronously.
  *
- * Start periodic feedback.
+ * Returns: %TRUE if a LED to show the pattern was found
  */
 gboolean
-fbd_dev_leds_start_periodic (FbdDevLeds          *self,
-                             FbdFeedbackLedColor  color,
-                             FbdLedRgbColor      *rgb,
-                             guint                max_brightness_percentage,
-                             guint                freq)
+fbd_dev_leds_claim (FbdDevLeds          *self,
+                    gconstpointer        owner,
+                    guint                priority,
+                    FbdFeedbackLedColor  color,
+                    FbdLedRgbColor      *rgb,
+                    guint                max_brightness_percentage,
+                    guint                freq,
+                    FbdLedPattern       *pattern)
 {
-  FbdDevLed *led;
+  g_autoptr (FbdDevLedsClaim) old = NULL;
+  FbdDevLedsClaim *claim;
+  FbdDevLed *led, *old_led = NULL;
+  guint i;
 
   g_return_val_if_fail (FBD_IS_DEV_LEDS (self), FALSE);
+  g_return_val_if_fail (owner, FALSE);
   g_return_val_if_fail (max_brightness_percentage <= 100.0, FALSE);
-  led = find_led_by_color (self, color);
+  g_return_val_if_fail (freq > 0, FALSE);
+
+  old = fbd_dev_leds_steal_claim (self, owner);
+  if (old)
+    old_led = fbd_dev_leds_lookup (self, old->color);
+
+  claim = g_new0 (FbdDevLedsClaim, 1);
+  claim->owner = owner;
+  claim->priority = priority;
+  claim->color = color;
+  if (rgb) {
+    claim->rgb = *rgb;
+    claim->has_rgb = TRUE;
+  }
+  claim->blink.max_brightness_percentage = max_brightness_percentage;
+  claim->blink.freq = freq;
+  if (pattern)
+    claim->blink.pattern = fbd_led_pattern_ref (pattern);
+
+  /* Keep claims of the same priority in the order they were made */
+  for (i = 0; i < self->claims->len; i++) {
+    FbdDevLedsClaim *other = g_ptr_array_index (self->claims, i);
+
+    if (other->priority < priority)
+      break;
+  }
+  g_ptr_array_insert (self->claims, i, claim);
+
+  if (old_led)
+    fbd_dev_leds_render (self, old_led);
+
+  led = fbd_dev_leds_lookup (self, color);
   if (!led) {
     g_warning_once ("No usable led found");
     return FALSE;
   }
 
-  fbd_dev_led_set_color (led, color, rgb);
+  if (led != old_led)
+    fbd_dev_leds_render (self, led);
 
-  return fbd_dev_led_start_periodic (led, max_brightness_percentage, freq);
+  return TRUE;
 }
 
+/**
+ * fbd_dev_leds_release:
+ * @self: The #FbdDevLeds
+ * @owner: The owner of the claim
+ *
+ * Drops @owner's claim. The LED keeps showing the remaining claims or
+ * is turned off if there are none.
+ *
+ * Returns: %TRUE if @owner had a claim
+ */
 gboolean
-fbd_dev_leds_stop (FbdDevLeds *self, FbdFeedbackLedColor color)
+fbd_dev_leds_release (FbdDevLeds *self, gconstpointer owner)
 {
+  g_autoptr (FbdDevLedsClaim) claim = NULL;
   FbdDevLed *led;
 
   g_return_val_if_fail (FBD_IS_DEV_LEDS (self), FALSE);
 
-  led = find_led_by_color (self, color);
-  if (!led) {
-    g_warning_once ("No usable led found");
+  claim = fbd_dev_leds_steal_claim (self, owner);
+  if (claim == NULL)
     return FALSE;
-  }
 
-  return fbd_dev_led_set_brightness (led, 0);
+  led = fbd_dev_leds_lookup (self, claim->color);
+  if (led)
+    fbd_dev_leds_render (self, led);
+
+  return TRUE;
 }
 
 /**
@@ -253,6 +636,22 @@ gboolean
 fbd_dev_leds_has_led (FbdDevLeds *self, FbdFeedbackLedColor color)
 {
   g_return_val_if_fail (FBD_IS_DEV_LEDS (self), FALSE);
+  g_return_val_if_fail (color < N_LED_COLORS, FALSE);
+
+  return !!(self->available & (1 << color));
+}
+
+/**
+ * fbd_dev_leds_flush:
+ * @self: The LEDs
+ *
+ * Blocks until all queued LED states were applied. This is mostly
+ * useful for tests and benchmarks.
+ */
+void
+fbd_dev_leds_flush (FbdDevLeds *self)
+{
+  g_return_if_fail (FBD_IS_DEV_LEDS (self));
 
-  return !!find_led_by_color (self, color);
+  fbd_io_worker_flush (self->worker);
 }
@@ -6,9 +6,10 @@
 #pragma once
 
 #include "fbd-feedback-led.h"
+#include "fbd-led-pattern.h"
 #include "fbd-udev.h"
 
-#include <glib-object.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
@@ -17,12 +18,20 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE (FbdDevLeds, fbd_dev_leds, FBD, DEV_LEDS, GObject);
 
 FbdDevLeds *fbd_dev_leds_new (GError **error);
-gboolean    fbd_dev_leds_start_periodic (FbdDevLeds          *self,
-                                         FbdFeedbackLedColor  color,
-                                         FbdLedRgbColor      *rgb,
-                                         guint                max_brighness,
-                                         guint                freq);
-gboolean    fbd_dev_leds_stop (FbdDevLeds *self, FbdFeedbackLedColor color);
+void        fbd_dev_leds_new_async (GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data);
+FbdDevLeds *fbd_dev_leds_new_finish (GAsyncResult *res, GError **error);
+gboolean    fbd_dev_leds_claim (FbdDevLeds          *self,
+                                gconstpointer        owner,
+                                guint                priority,
+                                FbdFeedbackLedColor  color,
+                                FbdLedRgbColor      *rgb,
+                                guint                max_brightness,
+                                guint                freq,
+                                FbdLedPattern       *pattern);
+gboolean    fbd_dev_leds_release (FbdDevLeds *self, gconstpointer owner);
 gboolean    fbd_dev_leds_has_led (FbdDevLeds *self, FbdFeedbackLedColor color);
+void        fbd_dev_leds_flush (FbdDevLeds *self);
 
 G_END_DECLS
@@ -43,8 +43,10 @@ typedef struct _FbdDevSound {
 
 static void initable_iface_init (GInitableIface *iface);
 
+/* Asynchronous initialization runs the #GInitable implementation in a thread */
 G_DEFINE_TYPE_WITH_CODE (FbdDevSound, fbd_dev_sound, G_TYPE_OBJECT,
-                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, initable_iface_init));
+                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, initable_iface_init)
+                         G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_INITABLE, NULL));
 
 static void
 on_sound_theme_name_changed (FbdDevSound *self,
@@ -167,6 +169,41 @@ fbd_dev_sound_new (GError **error)
                                         NULL));
 }
 
+/**
+ * fbd_dev_sound_new_async:
+ * @cancellable: (nullable): A cancellable
+ * @callback: Invoked once the device is ready
+ * @user_data: User data for @callback
+ *
+ * Like fbd_dev_sound_new() but sets up the sound context without
+ * blocking the main loop.
+ */
+void
+fbd_dev_sound_new_async (GCancellable        *cancellable,
+                         GAsyncReadyCallback  callback,
+                         gpointer             user_data)
+{
+  g_async_initable_new_async (FBD_TYPE_DEV_SOUND,
+                              G_PRIORITY_DEFAULT,
+                              cancellable,
+                              callback,
+                              user_data,
+                              NULL);
+}
+
+FbdDevSound *
+fbd_dev_sound_new_finish (GAsyncResult *res, GError **error)
+{
+  g_autoptr (GObject) source = g_async_result_get_source_object (res);
+  GObject *object;
+
+  object = g_async_initable_new_finish (G_ASYNC_INITABLE (source), res, error);
+  if (object == NULL)
+    return NULL;
+
+  return FBD_DEV_SOUND (object);
+}
+
 
 static void
 on_sound_play_finished_callback (GSoundContext *ctx,
@@ -5,7 +5,7 @@
  */
 #pragma once
 
-#include <glib-object.h>
+#include <gio/gio.h>
 
 #include "fbd-feedback-sound.h"
 
@@ -18,6 +18,10 @@ G_DECLARE_FINAL_TYPE (FbdDevSound, fbd_dev_sound, FBD, DEV_SOUND, GObject);
 typedef void (*FbdDevSoundPlayedCallback)(FbdFeedbackSound *feedback);
 
 FbdDevSound *fbd_dev_sound_new (GError **error);
+void         fbd_dev_sound_new_async (GCancellable        *cancellable,
+                                      GAsyncReadyCallback  callback,
+                                      gpointer             user_data);
+FbdDevSound *fbd_dev_sound_new_finish (GAsyncResult *res, GError **error);
 gboolean     fbd_dev_sound_play (FbdDevSound *self,
                                  FbdFeedbackSound *feedback,
                                  FbdDevSoundPlayedCallback callback);
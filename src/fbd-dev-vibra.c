@@ -10,15 +10,19 @@
 #define G_LOG_DOMAIN "fbd-dev-vibra"
 
 #include "fbd-dev-vibra.h"
+#include "fbd-io-worker.h"
 
 #include <gio/gio.h>
+#include <glib-unix.h>
 
 #include <errno.h>
 #include <fcntl.h>
 #include <linux/input.h>
+#include <string.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 /**
  * SECTION:fbd-dev-vibra
@@ -27,7 +31,31 @@
  *
  * The #FbdDevVibra is used to interface with haptic motor via the force
  * feedback interface. It currently only supports one id at a time.
+ * All ioctls and writes happen in the device's #FbdIoWorker.
+ *
+ * Uploaded effects stay resident in the device's effect slots so
+ * replaying them doesn't need another upload. Strength differences
+ * between profiles are handled via the master gain.
+ *
+ * On devices without a usable periodic waveform periodic effects are
+ * synthesized as a sequence of rumbles approximating the envelope.
+ *
+ * If the driver reports effect status via EV_FF_STATUS the
+ * #FbdDevVibra::effect-ended signal is emitted once the last
+ * effect stopped playing.
+ */
+
+#define FBD_DEV_VIBRA_DEFAULT_GAIN 0xC000 /* 75% */
+#define FBD_DEV_VIBRA_PERIODIC_DELAY 200  /* ms */
+#define FBD_DEV_VIBRA_MAX_STEPS 4         /* rumbles to synthesize an envelope */
+/*
+ * How late EV_FF_STATUS may report an effect stopped until measured:
+ * ff-memless based drivers stop effects from a timer and the motor
+ * work is scheduled on a workqueue, 500ms covers slow devices.
  */
+#define FBD_DEV_VIBRA_COMPLETION_LATENCY     500 /* ms */
+#define FBD_DEV_VIBRA_MIN_COMPLETION_LATENCY 50  /* ms */
+#define FBD_DEV_VIBRA_MAX_COMPLETION_LATENCY 2000 /* ms */
 
 enum {
   PROP_0,
@@ -36,26 +64,47 @@ enum {
 };
 static GParamSpec *props[PROP_LAST_PROP];
 
-typedef enum {
-  FBD_DEV_VIBRA_FEATURE_RUMBLE,
-  FBD_DEV_VIBRA_FEATURE_PERIODIC,
-  FBD_DEV_VIBRA_FEATURE_GAIN,
-} FbdDevVibraFeatureFlags;
+enum {
+  SIGNAL_EFFECT_ENDED,
+  N_SIGNALS
+};
+static guint signals[N_SIGNALS];
 
 typedef struct _FbdDevVibra {
   GObject parent;
 
   GUdevDevice *device;
   gint fd;
-  gint id; /* currently used id */
+  FbdIoWorker *worker;
+
+  __u16 waveform;     /* periodic waveform, 0 if periodic effects are synthesized */
+
+  /* Only accessed by the worker */
+  gint ids[FBD_DEV_VIBRA_MAX_STEPS]; /* currently playing ids */
+  guint n_ids;
+  guint max_effects;  /* number of effect slots */
+  GQueue effects;     /* resident effects, most recently used first */
 
   FbdDevVibraFeatureFlags features;
+  guint gain;         /* in percent */
+
+  /* Effects started last, waiting for EV_FF_STATUS to report them stopped */
+  guint status_watch_id;
+  guint serial;       /* of the last play or stop command */
+  gint pending_ids[FBD_DEV_VIBRA_MAX_STEPS];
+  guint n_pending;
+  gint64 pending_end_us; /* when the effects should stop */
+  guint latency;         /* smoothed lateness of the reports in ms, 0 if unknown */
 } FbdDevVibra;
 
 static void initable_iface_init (GInitableIface *iface);
+static gboolean do_set_gain (FbdDevVibra *self, guint gain, GError **error);
+static gboolean on_ff_status (gint fd, GIOCondition condition, gpointer user_data);
 
+/* Asynchronous initialization runs the #GInitable implementation in a thread */
 G_DEFINE_TYPE_WITH_CODE (FbdDevVibra, fbd_dev_vibra, G_TYPE_OBJECT,
-                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, initable_iface_init));
+                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, initable_iface_init)
+                         G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_INITABLE, NULL));
 
 static void
 fbd_dev_vibra_set_property (GObject      *object,
@@ -103,7 +152,8 @@ initable_init (GInitable     *initable,
   FbdDevVibra *self = FBD_DEV_VIBRA (initable);
   const char *filename = g_udev_device_get_device_file (self->device);
   gulong features[1 + FF_MAX/BITS_PER_LONG];
-  struct input_event gain = { 0 };
+  gulong evbits[1 + EV_MAX/BITS_PER_LONG] = { 0 };
+  int n_effects;
 
   self->fd = open (filename, O_RDWR | O_NONBLOCK, O_RDWR);
   if (self->fd < 0) {
@@ -124,44 +174,51 @@ initable_init (GInitable     *initable,
 
   if (HAS_FEATURE(FF_RUMBLE, features))
     self->features |= FBD_DEV_VIBRA_FEATURE_RUMBLE;
-  else {
-    g_set_error (error,
-                 G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                 "No rumble capable vibra device “%s”: %s",
-                 filename, g_strerror (errno));
-    return FALSE;
-  }
 
-  if (HAS_FEATURE(FF_PERIODIC, features))
+  if (HAS_FEATURE(FF_PERIODIC, features) && HAS_FEATURE(FF_SINE, features))
+    self->waveform = FF_SINE;
+
+  /* Without a usable waveform periodic effects are synthesized from rumbles */
+  if (self->waveform)
     self->features |= FBD_DEV_VIBRA_FEATURE_PERIODIC;
-  else {
+  else if (HAS_FEATURE(FF_RUMBLE, features))
+    self->features |= FBD_DEV_VIBRA_FEATURE_PERIODIC | FBD_DEV_VIBRA_FEATURE_SYNTHESIZED;
+
+  if (!(self->features & (FBD_DEV_VIBRA_FEATURE_RUMBLE | FBD_DEV_VIBRA_FEATURE_PERIODIC))) {
     g_set_error (error,
                  G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                 "No rumble capable vibra device “%s”: %s",
-                 filename, g_strerror (errno));
+                 "Neither rumble nor periodic effects supported by vibra device “%s”",
+                 filename);
     return FALSE;
   }
 
+  if (ioctl (self->fd, EVIOCGEFFECTS, &n_effects) == -1 || n_effects < 1) {
+    g_debug ("Unable to query number of effects of '%s', assuming one", filename);
+    n_effects = 1;
+  }
+  self->max_effects = n_effects;
+
   /* Set gain to 75% if supported */
   if (HAS_FEATURE(FF_GAIN, features)) {
+    g_autoptr (GError) err = NULL;
+
     self->features |= FBD_DEV_VIBRA_FEATURE_GAIN;
-    memset(&gain, 0, sizeof(gain));
-    gain.type = EV_FF;
-    gain.code = FF_GAIN;
-    gain.value = 0xC000; /* [0, 0xFFFF]) */
-
-    g_debug("Setting master gain to 75%%");
-    if (write(self->fd, &gain, sizeof(gain)) != sizeof(gain)) {
-      g_set_error (error,
-                 G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                 "Unable to set gain of '%s': %s",
-                 filename, g_strerror (errno));
-    }
+    if (!do_set_gain (self, FBD_DEV_VIBRA_DEFAULT_GAIN, &err))
+      g_warning ("Unable to set gain of '%s': %s", filename, err->message);
   } else {
     g_debug ("Gain unsupported");
   }
 
-  g_debug ("Vibra device at '%s' usable", filename);
+  if (ioctl (self->fd, EVIOCGBIT(0, sizeof (evbits)), evbits) != -1 &&
+      HAS_FEATURE(EV_FF_STATUS, evbits)) {
+    self->status_watch_id = g_unix_fd_add (self->fd, G_IO_IN, on_ff_status, self);
+    g_source_set_name_by_id (self->status_watch_id, "[feedbackd] vibra ff status");
+  } else {
+    g_debug ("Effect status unsupported");
+  }
+
+  g_debug ("Vibra device at '%s' usable, features: 0x%x, %s periodic effects", filename,
+           self->features, self->waveform ? "native" : "synthesized");
   return TRUE;
 }
 
@@ -176,6 +233,8 @@ fbd_dev_vibra_dispose (GObject *object)
 {
   FbdDevVibra *self = FBD_DEV_VIBRA (object);
 
+  g_clear_handle_id (&self->status_watch_id, g_source_remove);
+  g_clear_object (&self->worker);
   g_clear_object (&self->device);
 
   G_OBJECT_CLASS (fbd_dev_vibra_parent_class)->dispose (object);
@@ -186,6 +245,8 @@ fbd_dev_vibra_finalize (GObject *object)
 {
   FbdDevVibra *self = FBD_DEV_VIBRA (object);
 
+  /* Closing the fd erases all uploaded effects */
+  g_queue_clear_full (&self->effects, g_free);
   if (self->fd >= 0) {
     close (self->fd);
     self->fd = -1;
@@ -214,11 +275,29 @@ fbd_dev_vibra_class_init (FbdDevVibraClass *klass)
       G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
   g_object_class_install_properties (object_class, PROP_LAST_PROP, props);
+
+  /**
+   * FbdDevVibra::effect-ended:
+   *
+   * Emitted when the driver reported that the effects started by the
+   * last rumble or periodic request stopped playing. Only emitted when
+   * fbd_dev_vibra_reports_completion() returns %TRUE.
+   */
+  signals[SIGNAL_EFFECT_ENDED] = g_signal_new ("effect-ended",
+                                               G_TYPE_FROM_CLASS (klass),
+                                               G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+                                               NULL,
+                                               G_TYPE_NONE,
+                                               0);
 }
 
 static void
 fbd_dev_vibra_init (FbdDevVibra *self)
 {
+  self->fd = -1;
+  self->gain = 100;
+  g_queue_init (&self->effects);
+  self->worker = fbd_io_worker_new ("fbd-vibra-io");
 }
 
 FbdDevVibra *
@@ -231,13 +310,224 @@ fbd_dev_vibra_new (GUdevDevice *device, GError **error)
                                         NULL));
 }
 
-gboolean
-fbd_dev_vibra_rumble (FbdDevVibra *self, guint duration, gboolean upload)
+void
+fbd_dev_vibra_new_async (GUdevDevice         *device,
+                         GCancellable        *cancellable,
+                         GAsyncReadyCallback  callback,
+                         gpointer             user_data)
+{
+  g_async_initable_new_async (FBD_TYPE_DEV_VIBRA,
+                              G_PRIORITY_DEFAULT,
+                              cancellable,
+                              callback,
+                              user_data,
+                              "device", device,
+                              NULL);
+}
+
+FbdDevVibra *
+fbd_dev_vibra_new_finish (GAsyncResult *res, GError **error)
+{
+  g_autoptr (GObject) source = g_async_result_get_source_object (res);
+  GObject *object;
+
+  object = g_async_initable_new_finish (G_ASYNC_INITABLE (source), res, error);
+  if (object == NULL)
+    return NULL;
+
+  return FBD_DEV_VIBRA (object);
+}
+
+typedef enum {
+  FBD_DEV_VIBRA_CMD_RUMBLE,
+  FBD_DEV_VIBRA_CMD_PERIODIC,
+  FBD_DEV_VIBRA_CMD_STOP,
+  FBD_DEV_VIBRA_CMD_GAIN,
+} FbdDevVibraCmdType;
+
+typedef struct {
+  FbdDevVibra       *self;
+  FbdDevVibraCmdType type;
+  guint              duration;
+  guint              magnitude;
+  guint              fade_in_level;
+  guint              fade_in_time;
+  guint              serial;
+
+  /* Effects started by the command, filled in by the worker */
+  gint               ids[FBD_DEV_VIBRA_MAX_STEPS];
+  guint              n_ids;
+} FbdDevVibraCmd;
+
+
+static void
+fbd_dev_vibra_cmd_free (FbdDevVibraCmd *cmd)
+{
+  g_object_unref (cmd->self);
+  g_free (cmd);
+}
+
+
+/* Track how late the device reports effects as stopped */
+static void
+update_latency (FbdDevVibra *self)
+{
+  gint64 late_ms = (g_get_monotonic_time () - self->pending_end_us) / 1000;
+
+  late_ms = CLAMP (late_ms, 1, FBD_DEV_VIBRA_MAX_COMPLETION_LATENCY);
+  if (self->latency)
+    self->latency = (3 * self->latency + late_ms) / 4;
+  else
+    self->latency = late_ms;
+}
+
+
+static void
+on_effect_stopped (FbdDevVibra *self, gint id)
+{
+  for (guint i = 0; i < self->n_pending; i++) {
+    if (self->pending_ids[i] != id)
+      continue;
+
+    self->pending_ids[i] = self->pending_ids[--self->n_pending];
+    if (self->n_pending == 0) {
+      g_debug ("Vibra effects ended");
+      update_latency (self);
+      g_signal_emit (self, signals[SIGNAL_EFFECT_ENDED], 0);
+    }
+    return;
+  }
+}
+
+
+static gboolean
+on_ff_status (gint fd, GIOCondition condition, gpointer user_data)
+{
+  FbdDevVibra *self = FBD_DEV_VIBRA (user_data);
+  struct input_event events[16];
+  gssize len;
+
+  if (condition & (G_IO_HUP | G_IO_ERR)) {
+    g_debug ("Vibra device gone, no more effect status");
+    self->status_watch_id = 0;
+    return G_SOURCE_REMOVE;
+  }
+
+  while ((len = read (fd, events, sizeof (events))) > 0) {
+    for (guint i = 0; i < len / sizeof (struct input_event); i++) {
+      if (events[i].type == EV_FF_STATUS && events[i].value == FF_STATUS_STOPPED)
+        on_effect_stopped (self, events[i].code);
+    }
+  }
+
+  if (len < 0 && errno != EAGAIN && errno != EINTR)
+    g_warning ("Failed to read effect status: %s", g_strerror (errno));
+
+  return G_SOURCE_CONTINUE;
+}
+
+
+static gboolean
+ff_effect_equal (const struct ff_effect *a, const struct ff_effect *b)
+{
+  struct ff_effect tmp;
+
+  /* Ignore the slot, compare everything else */
+  memcpy (&tmp, b, sizeof (tmp));
+  tmp.id = a->id;
+  return memcmp (a, &tmp, sizeof (tmp)) == 0;
+}
+
+
+static void
+evict_effect (FbdDevVibra *self)
+{
+  g_autofree struct ff_effect *effect = g_queue_pop_tail (&self->effects);
+
+  g_debug ("Erasing vibra effect %d", effect->id);
+  if (ioctl (self->fd, EVIOCRMFF, effect->id) == -1)
+    g_warning ("Failed to erase vibra effect with id %d: %s", effect->id, g_strerror (errno));
+
+  for (guint i = 0; i < self->n_ids; i++) {
+    if (self->ids[i] == effect->id)
+      self->ids[i] = -1;
+  }
+}
+
+/*
+ * Make sure the effect is resident in one of the device's slots and
+ * set the effect's id accordingly. Effects already uploaded are reused,
+ * the least recently used ones are erased if we run out of slots.
+ */
+static gboolean
+upload_effect (FbdDevVibra *self, struct ff_effect *effect, GError **error)
+{
+  struct ff_effect *cached;
+
+  for (GList *l = self->effects.head; l; l = l->next) {
+    cached = l->data;
+
+    if (ff_effect_equal (cached, effect)) {
+      effect->id = cached->id;
+      g_queue_unlink (&self->effects, l);
+      g_queue_push_head_link (&self->effects, l);
+      return TRUE;
+    }
+  }
+
+  while (self->effects.length >= self->max_effects)
+    evict_effect (self);
+
+  effect->id = -1;
+  g_debug("Uploading vibra effect (%d)", self->fd);
+  while (ioctl (self->fd, EVIOCSFF, effect) == -1) {
+    if (errno != ENOSPC || g_queue_is_empty (&self->effects)) {
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                   "Failed to upload vibra effect: %s", g_strerror (errno));
+      return FALSE;
+    }
+    evict_effect (self);
+  }
+
+  cached = g_new (struct ff_effect, 1);
+  memcpy (cached, effect, sizeof (*cached));
+  g_queue_push_head (&self->effects, cached);
+
+  return TRUE;
+}
+
+
+static gboolean
+play_effects (FbdDevVibra *self, const gint *ids, guint n_ids, GError **error)
 {
   struct input_event event = { 0 };
-  struct ff_effect effect = { 0 };
 
-  g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), FALSE);
+  g_assert (n_ids <= FBD_DEV_VIBRA_MAX_STEPS);
+
+  event.type = EV_FF;
+  event.value = 1;
+  self->n_ids = 0;
+  for (guint i = 0; i < n_ids; i++) {
+    g_debug("Playing vibra effect id %d", ids[i]);
+    event.code = ids[i];
+
+    if (write (self->fd, (const void*) &event, sizeof (event)) < 0) {
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                   "Failed to play vibra effect: %s", g_strerror (errno));
+      return FALSE;
+    }
+    self->ids[self->n_ids++] = ids[i];
+  }
+
+  return TRUE;
+}
+
+
+static gboolean
+do_rumble (FbdDevVibra *self, guint duration, GError **error)
+{
+  struct ff_effect effect = { 0 };
+  gint id;
 
   memset(&effect, 0, sizeof(effect));
   effect.type = FF_RUMBLE;
@@ -247,37 +537,62 @@ fbd_dev_vibra_rumble (FbdDevVibra *self, guint duration, gboolean upload)
   effect.replay.length = duration;
   effect.replay.delay = 0;
 
-  if (upload) {
-    g_debug("Uploading rumbling vibra effect (%d)", self->fd);
-    if (ioctl(self->fd, EVIOCSFF, &effect) == -1) {
-      g_warning ("Failed to upload rumbling vibra effect: %s", g_strerror (errno));
-      return FALSE;
-    }
-    self->id = effect.id;
-  }
+  if (!upload_effect (self, &effect, error))
+    return FALSE;
 
-  g_debug("Playing rumbling vibra effect id %d", effect.id);
-  event.type = EV_FF;
-  event.value = 1;
-  event.code = self->id;
+  id = effect.id;
+  return play_effects (self, &id, 1, error);
+}
 
-  if (write (self->fd, (const void*) &event, sizeof (event)) < 0) {
-    g_warning ("Failed to play rumbling vibra effect.");
-    return FALSE;
+/*
+ * Approximate a periodic effect by rumbles: The attack is split into
+ * steps of increasing strength that are uploaded once and played
+ * together, each one delayed until its step starts. The last step
+ * lasts until the end of the effect.
+ */
+static gboolean
+do_rumble_sequence (FbdDevVibra *self, guint duration, guint magnitude,
+                    guint fade_in_level, guint fade_in_time, GError **error)
+{
+  gint ids[FBD_DEV_VIBRA_MAX_STEPS];
+  guint n_steps = MIN (FBD_DEV_VIBRA_MAX_STEPS, self->max_effects);
+
+  fade_in_time = MIN (fade_in_time, duration);
+  if (fade_in_level == magnitude || fade_in_time == 0)
+    n_steps = 1;
+
+  for (guint i = 0; i < n_steps; i++) {
+    struct ff_effect effect = { 0 };
+    guint start = fade_in_time * i / n_steps;
+    guint end = (i == n_steps - 1) ? duration : fade_in_time * (i + 1) / n_steps;
+    gint level = magnitude;
+
+    if (n_steps > 1)
+      level = (gint)fade_in_level + ((gint)magnitude - (gint)fade_in_level) * (gint)i / (gint)(n_steps - 1);
+
+    effect.type = FF_RUMBLE;
+    effect.id = -1;
+    /* Periodic magnitudes are signed, rumble magnitudes aren't */
+    effect.u.rumble.strong_magnitude = MIN (0xFFFF, (guint)ABS (level) * 2);
+    effect.u.rumble.weak_magnitude = 0;
+    effect.replay.length = end - start;
+    effect.replay.delay = FBD_DEV_VIBRA_PERIODIC_DELAY + start;
+
+    if (!upload_effect (self, &effect, error))
+      return FALSE;
+    ids[i] = effect.id;
   }
 
-  return TRUE;
+  return play_effects (self, ids, n_steps, error);
 }
 
-/* TODO: fall back to multiple rumbles when sine not supported */
-gboolean
-fbd_dev_vibra_periodic (FbdDevVibra *self, guint duration, guint magnitude,
-			guint fade_in_level, guint fade_in_time)
+
+static gboolean
+do_periodic (FbdDevVibra *self, guint duration, guint magnitude,
+             guint fade_in_level, guint fade_in_time, GError **error)
 {
-  struct input_event event;
   struct ff_effect effect = { 0 };
-
-  g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), FALSE);
+  gint id;
 
   if (!magnitude)
     magnitude = 0x7FFF;
@@ -288,9 +603,13 @@ fbd_dev_vibra_periodic (FbdDevVibra *self, guint duration, guint magnitude,
   if (!fade_in_time)
     fade_in_time = duration;
 
+  if (!self->waveform)
+    return do_rumble_sequence (self, duration, magnitude, fade_in_level, fade_in_time, error);
+
+  memset(&effect, 0, sizeof(effect));
   effect.type = FF_PERIODIC;
   effect.id = -1;
-  effect.u.periodic.waveform = FF_SINE;
+  effect.u.periodic.waveform = self->waveform;
   effect.u.periodic.period = 10;
   effect.u.periodic.magnitude = magnitude;
   effect.u.periodic.offset = 0;
@@ -303,59 +622,262 @@ fbd_dev_vibra_periodic (FbdDevVibra *self, guint duration, guint magnitude,
   effect.trigger.button = 0;
   effect.trigger.interval = 0;
   effect.replay.length = duration;
-  effect.replay.delay = 200;
+  effect.replay.delay = FBD_DEV_VIBRA_PERIODIC_DELAY;
 
-  g_debug("Uploading periodic effect (%d)", self->fd);
-  if (ioctl(self->fd, EVIOCSFF, &effect) == -1) {
-    g_warning ("Failed to upload periodic vibra effect: %s", g_strerror (errno));
+  if (!upload_effect (self, &effect, error))
     return FALSE;
+
+  id = effect.id;
+  return play_effects (self, &id, 1, error);
+}
+
+
+static gboolean
+do_stop (FbdDevVibra *self, GError **error)
+{
+  struct input_event stop = { 0 };
+
+  stop.type = EV_FF;
+  stop.value = 0;
+  for (guint i = 0; i < self->n_ids; i++) {
+    if (self->ids[i] < 0)
+      continue;
+
+    stop.code = self->ids[i];
+    if (write(self->fd, (const void*) &stop, sizeof(stop)) < 0) {
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                   "Failed to stop vibra effect with id %d: %s", self->ids[i], g_strerror (errno));
+      return FALSE;
+    }
   }
+  self->n_ids = 0;
+
+  return TRUE;
+}
+
+
+static gboolean
+do_set_gain (FbdDevVibra *self, guint gain, GError **error)
+{
+  struct input_event event = { 0 };
 
-  g_debug("Playing periodic vibra effect id %d", effect.id);
   event.type = EV_FF;
-  self->id = event.code = effect.id;
-  event.value = 1;
+  event.code = FF_GAIN;
+  event.value = gain; /* [0, 0xFFFF]) */
 
-  if (write (self->fd, (const void*) &event, sizeof (event)) < 0) {
-    g_warning ("Failed to play rumbling effect.");
+  g_debug("Setting master gain to 0x%x", gain);
+  if (write(self->fd, &event, sizeof(event)) != sizeof(event)) {
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                 "Unable to set gain: %s", g_strerror (errno));
     return FALSE;
   }
 
   return TRUE;
 }
 
+/* Runs in the io worker's thread */
+static gboolean
+fbd_dev_vibra_run_cmd (gpointer data, GError **error)
+{
+  FbdDevVibraCmd *cmd = data;
+  FbdDevVibra *self = cmd->self;
+  gboolean success;
+
+  switch (cmd->type) {
+  case FBD_DEV_VIBRA_CMD_RUMBLE:
+  case FBD_DEV_VIBRA_CMD_PERIODIC:
+    if (cmd->type == FBD_DEV_VIBRA_CMD_RUMBLE) {
+      success = do_rumble (self, cmd->duration, error);
+    } else {
+      success = do_periodic (self, cmd->duration, cmd->magnitude,
+                             cmd->fade_in_level, cmd->fade_in_time, error);
+    }
+    if (success) {
+      memcpy (cmd->ids, self->ids, sizeof (self->ids));
+      cmd->n_ids = self->n_ids;
+    }
+    return success;
+  case FBD_DEV_VIBRA_CMD_STOP:
+    return do_stop (cmd->self, error);
+  case FBD_DEV_VIBRA_CMD_GAIN:
+    return do_set_gain (cmd->self, cmd->magnitude, error);
+  default:
+    g_assert_not_reached ();
+  }
+}
+
+
+static void
+on_cmd_done (gpointer data, const GError *error)
+{
+  FbdDevVibraCmd *cmd = data;
+  FbdDevVibra *self = cmd->self;
+
+  if (error) {
+    g_warning ("%s", error->message);
+    return;
+  }
+
+  /* Only track effects that weren't superseded in the meantime */
+  if (cmd->n_ids && cmd->serial == self->serial && self->status_watch_id) {
+    guint length = cmd->duration;
+
+    if (cmd->type == FBD_DEV_VIBRA_CMD_PERIODIC)
+      length += FBD_DEV_VIBRA_PERIODIC_DELAY;
+
+    memcpy (self->pending_ids, cmd->ids, sizeof (cmd->ids));
+    self->n_pending = cmd->n_ids;
+    self->pending_end_us = g_get_monotonic_time () + length * G_TIME_SPAN_MILLISECOND;
+  }
+}
 
+/* Effect ids are handed from one command to the next so vibra commands
+ * are never coalesced. */
+static void
+fbd_dev_vibra_push_cmd (FbdDevVibra *self, FbdDevVibraCmd *cmd)
+{
+  cmd->self = g_object_ref (self);
+  if (cmd->type != FBD_DEV_VIBRA_CMD_GAIN)
+    self->serial++;
+  cmd->serial = self->serial;
+  fbd_io_worker_push (self->worker,
+                      NULL,
+                      fbd_dev_vibra_run_cmd,
+                      on_cmd_done,
+                      cmd,
+                      (GDestroyNotify) fbd_dev_vibra_cmd_free);
+}
+
+/**
+ * fbd_dev_vibra_rumble:
+ * @self: The vibra device
+ * @duration: The duration in ms
+ * @upload: Unused, effects stay resident and are only uploaded once
+ *
+ * Play a rumble effect.
+ *
+ * Returns: %TRUE if the effect was queued
+ */
 gboolean
-fbd_dev_vibra_remove_effect (FbdDevVibra *self)
+fbd_dev_vibra_rumble (FbdDevVibra *self, guint duration, gboolean upload)
 {
+  FbdDevVibraCmd *cmd;
+
   g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), FALSE);
 
-  g_debug("Erasing vibra effect (%d)", self->fd);
-  if (ioctl(self->fd, EVIOCRMFF, self->id) == -1) {
-    g_warning  ("Failed to erase vibra effect with id %d: %s", self->id, strerror(errno));
-    return FALSE;
-  }
+  cmd = g_new0 (FbdDevVibraCmd, 1);
+  cmd->type = FBD_DEV_VIBRA_CMD_RUMBLE;
+  cmd->duration = duration;
+  fbd_dev_vibra_push_cmd (self, cmd);
+
+  return TRUE;
+}
+
+
+gboolean
+fbd_dev_vibra_periodic (FbdDevVibra *self, guint duration, guint magnitude,
+			guint fade_in_level, guint fade_in_time)
+{
+  FbdDevVibraCmd *cmd;
+
+  g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), FALSE);
+
+  cmd = g_new0 (FbdDevVibraCmd, 1);
+  cmd->type = FBD_DEV_VIBRA_CMD_PERIODIC;
+  cmd->duration = duration;
+  cmd->magnitude = magnitude;
+  cmd->fade_in_level = fade_in_level;
+  cmd->fade_in_time = fade_in_time;
+  fbd_dev_vibra_push_cmd (self, cmd);
+
   return TRUE;
 }
 
+/**
+ * fbd_dev_vibra_pulse_train:
+ * @self: The vibra device
+ * @count: The number of pulses
+ * @length: The length of a pulse in ms
+ * @pause: The pause between pulses in ms
+ *
+ * Play a train of pulses in one go. Force feedback devices play
+ * the pulses one by one.
+ *
+ * Returns: %FALSE as the caller needs to play the pulses
+ */
+gboolean
+fbd_dev_vibra_pulse_train (FbdDevVibra *self, guint count, guint length, guint pause)
+{
+  g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), FALSE);
+
+  return FALSE;
+}
+
+/**
+ * fbd_dev_vibra_remove_effect:
+ * @self: The vibra device
+ *
+ * Invoked when an effect finished playing. The effect stays resident
+ * in its slot so it can be replayed without another upload, it's
+ * only stopped.
+ *
+ * Returns: %TRUE if the request was queued
+ */
+gboolean
+fbd_dev_vibra_remove_effect (FbdDevVibra *self)
+{
+  return fbd_dev_vibra_stop (self);
+}
+
 
 gboolean
 fbd_dev_vibra_stop(FbdDevVibra *self)
 {
-  struct input_event stop = { 0 };
+  FbdDevVibraCmd *cmd;
 
   g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), FALSE);
 
-  stop.type = EV_FF;
-  stop.code = self->id;
-  stop.value = 0;
+  /* Stopped on purpose, nothing to report */
+  self->n_pending = 0;
+
+  cmd = g_new0 (FbdDevVibraCmd, 1);
+  cmd->type = FBD_DEV_VIBRA_CMD_STOP;
+  fbd_dev_vibra_push_cmd (self, cmd);
 
-  if (write(self->fd, (const void*) &stop, sizeof(stop)) < 0) {
-    g_warning  ("Failed to stop vibra effect with id %d: %s", self->id, strerror(errno));
+  return TRUE;
+}
+
+/**
+ * fbd_dev_vibra_set_gain:
+ * @self: The vibra device
+ * @gain: The gain in percent
+ *
+ * Scale the strength of all effects via the device's master gain. This
+ * doesn't require effects to be uploaded again.
+ *
+ * Returns: %TRUE if the device supports setting the gain
+ */
+gboolean
+fbd_dev_vibra_set_gain (FbdDevVibra *self, guint gain)
+{
+  FbdDevVibraCmd *cmd;
+
+  g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), FALSE);
+  g_return_val_if_fail (gain <= 100, FALSE);
+
+  if (!(self->features & FBD_DEV_VIBRA_FEATURE_GAIN))
     return FALSE;
-  }
 
-  return fbd_dev_vibra_remove_effect (self);
+  if (self->gain == gain)
+    return TRUE;
+  self->gain = gain;
+
+  cmd = g_new0 (FbdDevVibraCmd, 1);
+  cmd->type = FBD_DEV_VIBRA_CMD_GAIN;
+  cmd->magnitude = FBD_DEV_VIBRA_DEFAULT_GAIN * gain / 100;
+  fbd_dev_vibra_push_cmd (self, cmd);
+
+  return TRUE;
 }
 
 GUdevDevice *
@@ -365,3 +887,94 @@ fbd_dev_vibra_get_device(FbdDevVibra *self)
 
   return self->device;
 }
+
+
+/**
+ * fbd_dev_vibra_get_features:
+ * @self: The vibra device
+ *
+ * Get the force feedback features supported by the device.
+ *
+ * Returns: The features
+ */
+FbdDevVibraFeatureFlags
+fbd_dev_vibra_get_features (FbdDevVibra *self)
+{
+  g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), FBD_DEV_VIBRA_FEATURE_NONE);
+
+  return self->features;
+}
+
+
+/**
+ * fbd_dev_vibra_reports_completion:
+ * @self: The vibra device
+ *
+ * Whether the device emits #FbdDevVibra::effect-ended when effects
+ * stop playing.
+ *
+ * Returns: %TRUE if the driver reports effect status
+ */
+gboolean
+fbd_dev_vibra_reports_completion (FbdDevVibra *self)
+{
+  g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), FALSE);
+
+  return !!self->status_watch_id;
+}
+
+/**
+ * fbd_dev_vibra_get_start_delay:
+ * @self: The vibra device
+ * @effect: The effect type
+ *
+ * Get the delay in ms after which an effect of the given type starts
+ * playing on the motor.
+ *
+ * Returns: The delay in ms
+ */
+guint
+fbd_dev_vibra_get_start_delay (FbdDevVibra *self, FbdDevVibraFeatureFlags effect)
+{
+  g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), 0);
+
+  return effect == FBD_DEV_VIBRA_FEATURE_PERIODIC ? FBD_DEV_VIBRA_PERIODIC_DELAY : 0;
+}
+
+/**
+ * fbd_dev_vibra_get_completion_latency:
+ * @self: The vibra device
+ *
+ * Get how long after an effect's end the device might report it as
+ * stopped. This is measured from the EV_FF_STATUS events seen so far,
+ * with some headroom for jitter.
+ *
+ * Returns: The latency in ms
+ */
+guint
+fbd_dev_vibra_get_completion_latency (FbdDevVibra *self)
+{
+  g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), 0);
+
+  if (!self->latency)
+    return FBD_DEV_VIBRA_COMPLETION_LATENCY;
+
+  return CLAMP (2 * self->latency,
+                FBD_DEV_VIBRA_MIN_COMPLETION_LATENCY,
+                FBD_DEV_VIBRA_MAX_COMPLETION_LATENCY);
+}
+
+/**
+ * fbd_dev_vibra_flush:
+ * @self: The vibra device
+ *
+ * Blocks until all queued commands were sent to the device. This is
+ * mostly useful for tests and benchmarks.
+ */
+void
+fbd_dev_vibra_flush (FbdDevVibra *self)
+{
+  g_return_if_fail (FBD_IS_DEV_VIBRA (self));
+
+  fbd_io_worker_flush (self->worker);
+}
@@ -5,22 +5,54 @@
  */
 #pragma once
 
-#include <glib-object.h>
+#include <gio/gio.h>
 #include <gudev/gudev.h>
 
 G_BEGIN_DECLS
 
 #define FBD_TYPE_DEV_VIBRA (fbd_dev_vibra_get_type())
 
+/**
+ * FbdDevVibraFeatureFlags:
+ * @FBD_DEV_VIBRA_FEATURE_NONE: No features
+ * @FBD_DEV_VIBRA_FEATURE_RUMBLE: The device can play rumble effects
+ * @FBD_DEV_VIBRA_FEATURE_PERIODIC: The device can play periodic effects, natively or
+ *   synthesized from rumbles
+ * @FBD_DEV_VIBRA_FEATURE_GAIN: The device supports setting a global gain
+ * @FBD_DEV_VIBRA_FEATURE_SYNTHESIZED: Periodic effects are synthesized from rumbles
+ *   rather than played by the device
+ *
+ * The force feedback features of a vibra device
+ */
+typedef enum {
+  FBD_DEV_VIBRA_FEATURE_NONE        = 0,
+  FBD_DEV_VIBRA_FEATURE_RUMBLE      = (1 << 0),
+  FBD_DEV_VIBRA_FEATURE_PERIODIC    = (1 << 1),
+  FBD_DEV_VIBRA_FEATURE_GAIN        = (1 << 2),
+  FBD_DEV_VIBRA_FEATURE_SYNTHESIZED = (1 << 3),
+} FbdDevVibraFeatureFlags;
+
 G_DECLARE_FINAL_TYPE (FbdDevVibra, fbd_dev_vibra, FBD, DEV_VIBRA, GObject);
 
 FbdDevVibra *fbd_dev_vibra_new (GUdevDevice *device, GError **error);
+void         fbd_dev_vibra_new_async (GUdevDevice         *device,
+                                      GCancellable        *cancellable,
+                                      GAsyncReadyCallback  callback,
+                                      gpointer             user_data);
+FbdDevVibra *fbd_dev_vibra_new_finish (GAsyncResult *res, GError **error);
 gboolean     fbd_dev_vibra_rumble (FbdDevVibra *device, guint duration, gboolean upload);
 gboolean     fbd_dev_vibra_periodic (FbdDevVibra *self, guint duration, guint magnitude,
 				     guint fade_in_level, guint fade_in_time);
+gboolean     fbd_dev_vibra_pulse_train (FbdDevVibra *self, guint count, guint length, guint pause);
 gboolean     fbd_dev_vibra_stop (FbdDevVibra *self);
 gboolean     fbd_dev_vibra_remove_effect (FbdDevVibra *self);
+gboolean     fbd_dev_vibra_set_gain (FbdDevVibra *self, guint gain);
 GUdevDevice *fbd_dev_vibra_get_device(FbdDevVibra *self);
+FbdDevVibraFeatureFlags fbd_dev_vibra_get_features (FbdDevVibra *self);
+gboolean     fbd_dev_vibra_reports_completion (FbdDevVibra *self);
+guint        fbd_dev_vibra_get_start_delay (FbdDevVibra *self, FbdDevVibraFeatureFlags effect);
+guint        fbd_dev_vibra_get_completion_latency (FbdDevVibra *self);
+void         fbd_dev_vibra_flush (FbdDevVibra *self);
 
 
 G_END_DECLS
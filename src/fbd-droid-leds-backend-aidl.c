@@ -7,6 +7,7 @@
 #define G_LOG_DOMAIN "fbd-droid-leds-backend-aidl"
 
 #include <stdlib.h>
+#include <string.h>
 #include <glib.h>
 #include <glib-object.h>
 #include <gio/gio.h>
@@ -34,9 +35,17 @@ struct _FbdDroidLedsBackendAidl
 {
   GObject parent_instance;
 
-  GBinderServiceManager *service_manager;
-  GBinderRemoteObject   *remote;
-  GBinderClient         *client;
+  FbdBinderService      *service;
+
+  /* The HAL's lights, fetched once */
+  gboolean               lights_loaded;
+  guint32                light_types; /* Bitmask of LightType */
+  int32_t                notification_id;
+
+  /* Last state sent to the notification light */
+  GMutex                 state_lock;
+  gboolean               state_valid;
+  LightState             state;
 };
 
 static void initable_interface_init (GInitableIface *iface);
@@ -48,81 +57,163 @@ G_DEFINE_TYPE_WITH_CODE (FbdDroidLedsBackendAidl, fbd_droid_leds_backend_aidl, G
                                                 fbd_droid_leds_backend_interface_init))
 
 static gboolean
-fbd_droid_leds_backend_aidl_is_supported (FbdDroidLedsBackend *backend)
+fbd_droid_leds_backend_aidl_load_lights (FbdDroidLedsBackendAidl *self)
 {
-  FbdDroidLedsBackendAidl *self = FBD_DROID_LEDS_BACKEND_AIDL (backend);
-  GBinderLocalRequest *req = gbinder_client_new_request (self->client);
+  GBinderLocalRequest *req = fbd_binder_service_new_request (self->service);
   GBinderRemoteReply *reply;
   GBinderReader reader;
   int status;
   int count = 0;
-  AidlHwLight *light;
+  gboolean found = FALSE;
 
-  reply = gbinder_client_transact_sync_reply (self->client,
-                                              BINDER_LIGHT_AIDL_GET_LIGHTS,
-                                              req, &status);
+  if (req == NULL)
+    return FALSE;
+
+  reply = fbd_binder_service_transact_sync (self->service,
+                                            BINDER_LIGHT_AIDL_GET_LIGHTS,
+                                            req, &status);
   gbinder_local_request_unref (req);
 
+  if (status != GBINDER_STATUS_OK || reply == NULL) {
+    gbinder_remote_reply_unref (reply);
+    return FALSE;
+  }
+
   gbinder_remote_reply_init_reader (reply, &reader);
+  if (!fbd_binder_status_is_ok (&reader)) {
+    gbinder_remote_reply_unref (reply);
+    return FALSE;
+  }
+
+  gbinder_reader_read_int32 (&reader, &count); /* led count */
+  for (int i = 0; i < count; i++) {
+    const AidlHwLight *light;
+
+    light = gbinder_reader_read_parcelable (&reader, NULL);
+    if (light == NULL)
+      break;
 
-  if (status == GBINDER_STATUS_OK && fbd_binder_status_is_ok (&reader)) {
-    gbinder_reader_read_int32 (&reader, &count); /* led count */
+    g_debug ("Light %d: type %d, ordinal %d", light->id, light->type, light->ordinal);
+    if (light->type < 32)
+      self->light_types |= 1u << light->type;
 
-    for (int i=0; i < count; i++) {
-      light = (AidlHwLight *)gbinder_reader_read_parcelable (&reader, NULL);
-      if (light->type == LIGHT_TYPE_NOTIFICATIONS) {
-        g_debug ("droid LED usable");
-        return TRUE;
-      }
+    if (light->type == LIGHT_TYPE_NOTIFICATIONS && !found) {
+      self->notification_id = light->id;
+      found = TRUE;
     }
+  }
 
-    g_warning ("No suitable notification LED found");
-  } else {
+  gbinder_remote_reply_unref (reply);
+  self->lights_loaded = TRUE;
+  return TRUE;
+}
+
+static gboolean
+fbd_droid_leds_backend_aidl_has_light (FbdDroidLedsBackend *backend, LightType type)
+{
+  FbdDroidLedsBackendAidl *self = FBD_DROID_LEDS_BACKEND_AIDL (backend);
+
+  if (type >= 32)
+    return FALSE;
+
+  return !!(self->light_types & (1u << type));
+}
+
+static gboolean
+fbd_droid_leds_backend_aidl_is_supported (FbdDroidLedsBackend *backend)
+{
+  FbdDroidLedsBackendAidl *self = FBD_DROID_LEDS_BACKEND_AIDL (backend);
+
+  if (!self->lights_loaded && !fbd_droid_leds_backend_aidl_load_lights (self)) {
     g_warning ("Failed to get supported LED types");
+    return FALSE;
   }
 
-  return FALSE;
+  if (!fbd_droid_leds_backend_aidl_has_light (backend, LIGHT_TYPE_NOTIFICATIONS)) {
+    g_warning ("No suitable notification LED found");
+    return FALSE;
+  }
+
+  g_debug ("droid LED usable");
+  return TRUE;
 }
 
+/* Sends @state to the notification light unless it's already set */
 static gboolean
-fbd_droid_leds_backend_aidl_start_periodic (FbdDroidLedsBackend *backend,
-                                            FbdFeedbackLedColor color,
-                                            guint               max_brightness,
-                                            guint               freq)
+fbd_droid_leds_backend_aidl_set_state (FbdDroidLedsBackendAidl *self,
+                                       const LightState        *state)
 {
-  FbdDroidLedsBackendAidl *self = FBD_DROID_LEDS_BACKEND_AIDL (backend);
-  GBinderLocalRequest *req = gbinder_client_new_request (self->client);
+  GBinderLocalRequest *req;
   GBinderRemoteReply *reply;
   GBinderWriter writer;
-  LightState* notification_state;
-  int32_t status, argb_color, t;
+  LightState *notification_state;
+  gboolean unchanged, success;
+  int status;
 
-  argb_color = fbd_droid_leds_backend_get_argb_color (color, max_brightness);
-  t = 1000 * 1000 / freq / 2;
+  g_mutex_lock (&self->state_lock);
+  unchanged = self->state_valid && memcmp (&self->state, state, sizeof (*state)) == 0;
+  g_mutex_unlock (&self->state_lock);
+  if (unchanged) {
+    g_debug ("Notification LED state unchanged");
+    return TRUE;
+  }
+
+  req = fbd_binder_service_new_request (self->service);
+  if (req == NULL) {
+    g_warning ("Light hal not available");
+    return FALSE;
+  }
 
   gbinder_local_request_init_writer (req, &writer);
   notification_state = gbinder_writer_new0 (&writer, LightState);
-  notification_state->color = argb_color;
-  notification_state->flashMode = FLASH_TYPE_TIMED;
-  notification_state->flashOnMs = t;
-  notification_state->flashOffMs = t;
-  notification_state->brightnessMode = BRIGHTNESS_MODE_USER;
+  *notification_state = *state;
 
-  gbinder_writer_append_int32 (&writer, LIGHT_TYPE_NOTIFICATIONS);
+  gbinder_writer_append_int32 (&writer, self->notification_id);
   gbinder_writer_append_parcelable (&writer, notification_state, sizeof(*notification_state));
   gbinder_writer_append_int32 (&writer, BINDER_STABILITY_VINTF); /* stability */
 
-  reply = gbinder_client_transact_sync_reply (self->client,
-                                              BINDER_LIGHT_AIDL_SET_LIGHT_STATE,
-                                              req, &status);
+  reply = fbd_binder_service_transact_sync (self->service,
+                                            BINDER_LIGHT_AIDL_SET_LIGHT_STATE,
+                                            req, &status);
   gbinder_local_request_unref (req);
-  
-  if (status == GBINDER_STATUS_OK && fbd_binder_reply_status_is_ok (reply)) {
-    return TRUE;
-  } else {
+
+  success = status == GBINDER_STATUS_OK && reply && fbd_binder_reply_status_is_ok (reply);
+  gbinder_remote_reply_unref (reply);
+
+  /* On failure we don't know what the light shows */
+  g_mutex_lock (&self->state_lock);
+  self->state = *state;
+  self->state_valid = success;
+  g_mutex_unlock (&self->state_lock);
+
+  return success;
+}
+
+static gboolean
+fbd_droid_leds_backend_aidl_start_periodic (FbdDroidLedsBackend  *backend,
+                                            FbdFeedbackLedColor   color,
+                                            const FbdLedRgbColor *rgb,
+                                            guint                 max_brightness,
+                                            guint                 freq)
+{
+  FbdDroidLedsBackendAidl *self = FBD_DROID_LEDS_BACKEND_AIDL (backend);
+  LightState state = { 0 };
+  int32_t t;
+
+  t = 1000 * 1000 / freq / 2;
+
+  state.color = fbd_droid_leds_backend_get_argb_color (color, rgb, max_brightness);
+  state.flashMode = FLASH_TYPE_TIMED;
+  state.flashOnMs = t;
+  state.flashOffMs = t;
+  state.brightnessMode = BRIGHTNESS_MODE_USER;
+
+  if (!fbd_droid_leds_backend_aidl_set_state (self, &state)) {
     g_warning ("Unable to turn to set notification LED");
     return FALSE;
   }
+
+  return TRUE;
 }
 
 static gboolean
@@ -130,35 +221,36 @@ fbd_droid_leds_backend_aidl_stop (FbdDroidLedsBackend *backend,
                                   FbdFeedbackLedColor  color)
 {
   FbdDroidLedsBackendAidl *self = FBD_DROID_LEDS_BACKEND_AIDL (backend);
-  GBinderLocalRequest *req = gbinder_client_new_request (self->client);
-  GBinderRemoteReply *reply;
-  GBinderWriter writer;
-  LightState* notification_state;
-  int status;
+  LightState state = { 0 };
 
-  gbinder_local_request_init_writer (req, &writer);
-  notification_state = gbinder_writer_new0 (&writer, LightState);
-  notification_state->color = 0;
-  notification_state->flashMode = FLASH_TYPE_NONE;
-  notification_state->flashOnMs = 0;
-  notification_state->flashOffMs = 0;
-  notification_state->brightnessMode = BRIGHTNESS_MODE_USER;
-
-  gbinder_writer_append_int32 (&writer, LIGHT_TYPE_NOTIFICATIONS);
-  gbinder_writer_append_parcelable (&writer, notification_state, sizeof(*notification_state));
-  gbinder_writer_append_int32 (&writer, BINDER_STABILITY_VINTF); /* stability */
+  state.flashMode = FLASH_TYPE_NONE;
+  state.brightnessMode = BRIGHTNESS_MODE_USER;
 
-  reply = gbinder_client_transact_sync_reply (self->client,
-                                              BINDER_LIGHT_AIDL_SET_LIGHT_STATE,
-                                              req, &status);
-  gbinder_local_request_unref (req);
-  
-  if (status == GBINDER_STATUS_OK && fbd_binder_reply_status_is_ok (reply)) {
-    return TRUE;
-  } else {
+  if (!fbd_droid_leds_backend_aidl_set_state (self, &state)) {
     g_warning ("Unable to stop notification LED");
     return FALSE;
   }
+
+  return TRUE;
+}
+
+static gboolean
+fbd_droid_leds_backend_aidl_is_available (FbdDroidLedsBackend *backend)
+{
+  FbdDroidLedsBackendAidl *self = FBD_DROID_LEDS_BACKEND_AIDL (backend);
+
+  return fbd_binder_service_is_available (self->service);
+}
+
+static void
+on_service_reconnected (FbdDroidLedsBackendAidl *self)
+{
+  /* The restarted HAL lost the light state */
+  g_mutex_lock (&self->state_lock);
+  self->state_valid = FALSE;
+  g_mutex_unlock (&self->state_lock);
+
+  g_signal_emit_by_name (self, "reconnected");
 }
 
 static gboolean
@@ -167,24 +259,22 @@ initable_init (GInitable     *initable,
                GError       **error)
 {
   FbdDroidLedsBackendAidl *self = FBD_DROID_LEDS_BACKEND_AIDL (initable);
-  gboolean success;
 
   g_debug ("Initializing droid leds aidl");
 
-  success = fbd_binder_init (BINDER_LIGHT_DEFAULT_AIDL_DEVICE,
-                             BINDER_LIGHT_AIDL_IFACE,
-                             (BINDER_LIGHT_AIDL_IFACE "/" BINDER_LIGHT_AIDL_SLOT),
-                             &self->service_manager,
-                             &self->remote,
-                             &self->client);
-
-  if (!success) {
+  self->service = fbd_droid_leds_backend_aidl_get_service ();
+  if (!fbd_binder_service_resolve (self->service, NULL)) {
     g_set_error (error,
                  G_IO_ERROR, G_IO_ERROR_FAILED,
                  "Failed to obtain suitable light hal");
     return FALSE;
   }
 
+  g_signal_connect_object (self->service, "reconnected",
+                           G_CALLBACK (on_service_reconnected),
+                           self,
+                           G_CONNECT_SWAPPED);
+
   return TRUE;
 }
 
@@ -195,9 +285,7 @@ fbd_droid_leds_backend_aidl_constructed (GObject *obj)
 
   G_OBJECT_CLASS (fbd_droid_leds_backend_aidl_parent_class)->constructed (obj);
 
-  self->service_manager = NULL;
-  self->remote = NULL;
-  self->client = NULL;
+  self->service = NULL;
 }
 
 static void
@@ -207,21 +295,21 @@ fbd_droid_leds_backend_aidl_dispose (GObject *obj)
 
   g_debug ("Disposing droid leds aidl");
 
-  if (self->client) {
-    gbinder_client_unref (self->client);
-  }
-  
-  if (self->remote) {
-    gbinder_remote_object_unref (self->remote);
-  }
-  
-  if (self->service_manager) {
-    gbinder_servicemanager_unref (self->service_manager);
-  }
+  g_clear_object (&self->service);
 
   G_OBJECT_CLASS (fbd_droid_leds_backend_aidl_parent_class)->dispose (obj);
 }
 
+static void
+fbd_droid_leds_backend_aidl_finalize (GObject *obj)
+{
+  FbdDroidLedsBackendAidl *self = FBD_DROID_LEDS_BACKEND_AIDL (obj);
+
+  g_mutex_clear (&self->state_lock);
+
+  G_OBJECT_CLASS (fbd_droid_leds_backend_aidl_parent_class)->finalize (obj);
+}
+
 static void
 fbd_droid_leds_backend_aidl_class_init (FbdDroidLedsBackendAidlClass *klass)
 {
@@ -229,6 +317,7 @@ fbd_droid_leds_backend_aidl_class_init (FbdDroidLedsBackendAidlClass *klass)
 
   object_class->constructed  = fbd_droid_leds_backend_aidl_constructed;
   object_class->dispose      = fbd_droid_leds_backend_aidl_dispose;
+  object_class->finalize     = fbd_droid_leds_backend_aidl_finalize;
 }
 
 static void
@@ -243,11 +332,27 @@ fbd_droid_leds_backend_interface_init (FbdDroidLedsBackendInterface *iface)
   iface->is_supported    = fbd_droid_leds_backend_aidl_is_supported;
   iface->start_periodic  = fbd_droid_leds_backend_aidl_start_periodic;
   iface->stop            = fbd_droid_leds_backend_aidl_stop;
+  iface->is_available    = fbd_droid_leds_backend_aidl_is_available;
+  iface->has_light       = fbd_droid_leds_backend_aidl_has_light;
 }
 
 static void
 fbd_droid_leds_backend_aidl_init (FbdDroidLedsBackendAidl *self)
 {
+  g_mutex_init (&self->state_lock);
+}
+
+/**
+ * fbd_droid_leds_backend_aidl_get_service:
+ *
+ * Returns:(transfer full): The shared light hal service
+ */
+FbdBinderService *
+fbd_droid_leds_backend_aidl_get_service (void)
+{
+  return fbd_binder_service_get (BINDER_LIGHT_DEFAULT_AIDL_DEVICE,
+                                 BINDER_LIGHT_AIDL_IFACE,
+                                 BINDER_LIGHT_AIDL_IFACE "/" BINDER_LIGHT_AIDL_SLOT);
 }
 
 FbdDroidLedsBackendAidl *
@@ -9,6 +9,7 @@
 #include <glib-object.h>
 #include <stdint.h>
 
+#include "fbd-binder.h"
 #include "fbd-droid-leds-backend.h"
 
 G_BEGIN_DECLS
@@ -25,5 +26,6 @@ typedef struct aidl_hw_light {
 } AidlHwLight;
 
 FbdDroidLedsBackendAidl *fbd_droid_leds_backend_aidl_new (GError **error);
+FbdBinderService *fbd_droid_leds_backend_aidl_get_service (void);
 
 G_END_DECLS
@@ -9,6 +9,7 @@
 #define G_LOG_DOMAIN "fbd-droid-leds-backend-hidl"
 
 #include <stdlib.h>
+#include <string.h>
 #include <glib.h>
 #include <glib-object.h>
 #include <gio/gio.h>
@@ -38,9 +39,16 @@ struct _FbdDroidLedsBackendHidl
 {
   GObject parent_instance;
 
-  GBinderServiceManager *service_manager;
-  GBinderRemoteObject   *remote;
-  GBinderClient         *client;
+  FbdBinderService      *service;
+
+  /* The HAL's light types, fetched once */
+  gboolean               types_loaded;
+  guint32                light_types; /* Bitmask of LightType */
+
+  /* Last state sent to the notification light */
+  GMutex                 state_lock;
+  gboolean               state_valid;
+  LightState             state;
 };
 
 static void initable_interface_init (GInitableIface *iface);
@@ -52,78 +60,152 @@ G_DEFINE_TYPE_WITH_CODE (FbdDroidLedsBackendHidl, fbd_droid_leds_backend_hidl, G
                                                 fbd_droid_leds_backend_interface_init))
 
 static gboolean
-fbd_droid_leds_backend_hidl_is_supported (FbdDroidLedsBackend *backend)
+fbd_droid_leds_backend_hidl_load_types (FbdDroidLedsBackendHidl *self)
 {
-  FbdDroidLedsBackendHidl *self = FBD_DROID_LEDS_BACKEND_HIDL (backend);
-  GBinderLocalRequest *req = gbinder_client_new_request (self->client);
+  GBinderLocalRequest *req = fbd_binder_service_new_request (self->service);
   GBinderRemoteReply *reply;
   GBinderReader reader;
   int status;
   gsize count = 0, vecSize = 0;
   const int32_t *types;
 
-  reply = gbinder_client_transact_sync_reply (self->client,
-                                              BINDER_LIGHT_HIDL_2_0_GET_SUPPORTED_TYPES,
-                                              req, &status);
+  if (req == NULL)
+    return FALSE;
+
+  reply = fbd_binder_service_transact_sync (self->service,
+                                            BINDER_LIGHT_HIDL_2_0_GET_SUPPORTED_TYPES,
+                                            req, &status);
   gbinder_local_request_unref (req);
 
+  if (status != GBINDER_STATUS_OK || reply == NULL) {
+    gbinder_remote_reply_unref (reply);
+    return FALSE;
+  }
+
   gbinder_remote_reply_init_reader (reply, &reader);
+  if (!fbd_binder_status_is_ok (&reader)) {
+    gbinder_remote_reply_unref (reply);
+    return FALSE;
+  }
 
-  if (status == GBINDER_STATUS_OK && fbd_binder_status_is_ok (&reader)) {
-    types = gbinder_reader_read_hidl_vec(&reader, &count, &vecSize);
-    for (int i = 0; i < count; i++) {
-        if (types[i] == LIGHT_TYPE_NOTIFICATIONS) {
-            g_debug ("droid LED usable");
-            return TRUE;
-        }
-    }
-    g_warning ("No suitable notification LED found");
-  } else {
-    g_warning ("Failed to get supported LED types");
+  types = gbinder_reader_read_hidl_vec (&reader, &count, &vecSize);
+  for (gsize i = 0; types && i < count; i++) {
+    g_debug ("Light type %d supported", types[i]);
+    if (types[i] >= 0 && types[i] < 32)
+      self->light_types |= 1u << types[i];
   }
 
-  return FALSE;
+  gbinder_remote_reply_unref (reply);
+  self->types_loaded = TRUE;
+  return TRUE;
+}
+
+static gboolean
+fbd_droid_leds_backend_hidl_has_light (FbdDroidLedsBackend *backend, LightType type)
+{
+  FbdDroidLedsBackendHidl *self = FBD_DROID_LEDS_BACKEND_HIDL (backend);
+
+  if (type >= 32)
+    return FALSE;
+
+  return !!(self->light_types & (1u << type));
 }
 
 static gboolean
-fbd_droid_leds_backend_hidl_start_periodic (FbdDroidLedsBackend *backend,
-                                            FbdFeedbackLedColor color,
-                                            guint               max_brightness,
-                                            guint               freq)
+fbd_droid_leds_backend_hidl_is_supported (FbdDroidLedsBackend *backend)
 {
   FbdDroidLedsBackendHidl *self = FBD_DROID_LEDS_BACKEND_HIDL (backend);
-  GBinderLocalRequest *req = gbinder_client_new_request (self->client);
+
+  if (!self->types_loaded && !fbd_droid_leds_backend_hidl_load_types (self)) {
+    g_warning ("Failed to get supported LED types");
+    return FALSE;
+  }
+
+  if (!fbd_droid_leds_backend_hidl_has_light (backend, LIGHT_TYPE_NOTIFICATIONS)) {
+    g_warning ("No suitable notification LED found");
+    return FALSE;
+  }
+
+  g_debug ("droid LED usable");
+  return TRUE;
+}
+
+/* Sends @state to the notification light unless it's already set */
+static gboolean
+fbd_droid_leds_backend_hidl_set_state (FbdDroidLedsBackendHidl *self,
+                                       const LightState        *state)
+{
+  GBinderLocalRequest *req;
   GBinderRemoteReply *reply;
   GBinderWriter writer;
-  LightState* notification_state;
-  int32_t status, argb_color, t;
+  LightState *notification_state;
+  gboolean unchanged, success;
+  int status;
 
-  argb_color = fbd_droid_leds_backend_get_argb_color (color, max_brightness);
-  t = 1000 * 1000 / freq / 2;
+  g_mutex_lock (&self->state_lock);
+  unchanged = self->state_valid && memcmp (&self->state, state, sizeof (*state)) == 0;
+  g_mutex_unlock (&self->state_lock);
+  if (unchanged) {
+    g_debug ("Notification LED state unchanged");
+    return TRUE;
+  }
+
+  req = fbd_binder_service_new_request (self->service);
+  if (req == NULL) {
+    g_warning ("Light hal not available");
+    return FALSE;
+  }
 
   gbinder_local_request_init_writer (req, &writer);
   notification_state = gbinder_writer_new0 (&writer, LightState);
-  notification_state->color = argb_color;
-  notification_state->flashMode = FLASH_TYPE_TIMED;
-  notification_state->flashOnMs = t;
-  notification_state->flashOffMs = t;
-  notification_state->brightnessMode = BRIGHTNESS_MODE_USER;
+  *notification_state = *state;
 
   gbinder_writer_append_int32 (&writer, LIGHT_TYPE_NOTIFICATIONS);
   gbinder_writer_append_buffer_object (&writer, notification_state,
     sizeof(*notification_state));
 
-  reply = gbinder_client_transact_sync_reply (self->client,
-                                              BINDER_LIGHT_HIDL_2_0_SET_LIGHT,
-                                              req, &status);
+  reply = fbd_binder_service_transact_sync (self->service,
+                                            BINDER_LIGHT_HIDL_2_0_SET_LIGHT,
+                                            req, &status);
   gbinder_local_request_unref (req);
-  
-  if (status == GBINDER_STATUS_OK && fbd_binder_reply_status_is_ok (reply)) {
-    return TRUE;
-  } else {
+
+  success = status == GBINDER_STATUS_OK && reply && fbd_binder_reply_status_is_ok (reply);
+  gbinder_remote_reply_unref (reply);
+
+  /* On failure we don't know what the light shows */
+  g_mutex_lock (&self->state_lock);
+  self->state = *state;
+  self->state_valid = success;
+  g_mutex_unlock (&self->state_lock);
+
+  return success;
+}
+
+static gboolean
+fbd_droid_leds_backend_hidl_start_periodic (FbdDroidLedsBackend  *backend,
+                                            FbdFeedbackLedColor   color,
+                                            const FbdLedRgbColor *rgb,
+                                            guint                 max_brightness,
+                                            guint                 freq)
+{
+  FbdDroidLedsBackendHidl *self = FBD_DROID_LEDS_BACKEND_HIDL (backend);
+  LightState state = { 0 };
+  int32_t t;
+
+  t = 1000 * 1000 / freq / 2;
+
+  state.color = fbd_droid_leds_backend_get_argb_color (color, rgb, max_brightness);
+  state.flashMode = FLASH_TYPE_TIMED;
+  state.flashOnMs = t;
+  state.flashOffMs = t;
+  state.brightnessMode = BRIGHTNESS_MODE_USER;
+
+  if (!fbd_droid_leds_backend_hidl_set_state (self, &state)) {
     g_warning ("Unable to turn to set notification LED");
     return FALSE;
   }
+
+  return TRUE;
 }
 
 static gboolean
@@ -131,35 +213,36 @@ fbd_droid_leds_backend_hidl_stop (FbdDroidLedsBackend *backend,
                                   FbdFeedbackLedColor  color)
 {
   FbdDroidLedsBackendHidl *self = FBD_DROID_LEDS_BACKEND_HIDL (backend);
-  GBinderLocalRequest *req = gbinder_client_new_request (self->client);
-  GBinderRemoteReply *reply;
-  GBinderWriter writer;
-  LightState* notification_state;
-  int status;
+  LightState state = { 0 };
 
-  gbinder_local_request_init_writer (req, &writer);
-  notification_state = gbinder_writer_new0 (&writer, LightState);
-  notification_state->color = 0;
-  notification_state->flashMode = FLASH_TYPE_NONE;
-  notification_state->flashOnMs = 0;
-  notification_state->flashOffMs = 0;
-  notification_state->brightnessMode = BRIGHTNESS_MODE_USER;
-
-  gbinder_writer_append_int32 (&writer, LIGHT_TYPE_NOTIFICATIONS);
-  gbinder_writer_append_buffer_object (&writer, notification_state,
-    sizeof(*notification_state));
+  state.flashMode = FLASH_TYPE_NONE;
+  state.brightnessMode = BRIGHTNESS_MODE_USER;
 
-  reply = gbinder_client_transact_sync_reply (self->client,
-                                              BINDER_LIGHT_HIDL_2_0_SET_LIGHT,
-                                              req, &status);
-  gbinder_local_request_unref (req);
-  
-  if (status == GBINDER_STATUS_OK && fbd_binder_reply_status_is_ok (reply)) {
-    return TRUE;
-  } else {
+  if (!fbd_droid_leds_backend_hidl_set_state (self, &state)) {
     g_warning ("Unable to stop notification LED");
     return FALSE;
   }
+
+  return TRUE;
+}
+
+static gboolean
+fbd_droid_leds_backend_hidl_is_available (FbdDroidLedsBackend *backend)
+{
+  FbdDroidLedsBackendHidl *self = FBD_DROID_LEDS_BACKEND_HIDL (backend);
+
+  return fbd_binder_service_is_available (self->service);
+}
+
+static void
+on_service_reconnected (FbdDroidLedsBackendHidl *self)
+{
+  /* The restarted HAL lost the light state */
+  g_mutex_lock (&self->state_lock);
+  self->state_valid = FALSE;
+  g_mutex_unlock (&self->state_lock);
+
+  g_signal_emit_by_name (self, "reconnected");
 }
 
 static gboolean
@@ -168,24 +251,22 @@ initable_init (GInitable     *initable,
                GError       **error)
 {
   FbdDroidLedsBackendHidl *self = FBD_DROID_LEDS_BACKEND_HIDL (initable);
-  gboolean success;
 
   g_debug ("Initializing droid leds hidl");
 
-  success = fbd_binder_init (BINDER_LIGHT_DEFAULT_HIDL_DEVICE,
-                             BINDER_LIGHT_HIDL_2_0_IFACE,
-                             (BINDER_LIGHT_HIDL_2_0_IFACE "/" BINDER_LIGHT_HIDL_SLOT),
-                             &self->service_manager,
-                             &self->remote,
-                             &self->client);
-
-  if (!success) {
+  self->service = fbd_droid_leds_backend_hidl_get_service ();
+  if (!fbd_binder_service_resolve (self->service, NULL)) {
     g_set_error (error,
                  G_IO_ERROR, G_IO_ERROR_FAILED,
                  "Failed to obtain suitable light hal");
     return FALSE;
   }
 
+  g_signal_connect_object (self->service, "reconnected",
+                           G_CALLBACK (on_service_reconnected),
+                           self,
+                           G_CONNECT_SWAPPED);
+
   return TRUE;
 }
 
@@ -196,9 +277,7 @@ fbd_droid_leds_backend_hidl_constructed (GObject *obj)
 
   G_OBJECT_CLASS (fbd_droid_leds_backend_hidl_parent_class)->constructed (obj);
 
-  self->service_manager = NULL;
-  self->remote = NULL;
-  self->client = NULL;
+  self->service = NULL;
 }
 
 static void
@@ -208,21 +287,21 @@ fbd_droid_leds_backend_hidl_dispose (GObject *obj)
 
   g_debug ("Disposing droid leds hidl");
 
-  if (self->client) {
-    gbinder_client_unref (self->client);
-  }
-  
-  if (self->remote) {
-    gbinder_remote_object_unref (self->remote);
-  }
-  
-  if (self->service_manager) {
-    gbinder_servicemanager_unref (self->service_manager);
-  }
+  g_clear_object (&self->service);
 
   G_OBJECT_CLASS (fbd_droid_leds_backend_hidl_parent_class)->dispose (obj);
 }
 
+static void
+fbd_droid_leds_backend_hidl_finalize (GObject *obj)
+{
+  FbdDroidLedsBackendHidl *self = FBD_DROID_LEDS_BACKEND_HIDL (obj);
+
+  g_mutex_clear (&self->state_lock);
+
+  G_OBJECT_CLASS (fbd_droid_leds_backend_hidl_parent_class)->finalize (obj);
+}
+
 static void
 fbd_droid_leds_backend_hidl_class_init (FbdDroidLedsBackendHidlClass *klass)
 {
@@ -230,6 +309,7 @@ fbd_droid_leds_backend_hidl_class_init (FbdDroidLedsBackendHidlClass *klass)
 
   object_class->constructed  = fbd_droid_leds_backend_hidl_constructed;
   object_class->dispose      = fbd_droid_leds_backend_hidl_dispose;
+  object_class->finalize     = fbd_droid_leds_backend_hidl_finalize;
 }
 
 static void
@@ -244,11 +324,27 @@ fbd_droid_leds_backend_interface_init (FbdDroidLedsBackendInterface *iface)
   iface->is_supported    = fbd_droid_leds_backend_hidl_is_supported;
   iface->start_periodic  = fbd_droid_leds_backend_hidl_start_periodic;
   iface->stop            = fbd_droid_leds_backend_hidl_stop;
+  iface->is_available    = fbd_droid_leds_backend_hidl_is_available;
+  iface->has_light       = fbd_droid_leds_backend_hidl_has_light;
 }
 
 static void
 fbd_droid_leds_backend_hidl_init (FbdDroidLedsBackendHidl *self)
 {
+  g_mutex_init (&self->state_lock);
+}
+
+/**
+ * fbd_droid_leds_backend_hidl_get_service:
+ *
+ * Returns:(transfer full): The shared light hal service
+ */
+FbdBinderService *
+fbd_droid_leds_backend_hidl_get_service (void)
+{
+  return fbd_binder_service_get (BINDER_LIGHT_DEFAULT_HIDL_DEVICE,
+                                 BINDER_LIGHT_HIDL_2_0_IFACE,
+                                 BINDER_LIGHT_HIDL_2_0_IFACE "/" BINDER_LIGHT_HIDL_SLOT);
 }
 
 FbdDroidLedsBackendHidl *
@@ -8,11 +8,14 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <glib-unix.h>
 #include <gio/gio.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <stdint.h>
 #include <string.h>
+#include <sys/timerfd.h>
 
 #include "fbd-droid-leds-backend.h"
 #include "fbd-droid-leds-backend-sysfs.h"
@@ -22,10 +25,39 @@
 #define MAX_BRIGHTNESS_FILE "max_brightness"
 #define BLINK_FILE "blink"
 
+typedef enum {
+  CHANNEL_RED,
+  CHANNEL_GREEN,
+  CHANNEL_BLUE,
+  N_CHANNELS,
+} FbdDroidLedsSysfsChannelId;
+
+static const char * const channel_names[N_CHANNELS] = { "red", "green", "blue" };
+
+typedef struct {
+  int   brightness_fd;
+  int   blink_fd;        /* -1 if the kernel can't blink the LED */
+  guint max_brightness;
+  guint level;           /* Brightness while lit, 0 if unused */
+} FbdDroidLedsSysfsChannel;
+
+/*
+ * The LED nodes are opened and max_brightness is read once. If the
+ * kernel can blink all LEDs needed for a color it does so and we stay
+ * idle, otherwise a timerfd toggles the LEDs. Requests come in from the
+ * io worker while the timer fires in the main context, hence the lock.
+ */
 struct _FbdDroidLedsBackendSysfs
 {
   GObject parent_instance;
-  gchar *led_paths[3];
+
+  FbdDroidLedsSysfsChannel channels[N_CHANNELS];
+  int                      timer_fd;
+  guint                    timer_id;
+
+  GMutex                   lock;
+  gboolean                 blinking;
+  gboolean                 lit;
 };
 
 static void initable_interface_init (GInitableIface *iface);
@@ -37,111 +69,105 @@ G_DEFINE_TYPE_WITH_CODE (FbdDroidLedsBackendSysfs, fbd_droid_leds_backend_sysfs,
                                                 fbd_droid_leds_backend_interface_init))
 
 static gboolean
-set_led_brightness (const gchar *led_path,
-                    guint brightness)
-{
-  GError *error = NULL;
-  gboolean result = FALSE;
-  gchar *brightness_str, *blink_str;
-  gchar *brightness_path, *blink_path;
-
-  brightness_path = g_build_filename (led_path, BRIGHTNESS_FILE, NULL);
-  blink_path = g_build_filename (led_path, BLINK_FILE, NULL);
-
-  brightness_str = g_strdup_printf ("%d", brightness);
-  blink_str = g_strdup_printf ("%d", brightness > 0 ? 1 : 0);
-
-  if (g_file_test (brightness_path, G_FILE_TEST_EXISTS)) {
-    GFile *brightness_file = g_file_new_for_path (brightness_path);
-    GFileOutputStream *brightness_stream = g_file_replace (brightness_file,
-                                                           NULL,
-                                                           FALSE,
-                                                           G_FILE_CREATE_NONE,
-                                                           NULL,
-                                                           &error);
-
-    if (error) {
-      g_warning ("Failed to open %s: %s", brightness_path, error->message);
-      g_error_free (error);
-      error = NULL;
-    } else {
-      if (!g_output_stream_write_all (G_OUTPUT_STREAM (brightness_stream),
-                                      brightness_str,
-                                      strlen (brightness_str),
-                                      NULL,
-                                      NULL,
-                                      &error)) {
-        g_warning ("Failed to write to %s: %s", brightness_path, error->message);
-        g_error_free (error);
-        error = NULL;
-      } else {
-        result = TRUE;
-      }
-      g_object_unref (brightness_stream);
-    }
-    g_object_unref (brightness_file);
+write_to_sysfs (int fd, const char *name, guint value)
+{
+  char buf[16];
+  gsize len;
+  gssize ret;
+
+  len = g_snprintf (buf, sizeof (buf), "%u", value);
+
+  do {
+    ret = pwrite (fd, buf, len, 0);
+  } while (ret < 0 && errno == EINTR);
+
+  if (ret < 0 || (gsize) ret != len) {
+    g_warning ("Unable to write '%s' to %s: %s", buf, name,
+               ret < 0 ? g_strerror (errno) : "short write");
+    return FALSE;
   }
 
-  if (g_file_test (blink_path, G_FILE_TEST_EXISTS)) {
-    GFile *blink_file = g_file_new_for_path (blink_path);
-    GFileOutputStream *blink_stream = g_file_replace (blink_file,
-                                                      NULL,
-                                                      FALSE,
-                                                      G_FILE_CREATE_NONE,
-                                                      NULL,
-                                                      &error);
-
-    if (error) {
-      g_warning ("Failed to open %s: %s", blink_path, error->message);
-      g_error_free (error);
-      error = NULL;
-    } else {
-      if (!g_output_stream_write_all (G_OUTPUT_STREAM (blink_stream),
-                                      blink_str,
-                                      strlen (blink_str),
-                                      NULL,
-                                      NULL,
-                                      &error)) {
-        g_warning ("Failed to write to %s: %s", blink_path, error->message);
-        g_error_free (error);
-        error = NULL;
-      } else {
-        result = TRUE;
-      }
-      g_object_unref (blink_stream);
-    }
-    g_object_unref (blink_file);
+  return TRUE;
+}
+
+static gboolean
+set_channel_brightness (FbdDroidLedsSysfsChannel *channel,
+                        FbdDroidLedsSysfsChannelId id,
+                        guint                     brightness)
+{
+  if (channel->brightness_fd < 0)
+    return TRUE;
+
+  return write_to_sysfs (channel->brightness_fd, channel_names[id], brightness);
+}
+
+static gboolean
+set_channel_blink (FbdDroidLedsSysfsChannel   *channel,
+                   FbdDroidLedsSysfsChannelId  id,
+                   gboolean                    blink)
+{
+  if (channel->blink_fd < 0)
+    return TRUE;
+
+  return write_to_sysfs (channel->blink_fd, channel_names[id], blink);
+}
+
+/* Called with the lock held */
+static void
+set_timer (FbdDroidLedsBackendSysfs *self, guint interval_ms)
+{
+  struct itimerspec spec = { 0 };
+
+  spec.it_interval.tv_sec = interval_ms / 1000;
+  spec.it_interval.tv_nsec = (interval_ms % 1000) * 1000 * 1000;
+  spec.it_value = spec.it_interval;
+
+  if (timerfd_settime (self->timer_fd, 0, &spec, NULL) < 0)
+    g_warning ("Failed to set LED timer: %s", g_strerror (errno));
+
+  self->blinking = !!interval_ms;
+}
+
+static gboolean
+on_timer_expired (gint fd, GIOCondition condition, gpointer user_data)
+{
+  FbdDroidLedsBackendSysfs *self = FBD_DROID_LEDS_BACKEND_SYSFS (user_data);
+  uint64_t expirations;
+
+  if (read (fd, &expirations, sizeof (expirations)) != sizeof (expirations))
+    return G_SOURCE_CONTINUE;
+
+  g_mutex_lock (&self->lock);
+  /* Stopped meanwhile */
+  if (!self->blinking) {
+    g_mutex_unlock (&self->lock);
+    return G_SOURCE_CONTINUE;
   }
 
-  g_free (brightness_path);
-  g_free (brightness_str);
-  g_free (blink_path);
-  g_free (blink_str);
+  self->lit = !self->lit;
+  for (int i = 0; i < N_CHANNELS; i++) {
+    FbdDroidLedsSysfsChannel *channel = &self->channels[i];
 
-  return result;
+    if (channel->level)
+      set_channel_brightness (channel, i, self->lit ? channel->level : 0);
+  }
+  g_mutex_unlock (&self->lock);
+
+  return G_SOURCE_CONTINUE;
 }
 
 static guint
-get_max_brightness (const gchar *led_path)
+read_max_brightness (const char *led_path)
 {
-  gchar *max_brightness_path;
-  gchar *contents = NULL;
-  gsize length;
-  guint max_brightness = 1;
+  g_autofree char *max_brightness_path = NULL;
+  g_autofree char *contents = NULL;
+  guint max_brightness = 0;
 
   max_brightness_path = g_build_filename (led_path, MAX_BRIGHTNESS_FILE, NULL);
+  if (g_file_get_contents (max_brightness_path, &contents, NULL, NULL))
+    max_brightness = (guint) g_ascii_strtoull (contents, NULL, 10);
 
-  if (g_file_test (max_brightness_path, G_FILE_TEST_EXISTS)) {
-    if (g_file_get_contents (max_brightness_path, &contents, &length, NULL)) {
-      max_brightness = (guint) g_ascii_strtoull (contents, NULL, 10);
-      if (max_brightness == 0)
-        max_brightness = 1;
-      g_free (contents);
-    }
-  }
-
-  g_free (max_brightness_path);
-  return max_brightness;
+  return max_brightness ?: 1;
 }
 
 static gboolean
@@ -151,22 +177,65 @@ fbd_droid_leds_backend_sysfs_is_supported (FbdDroidLedsBackend *backend)
 }
 
 static gboolean
-fbd_droid_leds_backend_sysfs_start_periodic (FbdDroidLedsBackend *backend,
-                                             FbdFeedbackLedColor color,
-                                             guint               max_brightness,
-                                             guint               freq)
+fbd_droid_leds_backend_sysfs_start_periodic (FbdDroidLedsBackend  *backend,
+                                             FbdFeedbackLedColor   color,
+                                             const FbdLedRgbColor *rgb,
+                                             guint                 max_brightness,
+                                             guint                 freq)
 {
   FbdDroidLedsBackendSysfs *self = FBD_DROID_LEDS_BACKEND_SYSFS (backend);
+  FbdLedRgbColor mix;
+  guint components[N_CHANNELS];
+  gboolean kernel_blink = TRUE, success = TRUE;
+
   g_return_val_if_fail (FBD_IS_DROID_LEDS_BACKEND_SYSFS (self), FALSE);
 
-  gboolean success = TRUE;
+  fbd_droid_leds_backend_get_rgb (color, rgb, &mix);
+  components[CHANNEL_RED] = mix.r;
+  components[CHANNEL_GREEN] = mix.g;
+  components[CHANNEL_BLUE] = mix.b;
+  max_brightness = MIN (max_brightness, 100);
+
+  g_mutex_lock (&self->lock);
+  set_timer (self, 0);
+
+  for (int i = 0; i < N_CHANNELS; i++) {
+    FbdDroidLedsSysfsChannel *channel = &self->channels[i];
+
+    channel->level = 0;
+    if (channel->brightness_fd < 0 || components[i] == 0)
+      continue;
 
-  for (int i = 0; i < 3; ++i) {
-    guint brightness_value = get_max_brightness (self->led_paths[i]);
-    if (!set_led_brightness (self->led_paths[i], brightness_value))
+    channel->level = channel->max_brightness * components[i] * max_brightness / (0xff * 100);
+    /* Keep dim components visible */
+    channel->level = MAX (channel->level, 1);
+    if (channel->blink_fd < 0)
+      kernel_blink = FALSE;
+  }
+
+  for (int i = 0; i < N_CHANNELS; i++) {
+    FbdDroidLedsSysfsChannel *channel = &self->channels[i];
+
+    if (!set_channel_blink (channel, i, FALSE))
+      success = FALSE;
+    if (!set_channel_brightness (channel, i, channel->level))
       success = FALSE;
   }
 
+  if (kernel_blink) {
+    for (int i = 0; i < N_CHANNELS; i++) {
+      FbdDroidLedsSysfsChannel *channel = &self->channels[i];
+
+      if (channel->level && !set_channel_blink (channel, i, TRUE))
+        success = FALSE;
+    }
+  } else if (freq) {
+    /* freq is in mHz, toggle twice per period */
+    self->lit = TRUE;
+    set_timer (self, MAX (1000 * 1000 / freq / 2, 1));
+  }
+  g_mutex_unlock (&self->lock);
+
   return success;
 }
 
@@ -175,14 +244,23 @@ fbd_droid_leds_backend_sysfs_stop (FbdDroidLedsBackend *backend,
                                    FbdFeedbackLedColor  color)
 {
   FbdDroidLedsBackendSysfs *self = FBD_DROID_LEDS_BACKEND_SYSFS (backend);
+  gboolean success = TRUE;
+
   g_return_val_if_fail (FBD_IS_DROID_LEDS_BACKEND_SYSFS (self), FALSE);
 
-  gboolean success = TRUE;
+  g_mutex_lock (&self->lock);
+  set_timer (self, 0);
+
+  for (int i = 0; i < N_CHANNELS; i++) {
+    FbdDroidLedsSysfsChannel *channel = &self->channels[i];
 
-  for (int i = 0; i < 3; ++i) {
-    if (!set_led_brightness (self->led_paths[i], 0))
+    channel->level = 0;
+    if (!set_channel_blink (channel, i, FALSE))
+      success = FALSE;
+    if (!set_channel_brightness (channel, i, 0))
       success = FALSE;
   }
+  g_mutex_unlock (&self->lock);
 
   return success;
 }
@@ -192,6 +270,44 @@ initable_init (GInitable     *initable,
                GCancellable  *cancellable,
                GError       **error)
 {
+  FbdDroidLedsBackendSysfs *self = FBD_DROID_LEDS_BACKEND_SYSFS (initable);
+  gboolean found = FALSE;
+
+  for (int i = 0; i < N_CHANNELS; i++) {
+    FbdDroidLedsSysfsChannel *channel = &self->channels[i];
+    g_autofree char *led_path = g_build_filename (LED_PATH, channel_names[i], NULL);
+    g_autofree char *brightness_path = g_build_filename (led_path, BRIGHTNESS_FILE, NULL);
+    g_autofree char *blink_path = g_build_filename (led_path, BLINK_FILE, NULL);
+
+    channel->brightness_fd = open (brightness_path, O_WRONLY | O_CLOEXEC);
+    if (channel->brightness_fd < 0) {
+      g_debug ("No usable %s LED: %s", channel_names[i], g_strerror (errno));
+      continue;
+    }
+
+    channel->blink_fd = open (blink_path, O_WRONLY | O_CLOEXEC);
+    channel->max_brightness = read_max_brightness (led_path);
+    g_debug ("Found %s LED, max brightness %u, %s blink",
+             channel_names[i], channel->max_brightness,
+             channel->blink_fd < 0 ? "software" : "kernel");
+    found = TRUE;
+  }
+
+  if (!found) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No usable LED found");
+    return FALSE;
+  }
+
+  self->timer_fd = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (self->timer_fd < 0) {
+    int err = errno;
+
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (err),
+                 "Failed to create LED timer: %s", g_strerror (err));
+    return FALSE;
+  }
+  self->timer_id = g_unix_fd_add (self->timer_fd, G_IO_IN, on_timer_expired, self);
+
   return TRUE;
 }
 
@@ -200,8 +316,18 @@ fbd_droid_leds_backend_sysfs_finalize (GObject *object)
 {
   FbdDroidLedsBackendSysfs *self = FBD_DROID_LEDS_BACKEND_SYSFS (object);
 
-  for (int i = 0; i < 3; ++i)
-    g_free (self->led_paths[i]);
+  g_clear_handle_id (&self->timer_id, g_source_remove);
+  if (self->timer_fd >= 0)
+    close (self->timer_fd);
+
+  for (int i = 0; i < N_CHANNELS; i++) {
+    if (self->channels[i].brightness_fd >= 0)
+      close (self->channels[i].brightness_fd);
+    if (self->channels[i].blink_fd >= 0)
+      close (self->channels[i].blink_fd);
+  }
+
+  g_mutex_clear (&self->lock);
 
   G_OBJECT_CLASS (fbd_droid_leds_backend_sysfs_parent_class)->finalize (object);
 }
@@ -231,13 +357,21 @@ fbd_droid_leds_backend_interface_init (FbdDroidLedsBackendInterface *iface)
 static void
 fbd_droid_leds_backend_sysfs_init (FbdDroidLedsBackendSysfs *self)
 {
-  self->led_paths[0] = g_strdup (LED_PATH "blue");
-  self->led_paths[1] = g_strdup (LED_PATH "green");
-  self->led_paths[2] = g_strdup (LED_PATH "red");
+  g_mutex_init (&self->lock);
+  self->timer_fd = -1;
+
+  for (int i = 0; i < N_CHANNELS; i++) {
+    self->channels[i].brightness_fd = -1;
+    self->channels[i].blink_fd = -1;
+  }
 }
 
 FbdDroidLedsBackendSysfs *
 fbd_droid_leds_backend_sysfs_new (GError **error)
 {
-  return g_object_new (FBD_TYPE_DROID_LEDS_BACKEND_SYSFS, NULL);
+  return FBD_DROID_LEDS_BACKEND_SYSFS (
+    g_initable_new (FBD_TYPE_DROID_LEDS_BACKEND_SYSFS,
+                    NULL,
+                    error,
+                    NULL));
 }
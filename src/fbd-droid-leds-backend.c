@@ -15,35 +15,77 @@ G_DEFINE_INTERFACE (FbdDroidLedsBackend, fbd_droid_leds_backend, G_TYPE_OBJECT)
 static void
 fbd_droid_leds_backend_default_init (FbdDroidLedsBackendInterface *iface)
 {
-    /* Nothing yet */
+  /**
+   * FbdDroidLedsBackend::reconnected:
+   *
+   * Emitted when the HAL is reachable again after it went away.
+   */
+  g_signal_new ("reconnected",
+                G_TYPE_FROM_INTERFACE (iface),
+                G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+                NULL,
+                G_TYPE_NONE,
+                0);
 }
 
-int32_t
-fbd_droid_leds_backend_get_argb_color (FbdFeedbackLedColor color,
-                                       guint               max_brightness)
+/**
+ * fbd_droid_leds_backend_get_rgb:
+ * @color: The requested color
+ * @rgb: (nullable): The color's RGB value if @color is %FBD_FEEDBACK_LED_COLOR_RGB
+ * @mix: (out): The resulting color mix, each component in the range 0 to 255
+ *
+ * Converts a requested color into the mix of red, green and blue to show.
+ */
+void
+fbd_droid_leds_backend_get_rgb (FbdFeedbackLedColor   color,
+                                const FbdLedRgbColor *rgb,
+                                FbdLedRgbColor       *mix)
 {
-  int32_t alpha, max, argb_color;
+  mix->r = mix->g = mix->b = 0;
 
-  max = (max_brightness / 100.0) * 0xff;
-  alpha = 0xff; // Full Alpha
-
-  argb_color = (alpha & 0xff) << 24;
   switch (color) {
-      case FBD_FEEDBACK_LED_COLOR_WHITE:
-          argb_color += ((max & 0xff) << 16) + ((max & 0xff) << 8) + (max & 0xff);
-          break;
-      case FBD_FEEDBACK_LED_COLOR_RED:
-          argb_color += (max & 0xff) << 16;
-          break;
-      case FBD_FEEDBACK_LED_COLOR_GREEN:
-          argb_color += (max & 0xff) << 8;
-          break;
-      case FBD_FEEDBACK_LED_COLOR_BLUE:
-          argb_color += max & 0xff;
-          break;
+  case FBD_FEEDBACK_LED_COLOR_WHITE:
+  case FBD_FEEDBACK_LED_COLOR_FLASH:
+    mix->r = mix->g = mix->b = 0xff;
+    break;
+  case FBD_FEEDBACK_LED_COLOR_RED:
+    mix->r = 0xff;
+    break;
+  case FBD_FEEDBACK_LED_COLOR_GREEN:
+    mix->g = 0xff;
+    break;
+  case FBD_FEEDBACK_LED_COLOR_BLUE:
+    mix->b = 0xff;
+    break;
+  case FBD_FEEDBACK_LED_COLOR_RGB:
+    if (rgb) {
+      mix->r = MIN (rgb->r, 0xff);
+      mix->g = MIN (rgb->g, 0xff);
+      mix->b = MIN (rgb->b, 0xff);
+    }
+    break;
+  default:
+    g_return_if_reached ();
   }
+}
+
+int32_t
+fbd_droid_leds_backend_get_argb_color (FbdFeedbackLedColor   color,
+                                       const FbdLedRgbColor *rgb,
+                                       guint                 max_brightness)
+{
+  FbdLedRgbColor mix;
+  uint32_t argb_color;
+
+  fbd_droid_leds_backend_get_rgb (color, rgb, &mix);
+  max_brightness = MIN (max_brightness, 100);
 
-  return argb_color;
+  argb_color = 0xffu << 24; // Full Alpha
+  argb_color |= ((mix.r * max_brightness / 100) & 0xff) << 16;
+  argb_color |= ((mix.g * max_brightness / 100) & 0xff) << 8;
+  argb_color |= (mix.b * max_brightness / 100) & 0xff;
+
+  return (int32_t) argb_color;
 }
 
 gboolean
@@ -59,10 +101,11 @@ fbd_droid_leds_backend_is_supported (FbdDroidLedsBackend *self)
 }
 
 gboolean
-fbd_droid_leds_backend_start_periodic (FbdDroidLedsBackend *self,
-                                       FbdFeedbackLedColor color,
-                                       guint               max_brightness,
-                                       guint               freq)
+fbd_droid_leds_backend_start_periodic (FbdDroidLedsBackend  *self,
+                                       FbdFeedbackLedColor   color,
+                                       const FbdLedRgbColor *rgb,
+                                       guint                 max_brightness,
+                                       guint                 freq)
 {
   FbdDroidLedsBackendInterface *iface;
   
@@ -70,7 +113,7 @@ fbd_droid_leds_backend_start_periodic (FbdDroidLedsBackend *self,
   
   iface = FBD_DROID_LEDS_BACKEND_GET_IFACE (self);
   g_return_val_if_fail (iface->start_periodic != NULL, FALSE);
-  return iface->start_periodic (self, color, max_brightness, freq);
+  return iface->start_periodic (self, color, rgb, max_brightness, freq);
 }
 
 gboolean
@@ -85,3 +128,53 @@ fbd_droid_leds_backend_stop (FbdDroidLedsBackend *self,
   g_return_val_if_fail (iface->stop != NULL, FALSE);
   return iface->stop (self, color);
 }
+
+/**
+ * fbd_droid_leds_backend_is_available:
+ * @self: The backend
+ *
+ * Whether the HAL is currently reachable. Backends whose HAL can go away
+ * emit #FbdDroidLedsBackend::reconnected once it's back. This can be
+ * called from any thread.
+ *
+ * Returns: %TRUE if requests can be sent
+ */
+gboolean
+fbd_droid_leds_backend_is_available (FbdDroidLedsBackend *self)
+{
+  FbdDroidLedsBackendInterface *iface;
+
+  g_return_val_if_fail (FBD_IS_DROID_LEDS_BACKEND (self), FALSE);
+
+  iface = FBD_DROID_LEDS_BACKEND_GET_IFACE (self);
+  if (iface->is_available == NULL)
+    return TRUE;
+
+  return iface->is_available (self);
+}
+
+/**
+ * fbd_droid_leds_backend_has_light:
+ * @self: The backend
+ * @type: The light type
+ *
+ * Whether the HAL has a light of the given type. The HAL's lights are
+ * fetched once when the backend is set up. Backends that don't know
+ * about the HAL's lights only drive a notification light.
+ *
+ * Returns: %TRUE if there's a light of type @type
+ */
+gboolean
+fbd_droid_leds_backend_has_light (FbdDroidLedsBackend *self,
+                                  LightType            type)
+{
+  FbdDroidLedsBackendInterface *iface;
+
+  g_return_val_if_fail (FBD_IS_DROID_LEDS_BACKEND (self), FALSE);
+
+  iface = FBD_DROID_LEDS_BACKEND_GET_IFACE (self);
+  if (iface->has_light == NULL)
+    return type == LIGHT_TYPE_NOTIFICATIONS;
+
+  return iface->has_light (self, type);
+}
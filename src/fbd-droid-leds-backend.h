@@ -60,22 +60,37 @@ struct _FbdDroidLedsBackendInterface
   GTypeInterface parent_iface;
 
   gboolean (*is_supported) (FbdDroidLedsBackend *self);
-  gboolean (*start_periodic) (FbdDroidLedsBackend *self,
-                              FbdFeedbackLedColor color,
-                              guint               max_brightness,
-                              guint               freq);
+  gboolean (*start_periodic) (FbdDroidLedsBackend  *self,
+                              FbdFeedbackLedColor   color,
+                              const FbdLedRgbColor *rgb,
+                              guint                 max_brightness,
+                              guint                 freq);
   gboolean (*stop) (FbdDroidLedsBackend *self,
                     FbdFeedbackLedColor color);
+
+  /* Optional, for backends whose HAL can go away */
+  gboolean (*is_available) (FbdDroidLedsBackend *self);
+  /* Optional, for backends that know the HAL's lights */
+  gboolean (*has_light) (FbdDroidLedsBackend *self,
+                         LightType            type);
 };
 
-int32_t fbd_droid_leds_backend_get_argb_color (FbdFeedbackLedColor color,
-                                               guint               max_brightness);
+void fbd_droid_leds_backend_get_rgb (FbdFeedbackLedColor   color,
+                                     const FbdLedRgbColor *rgb,
+                                     FbdLedRgbColor       *mix);
+int32_t fbd_droid_leds_backend_get_argb_color (FbdFeedbackLedColor   color,
+                                               const FbdLedRgbColor *rgb,
+                                               guint                 max_brightness);
 gboolean fbd_droid_leds_backend_is_supported (FbdDroidLedsBackend *self);
-gboolean fbd_droid_leds_backend_start_periodic (FbdDroidLedsBackend *self,
-                                                FbdFeedbackLedColor color,
-                                                guint               max_brightness,
-                                                guint               freq);
+gboolean fbd_droid_leds_backend_start_periodic (FbdDroidLedsBackend  *self,
+                                                FbdFeedbackLedColor   color,
+                                                const FbdLedRgbColor *rgb,
+                                                guint                 max_brightness,
+                                                guint                 freq);
 gboolean fbd_droid_leds_backend_stop (FbdDroidLedsBackend  *self,
                                       FbdFeedbackLedColor color);
+gboolean fbd_droid_leds_backend_is_available (FbdDroidLedsBackend *self);
+gboolean fbd_droid_leds_backend_has_light (FbdDroidLedsBackend *self,
+                                           LightType            type);
 
 G_END_DECLS
@@ -13,6 +13,7 @@
 
 #include "fbd-droid-leds.h"
 #include "fbd-binder.h"
+#include "fbd-io-worker.h"
 
 #include "fbd-droid-leds-backend.h"
 #include "fbd-droid-leds-backend-hidl.h"
@@ -28,19 +29,107 @@
  * @short_description: Android LED device interface (gbinder)
  * @Title: FbdDroidLeds
  *
- * #FbdDevLeds is used to interface with LEDS via gbinder.
+ * #FbdDevLeds is used to interface with LEDS via gbinder. Backend calls
+ * happen in an #FbdIoWorker, a newer LED state supersedes a not yet
+ * applied one. If the HAL goes away (e.g. restarting) the latest LED
+ * state is applied once it's back.
+ *
+ * There's a single notification light that can't play patterns made
+ * of several blinks so out of all claims the most important one is
+ * shown. The light is only updated when that changes.
  */
 
 typedef struct _FbdDevLeds {
     GObject      parent;
 
     FbdDroidLedsBackend *backend;
+    FbdIoWorker *worker;
+
+    /* Latest requested state, reapplied when the HAL comes back */
+    FbdFeedbackLedColor color;
+    FbdLedRgbColor rgb;
+    guint max_brightness;
+    guint freq;
+
+    /* Active claims, most important first */
+    GPtrArray *claims;
 } FbdDevLeds;
 
+typedef struct {
+    gconstpointer       owner;
+    guint               priority;
+    FbdFeedbackLedColor color;
+    FbdLedRgbColor      rgb;
+    guint               max_brightness;
+    guint               freq;
+} FbdDevLedsClaim;
+
+typedef struct {
+    FbdDevLeds         *self;
+    FbdFeedbackLedColor color;
+    FbdLedRgbColor      rgb;
+    guint               max_brightness;
+    guint               freq; /* 0 turns the LED off */
+} FbdDevLedsCmd;
+
 static void initable_iface_init (GInitableIface *iface);
+static void async_initable_iface_init (GAsyncInitableIface *iface);
+static void on_backend_reconnected (FbdDevLeds *self);
 
 G_DEFINE_TYPE_WITH_CODE (FbdDevLeds, fbd_dev_leds, G_TYPE_OBJECT,
-                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, initable_iface_init));
+                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, initable_iface_init)
+                         G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_INITABLE, async_initable_iface_init));
+
+
+#define FBD_DROID_LEDS_SYSFS_MARKER "/usr/lib/droidian/device/leds-sysfs"
+
+typedef FbdDroidLedsBackend *(*FbdDroidLedsBackendNewFunc) (GError **error);
+
+/* HAL backends, best first */
+static const struct {
+    const char                 *name;
+    FbdBinderService         *(*get_service) (void);
+    FbdDroidLedsBackendNewFunc  new;
+} hal_backends[] = {
+    { "AIDL", fbd_droid_leds_backend_aidl_get_service,
+      (FbdDroidLedsBackendNewFunc) fbd_droid_leds_backend_aidl_new },
+    { "HIDL", fbd_droid_leds_backend_hidl_get_service,
+      (FbdDroidLedsBackendNewFunc) fbd_droid_leds_backend_hidl_new },
+};
+
+
+static FbdDroidLedsBackend *
+fbd_dev_leds_new_hal_backend (guint index)
+{
+    g_autoptr (GError) err = NULL;
+    FbdDroidLedsBackend *backend;
+
+    backend = hal_backends[index].new (&err);
+    if (backend == NULL) {
+        g_debug ("Failed to init %s leds backend: %s", hal_backends[index].name, err->message);
+        return NULL;
+    }
+
+    if (!fbd_droid_leds_backend_is_supported (backend)) {
+        g_debug ("%s leds backend has no usable LED", hal_backends[index].name);
+        g_object_unref (backend);
+        return NULL;
+    }
+
+    return backend;
+}
+
+
+static void
+fbd_dev_leds_set_backend (FbdDevLeds *self, FbdDroidLedsBackend *backend)
+{
+    self->backend = backend;
+    g_signal_connect_object (self->backend, "reconnected",
+                             G_CALLBACK (on_backend_reconnected),
+                             self,
+                             G_CONNECT_SWAPPED);
+    g_debug ("Droid leds device usable");
+}
 
 
 static gboolean
@@ -49,49 +138,369 @@ initable_init (GInitable     *initable,
                GError       **error)
 {
     FbdDevLeds *self = FBD_DEV_LEDS (initable);
-    gboolean success;
+    FbdBinderService *services[G_N_ELEMENTS (hal_backends)];
+    FbdDroidLedsBackend *backend = NULL;
 
     g_debug ("initializing droid leds");
 
-    if (g_file_test ("/usr/lib/droidian/device/leds-sysfs", G_FILE_TEST_EXISTS)) {
-        self->backend = (FbdDroidLedsBackend *) fbd_droid_leds_backend_sysfs_new (error);
-        if (!self->backend) {
-            g_set_error (error,
-                         G_IO_ERROR, G_IO_ERROR_FAILED,
-                         "Failed to initialize leds backend using sysfs");
+    if (g_file_test (FBD_DROID_LEDS_SYSFS_MARKER, G_FILE_TEST_EXISTS)) {
+        backend = (FbdDroidLedsBackend *) fbd_droid_leds_backend_sysfs_new (error);
+        if (!backend) {
+            g_prefix_error (error, "Failed to initialize leds backend using sysfs: ");
             return FALSE;
         }
 
         g_debug ("Droid leds device initialized using sysfs backend");
+        fbd_dev_leds_set_backend (self, backend);
         return TRUE;
     }
 
-    /* Try with AIDL first */
-    self->backend = (FbdDroidLedsBackend *) fbd_droid_leds_backend_aidl_new (error);
+    /* Look up all HALs once, the backends reuse the result */
+    for (guint i = 0; i < G_N_ELEMENTS (hal_backends); i++)
+        services[i] = hal_backends[i].get_service ();
+    fbd_binder_services_resolve (services, G_N_ELEMENTS (services));
 
-    if (!self->backend) {
-        /* No luck, try with HIDL */
-        self->backend = (FbdDroidLedsBackend *) fbd_droid_leds_backend_hidl_new (error);
+    for (guint i = 0; i < G_N_ELEMENTS (hal_backends) && backend == NULL; i++)
+        backend = fbd_dev_leds_new_hal_backend (i);
 
-        if (!self->backend) {
-            g_set_error (error,
-                         G_IO_ERROR, G_IO_ERROR_FAILED,
-                         "Failed to obtain suitable light hal");
-            return FALSE;
+    for (guint i = 0; i < G_N_ELEMENTS (hal_backends); i++)
+        g_object_unref (services[i]);
+
+    if (backend == NULL) {
+        g_set_error (error,
+                     G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "Failed to obtain suitable light hal");
+        return FALSE;
+    }
+
+    fbd_dev_leds_set_backend (self, backend);
+    return TRUE;
+}
+
+
+typedef struct {
+    FbdBinderService *services[G_N_ELEMENTS (hal_backends)];
+    gboolean          resolved[G_N_ELEMENTS (hal_backends)];
+    gboolean          failed[G_N_ELEMENTS (hal_backends)];
+    gboolean          checking; /* a backend's lights are being loaded */
+    gboolean          done;
+} FbdDroidLedsProbe;
+
+
+static void
+fbd_droid_leds_probe_free (FbdDroidLedsProbe *probe)
+{
+    for (guint i = 0; i < G_N_ELEMENTS (hal_backends); i++)
+        g_clear_object (&probe->services[i]);
+    g_free (probe);
+}
+
+
+/* Runs in a thread as loading the HAL's lights blocks on binder transactions */
+static void
+check_backend_thread (GTask        *task,
+                      gpointer      source_object,
+                      gpointer      task_data,
+                      GCancellable *cancellable)
+{
+    g_task_return_boolean (task, fbd_droid_leds_backend_is_supported (source_object));
+}
+
+
+static void fbd_dev_leds_pick_backend (GTask *task);
+
+static void
+on_backend_checked (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    FbdDroidLedsBackend *backend = FBD_DROID_LEDS_BACKEND (source_object);
+    g_autoptr (GTask) task = G_TASK (user_data);
+    FbdDevLeds *self = g_task_get_source_object (task);
+    FbdDroidLedsProbe *probe = g_task_get_task_data (task);
+    guint index = GPOINTER_TO_UINT (g_task_get_task_data (G_TASK (res)));
+    g_autoptr (GError) err = NULL;
+
+    probe->checking = FALSE;
+    if (!g_task_propagate_boolean (G_TASK (res), &err)) {
+        if (err) {
+            probe->done = TRUE;
+            g_task_return_error (task, g_steal_pointer (&err));
+            return;
         }
+
+        g_debug ("%s leds backend has no usable LED", hal_backends[index].name);
+        probe->failed[index] = TRUE;
+        fbd_dev_leds_pick_backend (task);
+        return;
+    }
+
+    g_debug ("Using %s leds backend", hal_backends[index].name);
+    fbd_dev_leds_set_backend (self, g_object_ref (backend));
+    probe->done = TRUE;
+    g_task_return_boolean (task, TRUE);
+}
+
+
+/*
+ * Pick the best backend as soon as it's known: wait for more important
+ * lookups but don't wait for less important ones. The backend is
+ * created from the resolved service right away, only checking the
+ * HAL's lights happens in a thread.
+ */
+static void
+fbd_dev_leds_pick_backend (GTask *task)
+{
+    FbdDroidLedsProbe *probe = g_task_get_task_data (task);
+
+    if (probe->done || probe->checking)
+        return;
+
+    for (guint i = 0; i < G_N_ELEMENTS (hal_backends); i++) {
+        g_autoptr (GError) err = NULL;
+        g_autoptr (GTask) check = NULL;
+        g_autoptr (FbdDroidLedsBackend) backend = NULL;
+
+        if (!probe->resolved[i])
+            return;
+
+        if (probe->failed[i] || !fbd_binder_service_is_available (probe->services[i]))
+            continue;
+
+        backend = hal_backends[i].new (&err);
+        if (backend == NULL) {
+            g_debug ("Failed to init %s leds backend: %s", hal_backends[i].name, err->message);
+            probe->failed[i] = TRUE;
+            continue;
+        }
+
+        probe->checking = TRUE;
+        check = g_task_new (backend, g_task_get_cancellable (task), on_backend_checked,
+                            g_object_ref (task));
+        g_task_set_source_tag (check, fbd_dev_leds_pick_backend);
+        g_task_set_task_data (check, GUINT_TO_POINTER (i), NULL);
+        g_task_run_in_thread (check, check_backend_thread);
+        return;
+    }
+
+    probe->done = TRUE;
+    g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             "Failed to obtain suitable light hal");
+}
+
+
+static void
+on_service_resolved (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    FbdBinderService *service = FBD_BINDER_SERVICE (source_object);
+    g_autoptr (GTask) task = G_TASK (user_data);
+    FbdDroidLedsProbe *probe = g_task_get_task_data (task);
+    g_autoptr (GError) err = NULL;
+
+    if (!fbd_binder_service_resolve_finish (service, res, &err))
+        g_debug ("%s", err->message);
+
+    for (guint i = 0; i < G_N_ELEMENTS (hal_backends); i++) {
+        if (probe->services[i] == service)
+            probe->resolved[i] = TRUE;
+    }
+
+    fbd_dev_leds_pick_backend (task);
+}
+
+
+/*
+ * Look up all HALs in parallel without blocking, the chosen backend
+ * loads its HAL's lights in a thread.
+ */
+static void
+async_initable_init_async (GAsyncInitable      *initable,
+                           int                  io_priority,
+                           GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+    FbdDevLeds *self = FBD_DEV_LEDS (initable);
+    g_autoptr (GTask) task = NULL;
+    FbdDroidLedsProbe *probe;
+
+    g_debug ("initializing droid leds asynchronously");
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_source_tag (task, async_initable_init_async);
+
+    if (g_file_test (FBD_DROID_LEDS_SYSFS_MARKER, G_FILE_TEST_EXISTS)) {
+        GError *err = NULL;
+        FbdDroidLedsBackend *backend;
+
+        backend = (FbdDroidLedsBackend *) fbd_droid_leds_backend_sysfs_new (&err);
+        if (backend == NULL) {
+            g_task_return_error (task, err);
+            return;
+        }
+
+        g_debug ("Droid leds device initialized using sysfs backend");
+        fbd_dev_leds_set_backend (self, backend);
+        g_task_return_boolean (task, TRUE);
+        return;
+    }
+
+    probe = g_new0 (FbdDroidLedsProbe, 1);
+    g_task_set_task_data (task, probe, (GDestroyNotify) fbd_droid_leds_probe_free);
+
+    for (guint i = 0; i < G_N_ELEMENTS (hal_backends); i++)
+        probe->services[i] = hal_backends[i].get_service ();
+
+    for (guint i = 0; i < G_N_ELEMENTS (hal_backends); i++) {
+        fbd_binder_service_resolve_async (probe->services[i],
+                                          FBD_BINDER_RESOLVE_TIMEOUT_MS,
+                                          cancellable,
+                                          on_service_resolved,
+                                          g_object_ref (task));
+    }
+}
+
+
+static gboolean
+async_initable_init_finish (GAsyncInitable  *initable,
+                            GAsyncResult    *res,
+                            GError         **error)
+{
+    g_return_val_if_fail (g_task_is_valid (res, initable), FALSE);
+
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+
+static void
+fbd_dev_leds_cmd_free (FbdDevLedsCmd *cmd)
+{
+    g_object_unref (cmd->self);
+    g_free (cmd);
+}
+
+
+/* Runs in the io worker's thread */
+static gboolean
+fbd_dev_leds_run_cmd (gpointer data, GError **error)
+{
+    FbdDevLedsCmd *cmd = data;
+    gboolean success;
+
+    if (!fbd_droid_leds_backend_is_available (cmd->self->backend)) {
+        g_set_error (error,
+                     G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED,
+                     "Light hal unavailable, applying LED state once it's back");
+        return FALSE;
     }
 
-    success = fbd_droid_leds_backend_is_supported (self->backend);
+    if (cmd->freq)
+        success = fbd_droid_leds_backend_start_periodic (cmd->self->backend, cmd->color,
+                                                         &cmd->rgb, cmd->max_brightness,
+                                                         cmd->freq);
+    else
+        success = fbd_droid_leds_backend_stop (cmd->self->backend, cmd->color);
 
     if (!success) {
         g_set_error (error,
                      G_IO_ERROR, G_IO_ERROR_FAILED,
-                     "Failed to get supported LED types");
-        return FALSE;
+                     "Failed to %s LED", cmd->freq ? "start" : "stop");
     }
 
-    g_debug ("Droid leds device usable");
-    return TRUE;
+    return success;
+}
+
+
+static void
+on_cmd_done (gpointer data, const GError *error)
+{
+    if (error == NULL || g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        return;
+
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED))
+        g_debug ("%s", error->message);
+    else
+        g_warning ("%s", error->message);
+}
+
+
+/* There's a single notification light so a newer state supersedes a queued one */
+static void
+fbd_dev_leds_push_cmd (FbdDevLeds *self, FbdFeedbackLedColor color,
+                       const FbdLedRgbColor *rgb, guint max_brightness, guint freq)
+{
+    FbdDevLedsCmd *cmd = g_new0 (FbdDevLedsCmd, 1);
+
+    self->color = color;
+    self->rgb = *rgb;
+    self->max_brightness = max_brightness;
+    self->freq = freq;
+
+    cmd->self = g_object_ref (self);
+    cmd->color = color;
+    cmd->rgb = *rgb;
+    cmd->max_brightness = max_brightness;
+    cmd->freq = freq;
+    fbd_io_worker_push (self->worker,
+                        self,
+                        fbd_dev_leds_run_cmd,
+                        on_cmd_done,
+                        cmd,
+                        (GDestroyNotify) fbd_dev_leds_cmd_free);
+}
+
+
+/* Shows the most important claim unless it's shown already */
+static void
+fbd_dev_leds_update (FbdDevLeds *self)
+{
+    FbdDevLedsClaim *top;
+
+    if (self->claims->len == 0) {
+        FbdLedRgbColor off = { 0 };
+
+        if (self->freq == 0)
+            return;
+
+        g_debug ("droid LED stop flashing");
+        fbd_dev_leds_push_cmd (self, self->color, &off, 0, 0);
+        return;
+    }
+
+    top = g_ptr_array_index (self->claims, 0);
+    if (top->color == self->color &&
+        memcmp (&top->rgb, &self->rgb, sizeof (FbdLedRgbColor)) == 0 &&
+        top->max_brightness == self->max_brightness &&
+        top->freq == self->freq) {
+        return;
+    }
+
+    g_debug ("droid LED start flashing");
+    fbd_dev_leds_push_cmd (self, top->color, &top->rgb, top->max_brightness, top->freq);
+}
+
+
+static FbdDevLedsClaim *
+fbd_dev_leds_steal_claim (FbdDevLeds *self, gconstpointer owner)
+{
+    for (guint i = 0; i < self->claims->len; i++) {
+        FbdDevLedsClaim *claim = g_ptr_array_index (self->claims, i);
+
+        if (claim->owner == owner)
+            return g_ptr_array_steal_index (self->claims, i);
+    }
+
+    return NULL;
+}
+
+
+static void
+on_backend_reconnected (FbdDevLeds *self)
+{
+    /* The restarted HAL turned the LED off */
+    if (self->freq == 0)
+        return;
+
+    g_debug ("Light hal is back, restoring LED state");
+    fbd_dev_leds_push_cmd (self, self->color, &self->rgb, self->max_brightness, self->freq);
 }
 
 
@@ -102,6 +511,14 @@ initable_iface_init (GInitableIface *iface)
 }
 
 
+static void
+async_initable_iface_init (GAsyncInitableIface *iface)
+{
+    iface->init_async = async_initable_init_async;
+    iface->init_finish = async_initable_init_finish;
+}
+
+
 static void
 fbd_dev_leds_dispose (GObject *object)
 {
@@ -109,7 +526,9 @@ fbd_dev_leds_dispose (GObject *object)
 
     g_debug("Disposing droid leds");
 
+    g_clear_object (&self->worker);
     g_clear_object (&self->backend);
+    g_clear_pointer (&self->claims, g_ptr_array_unref);
 
     G_OBJECT_CLASS (fbd_dev_leds_parent_class)->dispose (object);
 }
@@ -126,6 +545,8 @@ fbd_dev_leds_class_init (FbdDevLedsClass *klass)
 static void
 fbd_dev_leds_init (FbdDevLeds *self)
 {
+    self->worker = fbd_io_worker_new ("fbd-leds-io");
+    self->claims = g_ptr_array_new_with_free_func (g_free);
 }
 
 
@@ -138,31 +559,111 @@ fbd_dev_leds_new (GError **error)
                                           NULL));
 }
 
+
+void
+fbd_dev_leds_new_async (GCancellable        *cancellable,
+                        GAsyncReadyCallback  callback,
+                        gpointer             user_data)
+{
+    g_async_initable_new_async (FBD_TYPE_DEV_LEDS,
+                                G_PRIORITY_DEFAULT,
+                                cancellable,
+                                callback,
+                                user_data,
+                                NULL);
+}
+
+
+FbdDevLeds *
+fbd_dev_leds_new_finish (GAsyncResult *res, GError **error)
+{
+    g_autoptr (GObject) source = g_async_result_get_source_object (res);
+    GObject *object;
+
+    object = g_async_initable_new_finish (G_ASYNC_INITABLE (source), res, error);
+    if (object == NULL)
+        return NULL;
+
+    return FBD_DEV_LEDS (object);
+}
+
 /**
- * fbd_dev_leds_start_periodic:
+ * fbd_dev_leds_claim:
  * @self: The #FbdDevLeds
+ * @owner: The owner of the claim
+ * @priority: The claim's priority, higher values are more important
  * @color: The color to use for the LED pattern
+ * @rgb: (nullable): The color's RGB value, used for %FBD_FEEDBACK_LED_COLOR_RGB
  * @max_brightness: The max brightness (in percent) to use for the pattern
  * @freq: The pattern's frequency in mHz
+ * @pattern: (nullable): A pattern to show instead of periodic blinking
+ *
+ * Claim the light to show periodic feedback. Claiming again with the
+ * same @owner replaces the former claim. The light HAL only supports
+ * blinking so @pattern is ignored.
  *
- * Start periodic feedback.
+ * Returns: %TRUE
  */
 gboolean
-fbd_dev_leds_start_periodic (FbdDevLeds *self, FbdFeedbackLedColor color,
-                             guint max_brightness, guint freq)
+fbd_dev_leds_claim (FbdDevLeds *self, gconstpointer owner, guint priority,
+                    FbdFeedbackLedColor color, FbdLedRgbColor *rgb,
+                    guint max_brightness, guint freq, FbdLedPattern *pattern)
 {
-    g_debug ("droid LED start flashing");
+    FbdDevLedsClaim *claim;
+    guint i;
+
+    g_return_val_if_fail (FBD_IS_DEV_LEDS (self), FALSE);
+    g_return_val_if_fail (owner, FALSE);
+    g_return_val_if_fail (freq > 0, FALSE);
+
+    g_free (fbd_dev_leds_steal_claim (self, owner));
+
+    claim = g_new0 (FbdDevLedsClaim, 1);
+    claim->owner = owner;
+    claim->priority = priority;
+    claim->color = color;
+    if (rgb)
+        claim->rgb = *rgb;
+    claim->max_brightness = max_brightness;
+    claim->freq = freq;
+
+    /* Keep claims of the same priority in the order they were made */
+    for (i = 0; i < self->claims->len; i++) {
+        FbdDevLedsClaim *other = g_ptr_array_index (self->claims, i);
+
+        if (other->priority < priority)
+            break;
+    }
+    g_ptr_array_insert (self->claims, i, claim);
 
-    return fbd_droid_leds_backend_start_periodic (self->backend, color,
-      max_brightness, freq);
+    fbd_dev_leds_update (self);
+    return TRUE;
 }
 
+
+/**
+ * fbd_dev_leds_release:
+ * @self: The #FbdDevLeds
+ * @owner: The owner of the claim
+ *
+ * Drops @owner's claim. The light shows the next most important claim
+ * or is turned off if there is none.
+ *
+ * Returns: %TRUE if @owner had a claim
+ */
 gboolean
-fbd_dev_leds_stop (FbdDevLeds *self, FbdFeedbackLedColor color)
+fbd_dev_leds_release (FbdDevLeds *self, gconstpointer owner)
 {
-    g_debug ("droid LED stop flashing");
+    g_autofree FbdDevLedsClaim *claim = NULL;
+
+    g_return_val_if_fail (FBD_IS_DEV_LEDS (self), FALSE);
 
-    return fbd_droid_leds_backend_stop (self->backend, color);
+    claim = fbd_dev_leds_steal_claim (self, owner);
+    if (claim == NULL)
+        return FALSE;
+
+    fbd_dev_leds_update (self);
+    return TRUE;
 }
 
 
@@ -178,10 +679,26 @@ fbd_dev_leds_stop (FbdDevLeds *self, FbdFeedbackLedColor color)
 gboolean
 fbd_dev_leds_has_led (FbdDevLeds *self, FbdFeedbackLedColor color)
 {
-  g_return_val_if_fail (FBD_IS_DEV_LEDS (self), FALSE);
+    g_return_val_if_fail (FBD_IS_DEV_LEDS (self), FALSE);
+
+    /* The notification light takes an ARGB color, there's no flash */
+    if (color == FBD_FEEDBACK_LED_COLOR_FLASH)
+        return FALSE;
+
+    return fbd_droid_leds_backend_has_light (self->backend, LIGHT_TYPE_NOTIFICATIONS);
+}
+
+/**
+ * fbd_dev_leds_flush:
+ * @self: The LEDs
+ *
+ * Blocks until all queued LED states were applied. This is mostly
+ * useful for tests and benchmarks.
+ */
+void
+fbd_dev_leds_flush (FbdDevLeds *self)
+{
+    g_return_if_fail (FBD_IS_DEV_LEDS (self));
 
-  /* We can't check for color :( So always return TRUE, if no LEDs
-   * are available, the initable would fail directly
-  */
-  return TRUE;
+    fbd_io_worker_flush (self->worker);
 }
@@ -23,15 +23,32 @@
 #define BINDER_VIBRATOR_AIDL_CALLBACK_IFACE "android.hardware.vibrator.IVibratorCallback"
 #define BINDER_VIBRATOR_AIDL_SLOT "default"
 
+/* IVibratorCallback: oneway void onComplete(); */
+#define BINDER_VIBRATOR_AIDL_CALLBACK_ON_COMPLETE 1
+
 /* Methods */
 enum
 {
   /* int getCapabilities(); */
   BINDER_VIBRATOR_AIDL_GET_CAPABILITIES = 1,
-  /* void on(in int timeoutMs, in android.hardware.vibrator.IVibratorCallback callback); */
-  BINDER_VIBRATOR_AIDL_ON = 3,
   /* void off(); */
   BINDER_VIBRATOR_AIDL_OFF = 2,
+  /* void on(in int timeoutMs, in android.hardware.vibrator.IVibratorCallback callback); */
+  BINDER_VIBRATOR_AIDL_ON = 3,
+  /* int perform(in Effect effect, in EffectStrength strength, in IVibratorCallback callback); */
+  BINDER_VIBRATOR_AIDL_PERFORM = 4,
+  /* Effect[] getSupportedEffects(); */
+  BINDER_VIBRATOR_AIDL_GET_SUPPORTED_EFFECTS = 5,
+  /* void setAmplitude(in float amplitude); */
+  BINDER_VIBRATOR_AIDL_SET_AMPLITUDE = 6,
+  /* int getCompositionDelayMax(); */
+  BINDER_VIBRATOR_AIDL_GET_COMPOSITION_DELAY_MAX = 8,
+  /* int getCompositionSizeMax(); */
+  BINDER_VIBRATOR_AIDL_GET_COMPOSITION_SIZE_MAX = 9,
+  /* CompositePrimitive[] getSupportedPrimitives(); */
+  BINDER_VIBRATOR_AIDL_GET_SUPPORTED_PRIMITIVES = 10,
+  /* void compose(in CompositeEffect[] composite, in IVibratorCallback callback); */
+  BINDER_VIBRATOR_AIDL_COMPOSE = 12,
 };
 
 /* Capabilities */
@@ -42,20 +59,32 @@ typedef enum
   BINDER_VIBRATOR_AIDL_CAP_PERFORM_CALLBACK = 2,
   BINDER_VIBRATOR_AIDL_CAP_AMPLITUDE_CONTROL = 4,
   BINDER_VIBRATOR_AIDL_CAP_EXTERNAL_CONTROL = 8,
-  BINDER_VIBRATOR_AIDL_CAP_EXTERNAL_AMPLITUDE_CONTROL = 8,
+  BINDER_VIBRATOR_AIDL_CAP_EXTERNAL_AMPLITUDE_CONTROL = 16,
   BINDER_VIBRATOR_AIDL_CAP_COMPOSE_EFFECTS = 32,
   BINDER_VIBRATOR_AIDL_CAP_ALWAYS_ON_CONTROL = 64,
 } FbdDroidVibraBackendAidlCapabilities;
 
+/* What the HAL can do */
+typedef struct
+{
+  FbdDroidVibraBackendAidlCapabilities capabilities;
+  guint32                supported_effects;    /* bitmask of FbdDroidVibraEffect */
+  guint32                supported_primitives; /* bitmask of FbdDroidVibraPrimitive */
+  guint                  composition_delay_max;
+  guint                  composition_size_max;
+} FbdDroidVibraBackendAidlInfo;
+
 struct _FbdDroidVibraBackendAidl
 {
   GObject parent_instance;
 
-  GBinderServiceManager *service_manager;
-  GBinderRemoteObject   *remote;
-  GBinderClient         *client;
+  FbdBinderService      *service;
   
   GBinderLocalObject    *callback_object;
+
+  /* Probed before use and whenever the HAL came back */
+  FbdDroidVibraBackendAidlInfo info;
+  GCancellable          *probe_cancel;
 };
 
 static void initable_interface_init (GInitableIface *iface);
@@ -74,60 +103,171 @@ fbd_droid_vibra_backend_aidl_callback (GBinderLocalObject   *obj,
                                        int                  *status,
                                        void                 *user_data)
 {
-  /* Unused for now */
+  FbdDroidVibraBackendAidl *self = FBD_DROID_VIBRA_BACKEND_AIDL (user_data);
+
+  *status = GBINDER_STATUS_OK;
+  if (code == BINDER_VIBRATOR_AIDL_CALLBACK_ON_COMPLETE) {
+    g_debug ("Vibrator effect completed");
+    g_signal_emit_by_name (self, "effect-completed");
+  } else {
+    g_debug ("Unhandled vibrator callback %u", code);
+  }
 
   return NULL;
 }
 
-#if 0
-/* Unused for now, but could be useful in future to determine whether the
- * underlying HAL supports callbacks at all.
-*/
-static FbdDroidVibraBackendAidlCapabilities
-fbd_droid_vibra_backend_get_capabilities (FbdDroidVibraBackend *backend)
+/* Runs a transaction without arguments, @reader is positioned after the status */
+static GBinderRemoteReply *
+fbd_droid_vibra_backend_aidl_call_sync (FbdDroidVibraBackendAidl *self,
+                                        guint                     code,
+                                        GBinderReader            *reader)
 {
-  FbdDroidVibraBackendAidl *self = FBD_DROID_VIBRA_BACKEND_AIDL (backend);
-  GBinderLocalRequest *req = gbinder_client_new_request (self->client);
+  GBinderLocalRequest *req = fbd_binder_service_new_request (self->service);
   GBinderRemoteReply *reply;
-  GBinderReader reader;
   int status;
-  int capabilities;
 
   gbinder_local_request_append_int32 (req, BINDER_STABILITY_VENDOR); /* stability */
 
-  reply = gbinder_client_transact_sync_reply (self->client,
-                                              BINDER_VIBRATOR_AIDL_GET_CAPABILITIES,
-                                              req, &status);
+  reply = fbd_binder_service_transact_sync (self->service, code, req, &status);
   gbinder_local_request_unref (req);
-  
-  gbinder_remote_reply_init_reader (reply, &reader);
-  
-  if (status == GBINDER_STATUS_OK && fbd_binder_status_is_ok (&reader) &&
-      gbinder_reader_read_int32 (&reader, &capabilities)) {
-    return (FbdDroidVibraBackendAidlCapabilities) capabilities;
+
+  if (status != GBINDER_STATUS_OK || reply == NULL) {
+    if (reply)
+      gbinder_remote_reply_unref (reply);
+    return NULL;
+  }
+
+  gbinder_remote_reply_init_reader (reply, reader);
+  if (!fbd_binder_status_is_ok (reader)) {
+    gbinder_remote_reply_unref (reply);
+    return NULL;
+  }
+
+  return reply;
+}
+
+static gboolean
+fbd_droid_vibra_backend_aidl_get_int (FbdDroidVibraBackendAidl *self,
+                                      guint                     code,
+                                      int                      *value)
+{
+  GBinderRemoteReply *reply;
+  GBinderReader reader;
+  gboolean success;
+
+  reply = fbd_droid_vibra_backend_aidl_call_sync (self, code, &reader);
+  if (!reply)
+    return FALSE;
+
+  success = gbinder_reader_read_int32 (&reader, value);
+  gbinder_remote_reply_unref (reply);
+
+  return success;
+}
+
+/* Reads an array of (int backed) enum values into a bitmask */
+static guint32
+fbd_droid_vibra_backend_aidl_get_enum_mask (FbdDroidVibraBackendAidl *self,
+                                            guint                     code)
+{
+  GBinderRemoteReply *reply;
+  GBinderReader reader;
+  guint32 mask = 0;
+  int count;
+
+  reply = fbd_droid_vibra_backend_aidl_call_sync (self, code, &reader);
+  if (!reply)
+    return 0;
+
+  if (gbinder_reader_read_int32 (&reader, &count)) {
+    for (int i = 0; i < count; i++) {
+      int value;
+
+      if (!gbinder_reader_read_int32 (&reader, &value))
+        break;
+      if (value >= 0 && value < 32)
+        mask |= (1u << value);
+    }
+  }
+  gbinder_remote_reply_unref (reply);
+
+  return mask;
+}
+
+/*
+ * Query what the HAL can do. This blocks on several transactions so
+ * only do it off the main loop.
+ */
+static void
+fbd_droid_vibra_backend_aidl_query_info (FbdDroidVibraBackendAidl     *self,
+                                         FbdDroidVibraBackendAidlInfo *info)
+{
+  int value;
+
+  if (fbd_droid_vibra_backend_aidl_get_int (self, BINDER_VIBRATOR_AIDL_GET_CAPABILITIES, &value)) {
+    info->capabilities = value;
   } else {
     g_warning ("Unable to get capabilities!");
-    return BINDER_VIBRATOR_AIDL_CAP_NONE;
+    info->capabilities = BINDER_VIBRATOR_AIDL_CAP_NONE;
+  }
+
+  info->supported_effects =
+    fbd_droid_vibra_backend_aidl_get_enum_mask (self, BINDER_VIBRATOR_AIDL_GET_SUPPORTED_EFFECTS);
+
+  if (info->capabilities & BINDER_VIBRATOR_AIDL_CAP_COMPOSE_EFFECTS) {
+    info->supported_primitives =
+      fbd_droid_vibra_backend_aidl_get_enum_mask (self, BINDER_VIBRATOR_AIDL_GET_SUPPORTED_PRIMITIVES);
+    if (!fbd_droid_vibra_backend_aidl_get_int (self, BINDER_VIBRATOR_AIDL_GET_COMPOSITION_DELAY_MAX,
+                                               &value))
+      value = 0;
+    info->composition_delay_max = MAX (value, 0);
+    if (!fbd_droid_vibra_backend_aidl_get_int (self, BINDER_VIBRATOR_AIDL_GET_COMPOSITION_SIZE_MAX,
+                                               &value))
+      value = 0;
+    info->composition_size_max = MAX (value, 0);
   }
+
+  g_debug ("Vibrator capabilities: 0x%x, effects: 0x%x, primitives: 0x%x, "
+           "composition size: %u, delay: %u",
+           info->capabilities, info->supported_effects, info->supported_primitives,
+           info->composition_size_max, info->composition_delay_max);
+}
+
+static GBinderLocalRequest *
+fbd_droid_vibra_backend_aidl_new_on_request (FbdDroidVibraBackendAidl *self,
+                                             int                       duration)
+{
+  GBinderLocalRequest *req = fbd_binder_service_new_request (self->service);
+
+  gbinder_local_request_append_int32 (req, duration); /* duration */
+  gbinder_local_request_append_local_object (req, self->callback_object); /* callback */
+  gbinder_local_request_append_int32 (req, BINDER_STABILITY_VINTF); /* stability */
+
+  return req;
+}
+
+static GBinderLocalRequest *
+fbd_droid_vibra_backend_aidl_new_off_request (FbdDroidVibraBackendAidl *self)
+{
+  GBinderLocalRequest *req = fbd_binder_service_new_request (self->service);
+
+  gbinder_local_request_append_int32 (req, BINDER_STABILITY_VINTF); /* stability */
+
+  return req;
 }
-#endif /* Unused */
 
 static gboolean
 fbd_droid_vibra_backend_aidl_on (FbdDroidVibraBackend *backend,
                                  int                       duration)
 {
   FbdDroidVibraBackendAidl *self = FBD_DROID_VIBRA_BACKEND_AIDL (backend);
-  GBinderLocalRequest *req = gbinder_client_new_request (self->client);
+  GBinderLocalRequest *req = fbd_droid_vibra_backend_aidl_new_on_request (self, duration);
   GBinderRemoteReply *reply;
   int status;
 
-  gbinder_local_request_append_int32 (req, duration); /* duration */
-  gbinder_local_request_append_local_object (req, self->callback_object); /* callback */
-  gbinder_local_request_append_int32 (req, BINDER_STABILITY_VINTF); /* stability */
-
-  reply = gbinder_client_transact_sync_reply (self->client,
-                                              BINDER_VIBRATOR_AIDL_ON,
-                                              req, &status);
+  reply = fbd_binder_service_transact_sync (self->service,
+                                            BINDER_VIBRATOR_AIDL_ON,
+                                            req, &status);
   gbinder_local_request_unref (req);
   
   if (status == GBINDER_STATUS_OK && fbd_binder_reply_status_is_ok (reply)) {
@@ -142,15 +282,13 @@ static gboolean
 fbd_droid_vibra_backend_aidl_off (FbdDroidVibraBackend *backend)
 {
   FbdDroidVibraBackendAidl *self = FBD_DROID_VIBRA_BACKEND_AIDL (backend);
-  GBinderLocalRequest *req = gbinder_client_new_request (self->client);
+  GBinderLocalRequest *req = fbd_droid_vibra_backend_aidl_new_off_request (self);
   GBinderRemoteReply *reply;
   int status;
 
-  gbinder_local_request_append_int32 (req, BINDER_STABILITY_VINTF); /* stability */
-
-  reply = gbinder_client_transact_sync_reply (self->client,
-                                              BINDER_VIBRATOR_AIDL_OFF,
-                                              req, &status);
+  reply = fbd_binder_service_transact_sync (self->service,
+                                            BINDER_VIBRATOR_AIDL_OFF,
+                                            req, &status);
   gbinder_local_request_unref(req);
   
   if (status == GBINDER_STATUS_OK && fbd_binder_reply_status_is_ok (reply)) {
@@ -161,33 +299,262 @@ fbd_droid_vibra_backend_aidl_off (FbdDroidVibraBackend *backend)
   }
 }
 
+static gulong
+fbd_droid_vibra_backend_aidl_on_async (FbdDroidVibraBackend          *backend,
+                                       int                            duration,
+                                       FbdDroidVibraBackendReplyFunc  callback,
+                                       gpointer                       user_data)
+{
+  FbdDroidVibraBackendAidl *self = FBD_DROID_VIBRA_BACKEND_AIDL (backend);
+  GBinderLocalRequest *req = fbd_droid_vibra_backend_aidl_new_on_request (self, duration);
+  gulong id;
+
+  id = fbd_binder_service_transact_async (self->service, BINDER_VIBRATOR_AIDL_ON, req,
+                                          callback, user_data);
+  gbinder_local_request_unref (req);
+
+  return id;
+}
+
+static gulong
+fbd_droid_vibra_backend_aidl_off_async (FbdDroidVibraBackend          *backend,
+                                        FbdDroidVibraBackendReplyFunc  callback,
+                                        gpointer                       user_data)
+{
+  FbdDroidVibraBackendAidl *self = FBD_DROID_VIBRA_BACKEND_AIDL (backend);
+  GBinderLocalRequest *req = fbd_droid_vibra_backend_aidl_new_off_request (self);
+  gulong id;
+
+  id = fbd_binder_service_transact_async (self->service, BINDER_VIBRATOR_AIDL_OFF, req,
+                                          callback, user_data);
+  gbinder_local_request_unref (req);
+
+  return id;
+}
+
+static void
+fbd_droid_vibra_backend_aidl_cancel (FbdDroidVibraBackend *backend,
+                                     gulong                id)
+{
+  FbdDroidVibraBackendAidl *self = FBD_DROID_VIBRA_BACKEND_AIDL (backend);
+
+  fbd_binder_service_cancel (self->service, id);
+}
+
+static FbdDroidVibraBackendFeatures
+fbd_droid_vibra_backend_aidl_get_features (FbdDroidVibraBackend *backend)
+{
+  FbdDroidVibraBackendAidl *self = FBD_DROID_VIBRA_BACKEND_AIDL (backend);
+  FbdDroidVibraBackendFeatures features = FBD_DROID_VIBRA_BACKEND_FEATURE_NONE;
+
+  if (self->info.capabilities & BINDER_VIBRATOR_AIDL_CAP_AMPLITUDE_CONTROL)
+    features |= FBD_DROID_VIBRA_BACKEND_FEATURE_AMPLITUDE;
+
+  if (self->info.capabilities & BINDER_VIBRATOR_AIDL_CAP_COMPOSE_EFFECTS)
+    features |= FBD_DROID_VIBRA_BACKEND_FEATURE_COMPOSE;
+
+  if (self->info.capabilities & BINDER_VIBRATOR_AIDL_CAP_ON_CALLBACK)
+    features |= FBD_DROID_VIBRA_BACKEND_FEATURE_ON_CALLBACK;
+
+  if (self->info.capabilities & BINDER_VIBRATOR_AIDL_CAP_PERFORM_CALLBACK)
+    features |= FBD_DROID_VIBRA_BACKEND_FEATURE_PERFORM_CALLBACK;
+
+  return features;
+}
+
+static gboolean
+fbd_droid_vibra_backend_aidl_supports_effect (FbdDroidVibraBackend *backend,
+                                              FbdDroidVibraEffect   effect)
+{
+  FbdDroidVibraBackendAidl *self = FBD_DROID_VIBRA_BACKEND_AIDL (backend);
+
+  return effect < 32 && (self->info.supported_effects & (1u << effect));
+}
+
+static gboolean
+fbd_droid_vibra_backend_aidl_can_compose (FbdDroidVibraBackend               *backend,
+                                          const FbdDroidVibraCompositeEffect *composite,
+                                          guint                               n_composite)
+{
+  FbdDroidVibraBackendAidl *self = FBD_DROID_VIBRA_BACKEND_AIDL (backend);
+
+  if (!(self->info.capabilities & BINDER_VIBRATOR_AIDL_CAP_COMPOSE_EFFECTS))
+    return FALSE;
+
+  if (n_composite == 0 || n_composite > self->info.composition_size_max)
+    return FALSE;
+
+  for (guint i = 0; i < n_composite; i++) {
+    if (composite[i].delay > self->info.composition_delay_max)
+      return FALSE;
+    if (composite[i].primitive >= 32 ||
+        !(self->info.supported_primitives & (1u << composite[i].primitive)))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gulong
+fbd_droid_vibra_backend_aidl_perform_async (FbdDroidVibraBackend          *backend,
+                                            FbdDroidVibraEffect            effect,
+                                            FbdDroidVibraEffectStrength    strength,
+                                            FbdDroidVibraBackendReplyFunc  callback,
+                                            gpointer                       user_data)
+{
+  FbdDroidVibraBackendAidl *self = FBD_DROID_VIBRA_BACKEND_AIDL (backend);
+  GBinderLocalRequest *req = fbd_binder_service_new_request (self->service);
+  gulong id;
+
+  gbinder_local_request_append_int32 (req, effect); /* effect */
+  gbinder_local_request_append_int32 (req, strength); /* strength */
+  gbinder_local_request_append_local_object (req, self->callback_object); /* callback */
+  gbinder_local_request_append_int32 (req, BINDER_STABILITY_VINTF); /* stability */
+
+  id = fbd_binder_service_transact_async (self->service, BINDER_VIBRATOR_AIDL_PERFORM, req,
+                                          callback, user_data);
+  gbinder_local_request_unref (req);
+
+  return id;
+}
+
+static gulong
+fbd_droid_vibra_backend_aidl_set_amplitude_async (FbdDroidVibraBackend          *backend,
+                                                  float                          amplitude,
+                                                  FbdDroidVibraBackendReplyFunc  callback,
+                                                  gpointer                       user_data)
+{
+  FbdDroidVibraBackendAidl *self = FBD_DROID_VIBRA_BACKEND_AIDL (backend);
+  GBinderLocalRequest *req = fbd_binder_service_new_request (self->service);
+  GBinderWriter writer;
+  gulong id;
+
+  gbinder_local_request_init_writer (req, &writer);
+  gbinder_writer_append_float (&writer, amplitude); /* amplitude */
+
+  id = fbd_binder_service_transact_async (self->service, BINDER_VIBRATOR_AIDL_SET_AMPLITUDE, req,
+                                          callback, user_data);
+  gbinder_local_request_unref (req);
+
+  return id;
+}
+
+static gulong
+fbd_droid_vibra_backend_aidl_compose_async (FbdDroidVibraBackend               *backend,
+                                            const FbdDroidVibraCompositeEffect *composite,
+                                            guint                               n_composite,
+                                            FbdDroidVibraBackendReplyFunc       callback,
+                                            gpointer                            user_data)
+{
+  FbdDroidVibraBackendAidl *self = FBD_DROID_VIBRA_BACKEND_AIDL (backend);
+  GBinderLocalRequest *req = fbd_binder_service_new_request (self->service);
+  GBinderWriter writer;
+  gulong id;
+
+  gbinder_local_request_init_writer (req, &writer);
+  gbinder_writer_append_int32 (&writer, n_composite); /* array length */
+  for (guint i = 0; i < n_composite; i++) {
+    gbinder_writer_append_int32 (&writer, 1); /* non-null */
+    /* Parcelable size, including the size field itself */
+    gbinder_writer_append_int32 (&writer, 3 * sizeof (gint32) + sizeof (float));
+    gbinder_writer_append_int32 (&writer, composite[i].delay); /* delayMs */
+    gbinder_writer_append_int32 (&writer, composite[i].primitive); /* primitive */
+    gbinder_writer_append_float (&writer, composite[i].scale); /* scale */
+  }
+  gbinder_writer_append_local_object (&writer, self->callback_object); /* callback */
+  gbinder_writer_append_int32 (&writer, BINDER_STABILITY_VINTF); /* stability */
+
+  id = fbd_binder_service_transact_async (self->service, BINDER_VIBRATOR_AIDL_COMPOSE, req,
+                                          callback, user_data);
+  gbinder_local_request_unref (req);
+
+  return id;
+}
+
+static gboolean
+fbd_droid_vibra_backend_aidl_is_available (FbdDroidVibraBackend *backend)
+{
+  FbdDroidVibraBackendAidl *self = FBD_DROID_VIBRA_BACKEND_AIDL (backend);
+
+  return fbd_binder_service_is_available (self->service);
+}
+
+static void
+fbd_droid_vibra_backend_aidl_probe (FbdDroidVibraBackend *backend)
+{
+  FbdDroidVibraBackendAidl *self = FBD_DROID_VIBRA_BACKEND_AIDL (backend);
+
+  fbd_droid_vibra_backend_aidl_query_info (self, &self->info);
+}
+
+static void
+probe_thread (GTask        *task,
+              gpointer      source_object,
+              gpointer      task_data,
+              GCancellable *cancellable)
+{
+  fbd_droid_vibra_backend_aidl_query_info (source_object, task_data);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+on_probe_done (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  FbdDroidVibraBackendAidl *self = FBD_DROID_VIBRA_BACKEND_AIDL (source_object);
+  FbdDroidVibraBackendAidlInfo *info = g_task_get_task_data (G_TASK (res));
+
+  /* Superseded by a newer probe or shutting down */
+  if (!g_task_propagate_boolean (G_TASK (res), NULL))
+    return;
+
+  self->info = *info;
+  g_clear_object (&self->probe_cancel);
+  g_signal_emit_by_name (self, "reconnected");
+}
+
+static void
+on_service_reconnected (FbdDroidVibraBackendAidl *self)
+{
+  g_autoptr (GTask) task = NULL;
+
+  /* The HAL might have been updated, probe it without blocking the main loop */
+  g_cancellable_cancel (self->probe_cancel);
+  g_clear_object (&self->probe_cancel);
+  self->probe_cancel = g_cancellable_new ();
+
+  task = g_task_new (self, self->probe_cancel, on_probe_done, NULL);
+  g_task_set_source_tag (task, on_service_reconnected);
+  g_task_set_task_data (task, g_new0 (FbdDroidVibraBackendAidlInfo, 1), g_free);
+  g_task_run_in_thread (task, probe_thread);
+}
+
 static gboolean
 initable_init (GInitable     *initable,
                GCancellable  *cancellable,
                GError       **error)
 {
   FbdDroidVibraBackendAidl *self = FBD_DROID_VIBRA_BACKEND_AIDL (initable);
-  gboolean success;
+  GBinderServiceManager *service_manager;
 
   g_debug ("Initializing droid vibra aidl");
 
-  success = fbd_binder_init (BINDER_VIBRATOR_DEFAULT_AIDL_DEVICE,
-                             BINDER_VIBRATOR_AIDL_IFACE,
-                             (BINDER_VIBRATOR_AIDL_IFACE "/" BINDER_VIBRATOR_AIDL_SLOT),
-                             &self->service_manager,
-                             &self->remote,
-                             &self->client);
-
-
-  if (!success) {
+  self->service = fbd_droid_vibra_backend_aidl_get_service ();
+  if (!fbd_binder_service_resolve (self->service, NULL)) {
     g_set_error (error,
                  G_IO_ERROR, G_IO_ERROR_FAILED,
                  "Failed to obtain suitable vibrator hal");
     return FALSE;
   }
 
+  g_signal_connect_object (self->service, "reconnected",
+                           G_CALLBACK (on_service_reconnected),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  service_manager = fbd_binder_service_get_service_manager (self->service);
   self->callback_object =
-    gbinder_servicemanager_new_local_object (self->service_manager,
+    gbinder_servicemanager_new_local_object (service_manager,
                                              BINDER_VIBRATOR_AIDL_CALLBACK_IFACE,
                                              fbd_droid_vibra_backend_aidl_callback,
                                              self);
@@ -202,9 +569,7 @@ fbd_droid_vibra_backend_aidl_constructed (GObject *obj)
 
   G_OBJECT_CLASS (fbd_droid_vibra_backend_aidl_parent_class)->constructed (obj);
 
-  self->service_manager = NULL;
-  self->remote = NULL;
-  self->client = NULL;
+  self->service = NULL;
   self->callback_object = NULL;
 }
 
@@ -215,21 +580,14 @@ fbd_droid_vibra_backend_aidl_dispose (GObject *obj)
 
   g_debug ("Disposing droid vibra aidl");
 
+  g_cancellable_cancel (self->probe_cancel);
+  g_clear_object (&self->probe_cancel);
+
   if (self->callback_object) {
     gbinder_local_object_unref (self->callback_object);
   }
 
-  if (self->client) {
-    gbinder_client_unref (self->client);
-  }
-
-  if (self->remote) {
-    gbinder_remote_object_unref (self->remote);
-  }
-
-  if (self->service_manager) {
-    gbinder_servicemanager_unref (self->service_manager);
-  }
+  g_clear_object (&self->service);
 
   G_OBJECT_CLASS (fbd_droid_vibra_backend_aidl_parent_class)->dispose (obj);
 }
@@ -276,6 +634,19 @@ fbd_droid_vibra_backend_interface_init (FbdDroidVibraBackendInterface *iface)
 {
   iface->on  = fbd_droid_vibra_backend_aidl_on;
   iface->off = fbd_droid_vibra_backend_aidl_off;
+  iface->on_async  = fbd_droid_vibra_backend_aidl_on_async;
+  iface->off_async = fbd_droid_vibra_backend_aidl_off_async;
+  iface->cancel    = fbd_droid_vibra_backend_aidl_cancel;
+
+  iface->get_features        = fbd_droid_vibra_backend_aidl_get_features;
+  iface->supports_effect     = fbd_droid_vibra_backend_aidl_supports_effect;
+  iface->can_compose         = fbd_droid_vibra_backend_aidl_can_compose;
+  iface->perform_async       = fbd_droid_vibra_backend_aidl_perform_async;
+  iface->set_amplitude_async = fbd_droid_vibra_backend_aidl_set_amplitude_async;
+  iface->compose_async       = fbd_droid_vibra_backend_aidl_compose_async;
+
+  iface->is_available        = fbd_droid_vibra_backend_aidl_is_available;
+  iface->probe               = fbd_droid_vibra_backend_aidl_probe;
 }
 
 static void
@@ -283,6 +654,19 @@ fbd_droid_vibra_backend_aidl_init (FbdDroidVibraBackendAidl *self)
 {
 }
 
+/**
+ * fbd_droid_vibra_backend_aidl_get_service:
+ *
+ * Returns:(transfer full): The shared vibrator hal service
+ */
+FbdBinderService *
+fbd_droid_vibra_backend_aidl_get_service (void)
+{
+  return fbd_binder_service_get (BINDER_VIBRATOR_DEFAULT_AIDL_DEVICE,
+                                 BINDER_VIBRATOR_AIDL_IFACE,
+                                 BINDER_VIBRATOR_AIDL_IFACE "/" BINDER_VIBRATOR_AIDL_SLOT);
+}
+
 FbdDroidVibraBackendAidl *
 fbd_droid_vibra_backend_aidl_new (GError **error)
 {
@@ -8,11 +8,14 @@
 
 #include <glib-object.h>
 
+#include "fbd-binder.h"
+
 G_BEGIN_DECLS
 
 #define FBD_TYPE_DROID_VIBRA_BACKEND_AIDL fbd_droid_vibra_backend_aidl_get_type ()
 G_DECLARE_FINAL_TYPE (FbdDroidVibraBackendAidl, fbd_droid_vibra_backend_aidl, FBD, DROID_VIBRA_BACKEND_AIDL, GObject)
 
 FbdDroidVibraBackendAidl *fbd_droid_vibra_backend_aidl_new (GError **error);
+FbdBinderService *fbd_droid_vibra_backend_aidl_get_service (void);
 
 G_END_DECLS
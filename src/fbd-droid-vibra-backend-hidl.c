@@ -38,9 +38,7 @@ struct _FbdDroidVibraBackendHidl
 {
   GObject parent_instance;
 
-  GBinderServiceManager *service_manager;
-  GBinderRemoteObject   *remote;
-  GBinderClient         *client;
+  FbdBinderService      *service;
 };
 
 static void initable_interface_init (GInitableIface *iface);
@@ -56,15 +54,15 @@ fbd_droid_vibra_backend_hidl_on (FbdDroidVibraBackend *backend,
                                  int                       duration)
 {
   FbdDroidVibraBackendHidl *self = FBD_DROID_VIBRA_BACKEND_HIDL (backend);
-  GBinderLocalRequest *req = gbinder_client_new_request (self->client);
+  GBinderLocalRequest *req = fbd_binder_service_new_request (self->service);
   GBinderRemoteReply *reply;
   int status;
 
   gbinder_local_request_append_int32 (req, duration); /* duration */
 
-  reply = gbinder_client_transact_sync_reply (self->client,
-                                              BINDER_VIBRATOR_HIDL_1_0_ON,
-                                              req, &status);
+  reply = fbd_binder_service_transact_sync (self->service,
+                                            BINDER_VIBRATOR_HIDL_1_0_ON,
+                                            req, &status);
   gbinder_local_request_unref (req);
   
   if (status == GBINDER_STATUS_OK && fbd_binder_reply_status_is_ok (reply)) {
@@ -79,13 +77,13 @@ static gboolean
 fbd_droid_vibra_backend_hidl_off (FbdDroidVibraBackend *backend)
 {
   FbdDroidVibraBackendHidl *self = FBD_DROID_VIBRA_BACKEND_HIDL (backend);
-  GBinderLocalRequest *req = gbinder_client_new_request (self->client);
+  GBinderLocalRequest *req = fbd_binder_service_new_request (self->service);
   GBinderRemoteReply *reply;
   int status;
 
-  reply = gbinder_client_transact_sync_reply (self->client,
-                                              BINDER_VIBRATOR_HIDL_1_0_OFF,
-                                              req, &status);
+  reply = fbd_binder_service_transact_sync (self->service,
+                                            BINDER_VIBRATOR_HIDL_1_0_OFF,
+                                            req, &status);
   gbinder_local_request_unref(req);
   
   if (status == GBINDER_STATUS_OK && fbd_binder_reply_status_is_ok (reply)) {
@@ -96,31 +94,86 @@ fbd_droid_vibra_backend_hidl_off (FbdDroidVibraBackend *backend)
   }
 }
 
+static gulong
+fbd_droid_vibra_backend_hidl_on_async (FbdDroidVibraBackend          *backend,
+                                       int                            duration,
+                                       FbdDroidVibraBackendReplyFunc  callback,
+                                       gpointer                       user_data)
+{
+  FbdDroidVibraBackendHidl *self = FBD_DROID_VIBRA_BACKEND_HIDL (backend);
+  GBinderLocalRequest *req = fbd_binder_service_new_request (self->service);
+  gulong id;
+
+  gbinder_local_request_append_int32 (req, duration); /* duration */
+
+  id = fbd_binder_service_transact_async (self->service, BINDER_VIBRATOR_HIDL_1_0_ON, req,
+                                          callback, user_data);
+  gbinder_local_request_unref (req);
+
+  return id;
+}
+
+static gulong
+fbd_droid_vibra_backend_hidl_off_async (FbdDroidVibraBackend          *backend,
+                                        FbdDroidVibraBackendReplyFunc  callback,
+                                        gpointer                       user_data)
+{
+  FbdDroidVibraBackendHidl *self = FBD_DROID_VIBRA_BACKEND_HIDL (backend);
+  GBinderLocalRequest *req = fbd_binder_service_new_request (self->service);
+  gulong id;
+
+  id = fbd_binder_service_transact_async (self->service, BINDER_VIBRATOR_HIDL_1_0_OFF, req,
+                                          callback, user_data);
+  gbinder_local_request_unref (req);
+
+  return id;
+}
+
+static void
+fbd_droid_vibra_backend_hidl_cancel (FbdDroidVibraBackend *backend,
+                                     gulong                id)
+{
+  FbdDroidVibraBackendHidl *self = FBD_DROID_VIBRA_BACKEND_HIDL (backend);
+
+  fbd_binder_service_cancel (self->service, id);
+}
+
+static gboolean
+fbd_droid_vibra_backend_hidl_is_available (FbdDroidVibraBackend *backend)
+{
+  FbdDroidVibraBackendHidl *self = FBD_DROID_VIBRA_BACKEND_HIDL (backend);
+
+  return fbd_binder_service_is_available (self->service);
+}
+
+static void
+on_service_reconnected (FbdDroidVibraBackendHidl *self)
+{
+  g_signal_emit_by_name (self, "reconnected");
+}
+
 static gboolean
 initable_init (GInitable     *initable,
                GCancellable  *cancellable,
                GError       **error)
 {
   FbdDroidVibraBackendHidl *self = FBD_DROID_VIBRA_BACKEND_HIDL (initable);
-  gboolean success;
 
   g_debug ("Initializing droid vibra hidl");
 
-  success = fbd_binder_init (BINDER_VIBRATOR_DEFAULT_HIDL_DEVICE,
-                             BINDER_VIBRATOR_HIDL_1_0_IFACE,
-                             (BINDER_VIBRATOR_HIDL_1_0_IFACE "/" BINDER_VIBRATOR_HIDL_SLOT),
-                             &self->service_manager,
-                             &self->remote,
-                             &self->client);
-
-
-  if (!success) {
+  self->service = fbd_droid_vibra_backend_hidl_get_service ();
+  if (!fbd_binder_service_resolve (self->service, NULL)) {
     g_set_error (error,
                  G_IO_ERROR, G_IO_ERROR_FAILED,
                  "Failed to obtain suitable vibrator hal");
     return FALSE;
   }
 
+  g_signal_connect_object (self->service, "reconnected",
+                           G_CALLBACK (on_service_reconnected),
+                           self,
+                           G_CONNECT_SWAPPED);
+
   return TRUE;
 }
 
@@ -131,9 +184,7 @@ fbd_droid_vibra_backend_hidl_constructed (GObject *obj)
 
   G_OBJECT_CLASS (fbd_droid_vibra_backend_hidl_parent_class)->constructed (obj);
 
-  self->service_manager = NULL;
-  self->remote = NULL;
-  self->client = NULL;
+  self->service = NULL;
 }
 
 static void
@@ -143,17 +194,7 @@ fbd_droid_vibra_backend_hidl_dispose (GObject *obj)
 
   g_debug ("Disposing droid vibra hidl");
 
-  if (self->client) {
-    gbinder_client_unref (self->client);
-  }
-  
-  if (self->remote) {
-    gbinder_remote_object_unref (self->remote);
-  }
-  
-  if (self->service_manager) {
-    gbinder_servicemanager_unref (self->service_manager);
-  }
+  g_clear_object (&self->service);
 
   G_OBJECT_CLASS (fbd_droid_vibra_backend_hidl_parent_class)->dispose (obj);
 }
@@ -200,6 +241,11 @@ fbd_droid_vibra_backend_interface_init (FbdDroidVibraBackendInterface *iface)
 {
   iface->on  = fbd_droid_vibra_backend_hidl_on;
   iface->off = fbd_droid_vibra_backend_hidl_off;
+  iface->on_async  = fbd_droid_vibra_backend_hidl_on_async;
+  iface->off_async = fbd_droid_vibra_backend_hidl_off_async;
+  iface->cancel    = fbd_droid_vibra_backend_hidl_cancel;
+
+  iface->is_available = fbd_droid_vibra_backend_hidl_is_available;
 }
 
 static void
@@ -207,6 +253,19 @@ fbd_droid_vibra_backend_hidl_init (FbdDroidVibraBackendHidl *self)
 {
 }
 
+/**
+ * fbd_droid_vibra_backend_hidl_get_service:
+ *
+ * Returns:(transfer full): The shared vibrator hal service
+ */
+FbdBinderService *
+fbd_droid_vibra_backend_hidl_get_service (void)
+{
+  return fbd_binder_service_get (BINDER_VIBRATOR_DEFAULT_HIDL_DEVICE,
+                                 BINDER_VIBRATOR_HIDL_1_0_IFACE,
+                                 BINDER_VIBRATOR_HIDL_1_0_IFACE "/" BINDER_VIBRATOR_HIDL_SLOT);
+}
+
 FbdDroidVibraBackendHidl *
 fbd_droid_vibra_backend_hidl_new (GError **error)
 {
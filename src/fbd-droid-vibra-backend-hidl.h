@@ -8,11 +8,14 @@
 
 #include <glib-object.h>
 
+#include "fbd-binder.h"
+
 G_BEGIN_DECLS
 
 #define FBD_TYPE_DROID_VIBRA_BACKEND_HIDL fbd_droid_vibra_backend_hidl_get_type ()
 G_DECLARE_FINAL_TYPE (FbdDroidVibraBackendHidl, fbd_droid_vibra_backend_hidl, FBD, DROID_VIBRA_BACKEND_HIDL, GObject)
 
 FbdDroidVibraBackendHidl *fbd_droid_vibra_backend_hidl_new (GError **error);
+FbdBinderService *fbd_droid_vibra_backend_hidl_get_service (void);
 
 G_END_DECLS
@@ -10,7 +10,12 @@
 #include <glib.h>
 #include <glib-object.h>
 #include <gio/gio.h>
-#include <stdio.h>
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "fbd-droid-vibra-backend.h"
 #include "fbd-droid-vibra-backend-sysfs.h"
@@ -19,10 +24,34 @@
 #define SYSFS_DURATION_NODE SYSFS_VIBRATOR_PATH "/duration"
 #define SYSFS_ACTIVATE_NODE SYSFS_VIBRATOR_PATH "/activate"
 
+/* Some devices need a bigger duration than what feedbackd gives */
+#define SYSFS_MULTIPLIER_CONFIG "/usr/lib/droidian/device/vibrator-sysfs-multiplier"
+/* Devices with a multiplier need some time before the motor can be turned off */
+#define SYSFS_OFF_DELAY_MS 50
+
+/*
+ * The device's configuration is read once and the sysfs nodes are kept
+ * open so turning the motor on is two writes. Requests complete
+ * asynchronously so turning the motor off can be deferred without
+ * blocking.
+ */
 struct _FbdDroidVibraBackendSysfs {
   GObject parent_instance;
+
+  int   duration_fd;
+  int   activate_fd;
+  int   multiplier;
+  guint off_delay;  /* in ms */
 };
 
+typedef struct {
+  FbdDroidVibraBackendSysfs     *self;
+  gboolean                       off;
+  gboolean                       success;
+  FbdDroidVibraBackendReplyFunc  callback;
+  gpointer                       user_data;
+} FbdDroidVibraSysfsRequest;
+
 static void initable_interface_init (GInitableIface *iface);
 static void fbd_droid_vibra_backend_interface_init (FbdDroidVibraBackendInterface *iface);
 
@@ -32,57 +61,137 @@ G_DEFINE_TYPE_WITH_CODE (FbdDroidVibraBackendSysfs, fbd_droid_vibra_backend_sysf
                                                 fbd_droid_vibra_backend_interface_init))
 
 static gboolean
-write_to_sysfs (const char *path, const char *value)
+write_to_sysfs (int fd, const char *name, const char *value)
 {
-  FILE *fp = fopen (path, "w");
-  if (!fp) {
-    g_warning ("Unable to open sysfs path: %s", path);
+  gsize len = strlen (value);
+  gssize ret;
+
+  do {
+    ret = pwrite (fd, value, len, 0);
+  } while (ret < 0 && errno == EINTR);
+
+  if (ret < 0 || (gsize) ret != len) {
+    g_warning ("Unable to write '%s' to %s: %s", value, name,
+               ret < 0 ? g_strerror (errno) : "short write");
     return FALSE;
   }
 
-  fprintf (fp, "%s", value);
-  fclose (fp);
   return TRUE;
 }
 
 static gboolean
 fbd_droid_vibra_backend_sysfs_on (FbdDroidVibraBackend *backend, int duration)
 {
-  // Some devices need a bigger duration than what feedbackd gives
-  if (g_file_test ("/usr/lib/droidian/device/vibrator-sysfs-multiplier", G_FILE_TEST_EXISTS)) {
-    gchar *content = NULL;
-    gsize length = 0;
-    GError *error = NULL;
-
-    if (g_file_get_contents ("/usr/lib/droidian/device/vibrator-sysfs-multiplier", &content, &length, &error)) {
-      int multiplier = atoi (content);
-
-      duration = duration * multiplier;
-      g_free (content);
-    } else {
-      if (error != NULL)
-        g_error_free (error);
-    }
-  }
-
+  FbdDroidVibraBackendSysfs *self = FBD_DROID_VIBRA_BACKEND_SYSFS (backend);
   char duration_str[16];
-  g_snprintf (duration_str, sizeof (duration_str), "%d", duration);
 
-  //g_print("Vibration duration: %s\n", duration_str);
+  g_snprintf (duration_str, sizeof (duration_str), "%d", duration * self->multiplier);
 
-  if (!write_to_sysfs (SYSFS_DURATION_NODE, duration_str))
+  if (!write_to_sysfs (self->duration_fd, SYSFS_DURATION_NODE, duration_str))
     return FALSE;
 
-  return write_to_sysfs (SYSFS_ACTIVATE_NODE, "1");
+  return write_to_sysfs (self->activate_fd, SYSFS_ACTIVATE_NODE, "1");
 }
 
 static gboolean
 fbd_droid_vibra_backend_sysfs_off (FbdDroidVibraBackend *backend)
 {
-  if (g_file_test ("/usr/lib/droidian/device/vibrator-sysfs-multiplier", G_FILE_TEST_EXISTS))
-    g_usleep(50000);
+  FbdDroidVibraBackendSysfs *self = FBD_DROID_VIBRA_BACKEND_SYSFS (backend);
+
+  return write_to_sysfs (self->activate_fd, SYSFS_ACTIVATE_NODE, "0");
+}
+
+static void
+fbd_droid_vibra_sysfs_request_free (FbdDroidVibraSysfsRequest *req)
+{
+  g_object_unref (req->self);
+  g_free (req);
+}
+
+static gboolean
+on_request_dispatch (gpointer user_data)
+{
+  FbdDroidVibraSysfsRequest *req = user_data;
+
+  /* Deferred write */
+  if (req->off)
+    req->success = fbd_droid_vibra_backend_sysfs_off (FBD_DROID_VIBRA_BACKEND (req->self));
+
+  if (req->callback)
+    req->callback (req->success, req->user_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Reports completion from the main loop as callers expect */
+static gulong
+fbd_droid_vibra_backend_sysfs_complete (FbdDroidVibraBackendSysfs     *self,
+                                        GSource                       *source,
+                                        gboolean                       off,
+                                        gboolean                       success,
+                                        FbdDroidVibraBackendReplyFunc  callback,
+                                        gpointer                       user_data)
+{
+  FbdDroidVibraSysfsRequest *req = g_new0 (FbdDroidVibraSysfsRequest, 1);
+  guint id;
+
+  req->self = g_object_ref (self);
+  req->off = off;
+  req->success = success;
+  req->callback = callback;
+  req->user_data = user_data;
+
+  g_source_set_callback (source, on_request_dispatch, req,
+                         (GDestroyNotify) fbd_droid_vibra_sysfs_request_free);
+  g_source_set_name (source, "[feedbackd] sysfs vibra request");
+  id = g_source_attach (source, NULL);
+  g_source_unref (source);
+
+  return id;
+}
+
+static gulong
+fbd_droid_vibra_backend_sysfs_on_async (FbdDroidVibraBackend          *backend,
+                                        int                            duration,
+                                        FbdDroidVibraBackendReplyFunc  callback,
+                                        gpointer                       user_data)
+{
+  FbdDroidVibraBackendSysfs *self = FBD_DROID_VIBRA_BACKEND_SYSFS (backend);
+  gboolean success;
+
+  success = fbd_droid_vibra_backend_sysfs_on (backend, duration);
 
-  return write_to_sysfs (SYSFS_ACTIVATE_NODE, "0");
+  return fbd_droid_vibra_backend_sysfs_complete (self, g_idle_source_new (), FALSE, success,
+                                                 callback, user_data);
+}
+
+static gulong
+fbd_droid_vibra_backend_sysfs_off_async (FbdDroidVibraBackend          *backend,
+                                         FbdDroidVibraBackendReplyFunc  callback,
+                                         gpointer                       user_data)
+{
+  FbdDroidVibraBackendSysfs *self = FBD_DROID_VIBRA_BACKEND_SYSFS (backend);
+  gboolean success;
+
+  if (self->off_delay) {
+    return fbd_droid_vibra_backend_sysfs_complete (self, g_timeout_source_new (self->off_delay),
+                                                   TRUE, FALSE, callback, user_data);
+  }
+
+  success = fbd_droid_vibra_backend_sysfs_off (backend);
+
+  return fbd_droid_vibra_backend_sysfs_complete (self, g_idle_source_new (), FALSE, success,
+                                                 callback, user_data);
+}
+
+static void
+fbd_droid_vibra_backend_sysfs_cancel (FbdDroidVibraBackend *backend,
+                                      gulong                id)
+{
+  GSource *source = g_main_context_find_source_by_id (NULL, id);
+
+  if (source)
+    g_source_destroy (source);
 }
 
 static gboolean
@@ -90,13 +199,51 @@ initable_init (GInitable     *initable,
                GCancellable  *cancellable,
                GError       **error)
 {
+  FbdDroidVibraBackendSysfs *self = FBD_DROID_VIBRA_BACKEND_SYSFS (initable);
+  g_autofree char *content = NULL;
+
+  if (g_file_get_contents (SYSFS_MULTIPLIER_CONFIG, &content, NULL, NULL)) {
+    self->multiplier = MAX (atoi (content), 1);
+    self->off_delay = SYSFS_OFF_DELAY_MS;
+    g_debug ("Using duration multiplier %d", self->multiplier);
+  }
+
+  self->duration_fd = open (SYSFS_DURATION_NODE, O_WRONLY | O_CLOEXEC);
+  if (self->duration_fd < 0) {
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                 "Unable to open %s: %s", SYSFS_DURATION_NODE, g_strerror (errno));
+    return FALSE;
+  }
+
+  self->activate_fd = open (SYSFS_ACTIVATE_NODE, O_WRONLY | O_CLOEXEC);
+  if (self->activate_fd < 0) {
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                 "Unable to open %s: %s", SYSFS_ACTIVATE_NODE, g_strerror (errno));
+    return FALSE;
+  }
+
   return TRUE;
 }
 
+static void
+fbd_droid_vibra_backend_sysfs_finalize (GObject *object)
+{
+  FbdDroidVibraBackendSysfs *self = FBD_DROID_VIBRA_BACKEND_SYSFS (object);
+
+  if (self->duration_fd >= 0)
+    g_close (self->duration_fd, NULL);
+  if (self->activate_fd >= 0)
+    g_close (self->activate_fd, NULL);
+
+  G_OBJECT_CLASS (fbd_droid_vibra_backend_sysfs_parent_class)->finalize (object);
+}
+
 static void
 fbd_droid_vibra_backend_sysfs_class_init (FbdDroidVibraBackendSysfsClass *klass)
 {
-  // nothing to see here
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = fbd_droid_vibra_backend_sysfs_finalize;
 }
 
 static void
@@ -110,15 +257,24 @@ fbd_droid_vibra_backend_interface_init (FbdDroidVibraBackendInterface *iface)
 {
   iface->on  = fbd_droid_vibra_backend_sysfs_on;
   iface->off = fbd_droid_vibra_backend_sysfs_off;
+  iface->on_async  = fbd_droid_vibra_backend_sysfs_on_async;
+  iface->off_async = fbd_droid_vibra_backend_sysfs_off_async;
+  iface->cancel    = fbd_droid_vibra_backend_sysfs_cancel;
 }
 
 static void
 fbd_droid_vibra_backend_sysfs_init (FbdDroidVibraBackendSysfs *self)
 {
-  // nothing to see here
+  self->duration_fd = -1;
+  self->activate_fd = -1;
+  self->multiplier = 1;
 }
 
 FbdDroidVibraBackendSysfs *
 fbd_droid_vibra_backend_sysfs_new (GError **error) {
-  return g_object_new (FBD_TYPE_DROID_VIBRA_BACKEND_SYSFS, NULL);
+  return FBD_DROID_VIBRA_BACKEND_SYSFS (
+    g_initable_new (FBD_TYPE_DROID_VIBRA_BACKEND_SYSFS,
+                    NULL,
+                    error,
+                    NULL));
 }
@@ -13,7 +13,29 @@ G_DEFINE_INTERFACE (FbdDroidVibraBackend, fbd_droid_vibra_backend, G_TYPE_OBJECT
 static void
 fbd_droid_vibra_backend_default_init (FbdDroidVibraBackendInterface *iface)
 {
-    /* Nothing yet */
+  /**
+   * FbdDroidVibraBackend::effect-completed:
+   *
+   * Emitted when the HAL reports that an effect finished playing.
+   */
+  g_signal_new ("effect-completed",
+                G_TYPE_FROM_INTERFACE (iface),
+                G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+                NULL,
+                G_TYPE_NONE,
+                0);
+
+  /**
+   * FbdDroidVibraBackend::reconnected:
+   *
+   * Emitted when the HAL is reachable again after it went away.
+   */
+  g_signal_new ("reconnected",
+                G_TYPE_FROM_INTERFACE (iface),
+                G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+                NULL,
+                G_TYPE_NONE,
+                0);
 }
 
 gboolean
@@ -40,3 +62,294 @@ fbd_droid_vibra_backend_off (FbdDroidVibraBackend *self)
   g_return_val_if_fail (iface->off != NULL, FALSE);
   return iface->off (self);
 }
+
+/**
+ * fbd_droid_vibra_backend_supports_async:
+ * @self: The backend
+ *
+ * Whether the backend can turn the motor on and off without blocking.
+ * Other backends need to be driven from a worker thread.
+ *
+ * Returns: %TRUE if the asynchronous methods are implemented
+ */
+gboolean
+fbd_droid_vibra_backend_supports_async (FbdDroidVibraBackend *self)
+{
+  FbdDroidVibraBackendInterface *iface;
+
+  g_return_val_if_fail (FBD_IS_DROID_VIBRA_BACKEND (self), FALSE);
+
+  iface = FBD_DROID_VIBRA_BACKEND_GET_IFACE (self);
+  return iface->on_async && iface->off_async && iface->cancel;
+}
+
+/**
+ * fbd_droid_vibra_backend_on_async:
+ * @self: The backend
+ * @duration: The duration in ms
+ * @callback: (nullable): Invoked once the motor was turned on
+ * @user_data: User data for @callback
+ *
+ * Turns the motor on without waiting for the HAL.
+ *
+ * Returns: An id to cancel the request with or `0` on error
+ */
+gulong
+fbd_droid_vibra_backend_on_async (FbdDroidVibraBackend          *self,
+                                  int                            duration,
+                                  FbdDroidVibraBackendReplyFunc  callback,
+                                  gpointer                       user_data)
+{
+  FbdDroidVibraBackendInterface *iface;
+
+  g_return_val_if_fail (FBD_IS_DROID_VIBRA_BACKEND (self), 0);
+
+  iface = FBD_DROID_VIBRA_BACKEND_GET_IFACE (self);
+  g_return_val_if_fail (iface->on_async != NULL, 0);
+  return iface->on_async (self, duration, callback, user_data);
+}
+
+/**
+ * fbd_droid_vibra_backend_off_async:
+ * @self: The backend
+ * @callback: (nullable): Invoked once the motor was turned off
+ * @user_data: User data for @callback
+ *
+ * Turns the motor off without waiting for the HAL.
+ *
+ * Returns: An id to cancel the request with or `0` on error
+ */
+gulong
+fbd_droid_vibra_backend_off_async (FbdDroidVibraBackend          *self,
+                                   FbdDroidVibraBackendReplyFunc  callback,
+                                   gpointer                       user_data)
+{
+  FbdDroidVibraBackendInterface *iface;
+
+  g_return_val_if_fail (FBD_IS_DROID_VIBRA_BACKEND (self), 0);
+
+  iface = FBD_DROID_VIBRA_BACKEND_GET_IFACE (self);
+  g_return_val_if_fail (iface->off_async != NULL, 0);
+  return iface->off_async (self, callback, user_data);
+}
+
+/**
+ * fbd_droid_vibra_backend_cancel:
+ * @self: The backend
+ * @id: The id of an asynchronous request
+ *
+ * Cancels an asynchronous request. Its callback won't be invoked.
+ */
+void
+fbd_droid_vibra_backend_cancel (FbdDroidVibraBackend *self, gulong id)
+{
+  FbdDroidVibraBackendInterface *iface;
+
+  g_return_if_fail (FBD_IS_DROID_VIBRA_BACKEND (self));
+
+  iface = FBD_DROID_VIBRA_BACKEND_GET_IFACE (self);
+  g_return_if_fail (iface->cancel != NULL);
+  iface->cancel (self, id);
+}
+
+/**
+ * fbd_droid_vibra_backend_get_features:
+ * @self: The backend
+ *
+ * Get the optional features supported by the backend and the HAL.
+ *
+ * Returns: The supported features
+ */
+FbdDroidVibraBackendFeatures
+fbd_droid_vibra_backend_get_features (FbdDroidVibraBackend *self)
+{
+  FbdDroidVibraBackendInterface *iface;
+
+  g_return_val_if_fail (FBD_IS_DROID_VIBRA_BACKEND (self), FBD_DROID_VIBRA_BACKEND_FEATURE_NONE);
+
+  iface = FBD_DROID_VIBRA_BACKEND_GET_IFACE (self);
+  if (iface->get_features == NULL)
+    return FBD_DROID_VIBRA_BACKEND_FEATURE_NONE;
+
+  return iface->get_features (self);
+}
+
+/**
+ * fbd_droid_vibra_backend_supports_effect:
+ * @self: The backend
+ * @effect: The effect
+ *
+ * Whether the HAL has a prebaked waveform for @effect that can be
+ * played via fbd_droid_vibra_backend_perform_async().
+ *
+ * Returns: %TRUE if the effect is supported
+ */
+gboolean
+fbd_droid_vibra_backend_supports_effect (FbdDroidVibraBackend *self,
+                                         FbdDroidVibraEffect   effect)
+{
+  FbdDroidVibraBackendInterface *iface;
+
+  g_return_val_if_fail (FBD_IS_DROID_VIBRA_BACKEND (self), FALSE);
+
+  iface = FBD_DROID_VIBRA_BACKEND_GET_IFACE (self);
+  if (iface->supports_effect == NULL)
+    return FALSE;
+
+  return iface->supports_effect (self, effect);
+}
+
+/**
+ * fbd_droid_vibra_backend_can_compose:
+ * @self: The backend
+ * @composite: The composition
+ * @n_composite: The number of steps in @composite
+ *
+ * Whether the HAL can play the given composition, i.e. it supports
+ * all the primitives and the composition doesn't exceed its limits.
+ *
+ * Returns: %TRUE if the composition can be played
+ */
+gboolean
+fbd_droid_vibra_backend_can_compose (FbdDroidVibraBackend               *self,
+                                     const FbdDroidVibraCompositeEffect *composite,
+                                     guint                               n_composite)
+{
+  FbdDroidVibraBackendInterface *iface;
+
+  g_return_val_if_fail (FBD_IS_DROID_VIBRA_BACKEND (self), FALSE);
+
+  iface = FBD_DROID_VIBRA_BACKEND_GET_IFACE (self);
+  if (iface->can_compose == NULL)
+    return FALSE;
+
+  return iface->can_compose (self, composite, n_composite);
+}
+
+/**
+ * fbd_droid_vibra_backend_perform_async:
+ * @self: The backend
+ * @effect: The effect to play
+ * @strength: The effect's strength
+ * @callback: (nullable): Invoked once the HAL started the effect
+ * @user_data: User data for @callback
+ *
+ * Plays a prebaked effect.
+ *
+ * Returns: An id to cancel the request with or `0` on error
+ */
+gulong
+fbd_droid_vibra_backend_perform_async (FbdDroidVibraBackend          *self,
+                                       FbdDroidVibraEffect            effect,
+                                       FbdDroidVibraEffectStrength    strength,
+                                       FbdDroidVibraBackendReplyFunc  callback,
+                                       gpointer                       user_data)
+{
+  FbdDroidVibraBackendInterface *iface;
+
+  g_return_val_if_fail (FBD_IS_DROID_VIBRA_BACKEND (self), 0);
+
+  iface = FBD_DROID_VIBRA_BACKEND_GET_IFACE (self);
+  g_return_val_if_fail (iface->perform_async != NULL, 0);
+  return iface->perform_async (self, effect, strength, callback, user_data);
+}
+
+/**
+ * fbd_droid_vibra_backend_set_amplitude_async:
+ * @self: The backend
+ * @amplitude: The amplitude in the range `(0.0, 1.0]`
+ * @callback: (nullable): Invoked once the amplitude was set
+ * @user_data: User data for @callback
+ *
+ * Sets the amplitude used by subsequent calls to turn the motor on.
+ *
+ * Returns: An id to cancel the request with or `0` on error
+ */
+gulong
+fbd_droid_vibra_backend_set_amplitude_async (FbdDroidVibraBackend          *self,
+                                             float                          amplitude,
+                                             FbdDroidVibraBackendReplyFunc  callback,
+                                             gpointer                       user_data)
+{
+  FbdDroidVibraBackendInterface *iface;
+
+  g_return_val_if_fail (FBD_IS_DROID_VIBRA_BACKEND (self), 0);
+
+  iface = FBD_DROID_VIBRA_BACKEND_GET_IFACE (self);
+  g_return_val_if_fail (iface->set_amplitude_async != NULL, 0);
+  return iface->set_amplitude_async (self, amplitude, callback, user_data);
+}
+
+/**
+ * fbd_droid_vibra_backend_compose_async:
+ * @self: The backend
+ * @composite: The composition
+ * @n_composite: The number of steps in @composite
+ * @callback: (nullable): Invoked once the HAL started the composition
+ * @user_data: User data for @callback
+ *
+ * Plays a sequence of primitives.
+ *
+ * Returns: An id to cancel the request with or `0` on error
+ */
+gulong
+fbd_droid_vibra_backend_compose_async (FbdDroidVibraBackend               *self,
+                                       const FbdDroidVibraCompositeEffect *composite,
+                                       guint                               n_composite,
+                                       FbdDroidVibraBackendReplyFunc       callback,
+                                       gpointer                            user_data)
+{
+  FbdDroidVibraBackendInterface *iface;
+
+  g_return_val_if_fail (FBD_IS_DROID_VIBRA_BACKEND (self), 0);
+
+  iface = FBD_DROID_VIBRA_BACKEND_GET_IFACE (self);
+  g_return_val_if_fail (iface->compose_async != NULL, 0);
+  return iface->compose_async (self, composite, n_composite, callback, user_data);
+}
+
+/**
+ * fbd_droid_vibra_backend_is_available:
+ * @self: The backend
+ *
+ * Whether the HAL is currently reachable. Backends whose HAL can go away
+ * emit #FbdDroidVibraBackend::reconnected once it's back. This can be
+ * called from any thread.
+ *
+ * Returns: %TRUE if requests can be sent
+ */
+gboolean
+fbd_droid_vibra_backend_is_available (FbdDroidVibraBackend *self)
+{
+  FbdDroidVibraBackendInterface *iface;
+
+  g_return_val_if_fail (FBD_IS_DROID_VIBRA_BACKEND (self), FALSE);
+
+  iface = FBD_DROID_VIBRA_BACKEND_GET_IFACE (self);
+  if (iface->is_available == NULL)
+    return TRUE;
+
+  return iface->is_available (self);
+}
+
+/**
+ * fbd_droid_vibra_backend_probe:
+ * @self: The backend
+ *
+ * Queries what the HAL can do. This blocks on the HAL so it's meant to
+ * be called from a thread once after creating the backend and before
+ * using it.
+ */
+void
+fbd_droid_vibra_backend_probe (FbdDroidVibraBackend *self)
+{
+  FbdDroidVibraBackendInterface *iface;
+
+  g_return_if_fail (FBD_IS_DROID_VIBRA_BACKEND (self));
+
+  iface = FBD_DROID_VIBRA_BACKEND_GET_IFACE (self);
+  if (iface->probe == NULL)
+    return;
+
+  iface->probe (self);
+}
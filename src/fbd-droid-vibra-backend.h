@@ -13,6 +13,64 @@ G_BEGIN_DECLS
 #define FBD_TYPE_DROID_VIBRA_BACKEND fbd_droid_vibra_backend_get_type()
 G_DECLARE_INTERFACE (FbdDroidVibraBackend, fbd_droid_vibra_backend, FBD, DROID_VIBRA_BACKEND, GObject)
 
+/* Values match android.hardware.vibrator.Effect */
+typedef enum {
+  FBD_DROID_VIBRA_EFFECT_CLICK        = 0,
+  FBD_DROID_VIBRA_EFFECT_DOUBLE_CLICK = 1,
+  FBD_DROID_VIBRA_EFFECT_TICK         = 2,
+  FBD_DROID_VIBRA_EFFECT_THUD         = 3,
+  FBD_DROID_VIBRA_EFFECT_POP          = 4,
+  FBD_DROID_VIBRA_EFFECT_HEAVY_CLICK  = 5,
+} FbdDroidVibraEffect;
+
+/* Values match android.hardware.vibrator.EffectStrength */
+typedef enum {
+  FBD_DROID_VIBRA_EFFECT_STRENGTH_LIGHT  = 0,
+  FBD_DROID_VIBRA_EFFECT_STRENGTH_MEDIUM = 1,
+  FBD_DROID_VIBRA_EFFECT_STRENGTH_STRONG = 2,
+} FbdDroidVibraEffectStrength;
+
+/* Values match android.hardware.vibrator.CompositePrimitive */
+typedef enum {
+  FBD_DROID_VIBRA_PRIMITIVE_NOOP       = 0,
+  FBD_DROID_VIBRA_PRIMITIVE_CLICK      = 1,
+  FBD_DROID_VIBRA_PRIMITIVE_THUD       = 2,
+  FBD_DROID_VIBRA_PRIMITIVE_SPIN       = 3,
+  FBD_DROID_VIBRA_PRIMITIVE_QUICK_RISE = 4,
+  FBD_DROID_VIBRA_PRIMITIVE_SLOW_RISE  = 5,
+  FBD_DROID_VIBRA_PRIMITIVE_QUICK_FALL = 6,
+  FBD_DROID_VIBRA_PRIMITIVE_LIGHT_TICK = 7,
+  FBD_DROID_VIBRA_PRIMITIVE_LOW_TICK   = 8,
+} FbdDroidVibraPrimitive;
+
+/* A step of a composition, see android.hardware.vibrator.CompositeEffect */
+typedef struct {
+  guint                  delay;     /* in ms, before the primitive starts */
+  FbdDroidVibraPrimitive primitive;
+  float                  scale;     /* [0.0, 1.0] */
+} FbdDroidVibraCompositeEffect;
+
+/*
+ * Compositions always report completion via #FbdDroidVibraBackend::effect-completed,
+ * on and perform requests only with the corresponding callback feature.
+ */
+typedef enum {
+  FBD_DROID_VIBRA_BACKEND_FEATURE_NONE             = 0,
+  FBD_DROID_VIBRA_BACKEND_FEATURE_AMPLITUDE        = (1 << 0),
+  FBD_DROID_VIBRA_BACKEND_FEATURE_COMPOSE          = (1 << 1),
+  FBD_DROID_VIBRA_BACKEND_FEATURE_ON_CALLBACK      = (1 << 2),
+  FBD_DROID_VIBRA_BACKEND_FEATURE_PERFORM_CALLBACK = (1 << 3),
+} FbdDroidVibraBackendFeatures;
+
+/**
+ * FbdDroidVibraBackendReplyFunc:
+ * @success: Whether the request succeeded
+ * @user_data: The user data passed when starting the request
+ *
+ * Invoked in the main context once an asynchronous request completed.
+ */
+typedef void (*FbdDroidVibraBackendReplyFunc) (gboolean success, gpointer user_data);
+
 struct _FbdDroidVibraBackendInterface
 {
   GTypeInterface parent_iface;
@@ -20,10 +78,82 @@ struct _FbdDroidVibraBackendInterface
   gboolean (*on)  (FbdDroidVibraBackend *self,
                    int                   duration);
   gboolean (*off) (FbdDroidVibraBackend *self);
+
+  /* Optional, for backends that don't need to block */
+  gulong   (*on_async)  (FbdDroidVibraBackend          *self,
+                         int                            duration,
+                         FbdDroidVibraBackendReplyFunc  callback,
+                         gpointer                       user_data);
+  gulong   (*off_async) (FbdDroidVibraBackend          *self,
+                         FbdDroidVibraBackendReplyFunc  callback,
+                         gpointer                       user_data);
+  void     (*cancel)    (FbdDroidVibraBackend          *self,
+                         gulong                         id);
+
+  /* Optional, HAL effects beyond on/off. Backends implementing these need to be async too */
+  FbdDroidVibraBackendFeatures (*get_features) (FbdDroidVibraBackend *self);
+  gboolean (*supports_effect)     (FbdDroidVibraBackend               *self,
+                                   FbdDroidVibraEffect                 effect);
+  gboolean (*can_compose)         (FbdDroidVibraBackend               *self,
+                                   const FbdDroidVibraCompositeEffect *composite,
+                                   guint                               n_composite);
+  gulong   (*perform_async)       (FbdDroidVibraBackend               *self,
+                                   FbdDroidVibraEffect                 effect,
+                                   FbdDroidVibraEffectStrength         strength,
+                                   FbdDroidVibraBackendReplyFunc       callback,
+                                   gpointer                            user_data);
+  gulong   (*set_amplitude_async) (FbdDroidVibraBackend               *self,
+                                   float                               amplitude,
+                                   FbdDroidVibraBackendReplyFunc       callback,
+                                   gpointer                            user_data);
+  gulong   (*compose_async)       (FbdDroidVibraBackend               *self,
+                                   const FbdDroidVibraCompositeEffect *composite,
+                                   guint                               n_composite,
+                                   FbdDroidVibraBackendReplyFunc       callback,
+                                   gpointer                            user_data);
+
+  /* Optional, for backends whose HAL can go away */
+  gboolean (*is_available)        (FbdDroidVibraBackend               *self);
+
+  /* Optional, for backends that need to query the HAL before use */
+  void     (*probe)               (FbdDroidVibraBackend               *self);
 };
 
 gboolean fbd_droid_vibra_backend_on  (FbdDroidVibraBackend *self,
                                       int                   duration);
 gboolean fbd_droid_vibra_backend_off (FbdDroidVibraBackend  *self);
+gboolean fbd_droid_vibra_backend_supports_async (FbdDroidVibraBackend *self);
+gulong   fbd_droid_vibra_backend_on_async  (FbdDroidVibraBackend          *self,
+                                            int                            duration,
+                                            FbdDroidVibraBackendReplyFunc  callback,
+                                            gpointer                       user_data);
+gulong   fbd_droid_vibra_backend_off_async (FbdDroidVibraBackend          *self,
+                                            FbdDroidVibraBackendReplyFunc  callback,
+                                            gpointer                       user_data);
+void     fbd_droid_vibra_backend_cancel    (FbdDroidVibraBackend          *self,
+                                            gulong                         id);
+FbdDroidVibraBackendFeatures
+         fbd_droid_vibra_backend_get_features        (FbdDroidVibraBackend               *self);
+gboolean fbd_droid_vibra_backend_supports_effect     (FbdDroidVibraBackend               *self,
+                                                      FbdDroidVibraEffect                 effect);
+gboolean fbd_droid_vibra_backend_can_compose         (FbdDroidVibraBackend               *self,
+                                                      const FbdDroidVibraCompositeEffect *composite,
+                                                      guint                               n_composite);
+gulong   fbd_droid_vibra_backend_perform_async       (FbdDroidVibraBackend               *self,
+                                                      FbdDroidVibraEffect                 effect,
+                                                      FbdDroidVibraEffectStrength         strength,
+                                                      FbdDroidVibraBackendReplyFunc       callback,
+                                                      gpointer                            user_data);
+gulong   fbd_droid_vibra_backend_set_amplitude_async (FbdDroidVibraBackend               *self,
+                                                      float                               amplitude,
+                                                      FbdDroidVibraBackendReplyFunc       callback,
+                                                      gpointer                            user_data);
+gulong   fbd_droid_vibra_backend_compose_async       (FbdDroidVibraBackend               *self,
+                                                      const FbdDroidVibraCompositeEffect *composite,
+                                                      guint                               n_composite,
+                                                      FbdDroidVibraBackendReplyFunc       callback,
+                                                      gpointer                            user_data);
+gboolean fbd_droid_vibra_backend_is_available        (FbdDroidVibraBackend               *self);
+void     fbd_droid_vibra_backend_probe               (FbdDroidVibraBackend               *self);
 
 G_END_DECLS
@@ -12,6 +12,7 @@
 
 #include "fbd-droid-vibra.h"
 #include "fbd-binder.h"
+#include "fbd-io-worker.h"
 
 #include "fbd-droid-vibra-backend.h"
 #include "fbd-droid-vibra-backend-hidl.h"
@@ -32,6 +33,15 @@
  *
  * The #FbdDevVibra is used to interface with haptic motor via the force
  * feedback interface. It currently only supports one id at a time.
+ * Backends are driven by asynchronous requests with at most one in
+ * flight. Backends that can only block are driven from the device's
+ * #FbdIoWorker.
+ *
+ * If the HAL reports completion of effects #FbdDevVibra::effect-ended is
+ * emitted and turning off an already idle motor is skipped.
+ *
+ * Effects requested while the HAL is gone (e.g. restarting) are dropped
+ * as they'd be stale once it's back.
  */
 
 enum {
@@ -41,11 +51,24 @@ enum {
 };
 static GParamSpec *props[PROP_LAST_PROP];
 
-typedef enum {
-    FBD_DEV_VIBRA_FEATURE_RUMBLE,
-    FBD_DEV_VIBRA_FEATURE_PERIODIC,
-    FBD_DEV_VIBRA_FEATURE_GAIN,
-} FbdDevVibraFeatureFlags;
+enum {
+    SIGNAL_EFFECT_ENDED,
+    N_SIGNALS
+};
+static guint signals[N_SIGNALS];
+
+/* Rumbles up to this length (in ms) are played as prebaked effects */
+#define FBD_DROID_VIBRA_TICK_MAX  15
+#define FBD_DROID_VIBRA_CLICK_MAX 40
+/*
+ * How late the HAL's completion callback might arrive: requests are
+ * sent one at a time so ours can wait for one in flight, and the
+ * callback needs a binder round trip after the HAL's own off timer
+ * fired.
+ */
+#define FBD_DROID_VIBRA_COMPLETION_LATENCY 500 /* ms */
+
+typedef struct _FbdDroidVibraRequest FbdDroidVibraRequest;
 
 typedef struct _FbdDevVibra {
     GObject parent;
@@ -53,12 +76,33 @@ typedef struct _FbdDevVibra {
     GUdevDevice *device;
 
     FbdDroidVibraBackend *backend;
+    FbdIoWorker *worker; /* only for backends that block */
+
+    /* No HAL was up at init, wait for one to show up */
+    GPtrArray *hal_services;
+    gboolean creating_backend;
+
+    /* Asynchronous backends */
+    FbdDroidVibraBackendFeatures features;
+    GQueue requests;          /* not yet sent */
+    gulong transaction_id;    /* in flight request */
+    FbdDroidVibraRequest *in_flight;
+    float amplitude;          /* last one sent to the HAL, < 0 if unknown */
+    guint n_callbacks;        /* sent effects that will report completion */
+    gboolean motor_idle;      /* stopped or completed, no effect queued */
+
+    guint gain; /* in percent */
 } FbdDevVibra;
 
 static void initable_iface_init (GInitableIface *iface);
+static void async_initable_iface_init (GAsyncInitableIface *iface);
+static void fbd_droid_vibra_request_free (FbdDroidVibraRequest *req);
+static void on_effect_completed (FbdDevVibra *self);
+static void on_backend_reconnected (FbdDevVibra *self);
 
 G_DEFINE_TYPE_WITH_CODE (FbdDevVibra, fbd_dev_vibra, G_TYPE_OBJECT,
-                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, initable_iface_init));
+                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, initable_iface_init)
+                         G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_INITABLE, async_initable_iface_init));
 
 static void
 fbd_dev_vibra_set_property (GObject      *object,
@@ -94,51 +138,347 @@ fbd_dev_vibra_get_property (GObject    *object,
 }
 
 
+/* Some devices cannot use either hidl or aidl backends, but sysfs works fine for them */
+#define FBD_DROID_VIBRA_SYSFS_MARKER "/usr/lib/droidian/device/vibrator-sysfs"
+
+typedef FbdDroidVibraBackend *(*FbdDroidVibraBackendNewFunc) (GError **error);
+
+/* HAL backends, best first */
+static const struct {
+    const char                  *name;
+    FbdBinderService          *(*get_service) (void);
+    FbdDroidVibraBackendNewFunc  new;
+} hal_backends[] = {
+    { "AIDL", fbd_droid_vibra_backend_aidl_get_service,
+      (FbdDroidVibraBackendNewFunc) fbd_droid_vibra_backend_aidl_new },
+    { "HIDL", fbd_droid_vibra_backend_hidl_get_service,
+      (FbdDroidVibraBackendNewFunc) fbd_droid_vibra_backend_hidl_new },
+};
+
+
+static void
+fbd_dev_vibra_set_backend (FbdDevVibra *self, FbdDroidVibraBackend *backend)
+{
+    self->backend = backend;
+    self->features = fbd_droid_vibra_backend_get_features (self->backend);
+    g_signal_connect_object (self->backend, "effect-completed",
+                             G_CALLBACK (on_effect_completed),
+                             self,
+                             G_CONNECT_SWAPPED);
+    g_signal_connect_object (self->backend, "reconnected",
+                             G_CALLBACK (on_backend_reconnected),
+                             self,
+                             G_CONNECT_SWAPPED);
+    g_debug ("Droid vibra device usable, backend features 0x%x", self->features);
+}
+
+
 static gboolean
 initable_init (GInitable     *initable,
                GCancellable  *cancellable,
                GError       **error)
 {
     FbdDevVibra *self = FBD_DEV_VIBRA (initable);
-    char *device, *iface, *fqname;
-    int i;
+    FbdBinderService *services[G_N_ELEMENTS (hal_backends)];
+    FbdDroidVibraBackend *backend = NULL;
 
     g_debug ("initializing droid vibra");
 
-    // Some devices cannot use either hidl or aidl backends, but sysfs works fine for them
-    if (g_file_test ("/usr/lib/droidian/device/vibrator-sysfs", G_FILE_TEST_EXISTS)) {
-        self->backend = (FbdDroidVibraBackend *) fbd_droid_vibra_backend_sysfs_new (error);
-        if (!self->backend) {
-            g_set_error (error,
-                         G_IO_ERROR, G_IO_ERROR_FAILED,
-                         "Failed to initialize vibrator backend using sysfs");
+    if (g_file_test (FBD_DROID_VIBRA_SYSFS_MARKER, G_FILE_TEST_EXISTS)) {
+        backend = (FbdDroidVibraBackend *) fbd_droid_vibra_backend_sysfs_new (error);
+        if (!backend) {
+            g_prefix_error (error, "Failed to initialize vibrator backend using sysfs: ");
             return FALSE;
         }
 
         g_debug ("Droid vibra device initialized using sysfs backend");
+        fbd_dev_vibra_set_backend (self, backend);
         return TRUE;
     }
 
-    /* Try with AIDL first */
-    self->backend = (FbdDroidVibraBackend *) fbd_droid_vibra_backend_aidl_new (error);
+    /* Look up all HALs once, the backends reuse the result */
+    for (guint i = 0; i < G_N_ELEMENTS (hal_backends); i++)
+        services[i] = hal_backends[i].get_service ();
+    fbd_binder_services_resolve (services, G_N_ELEMENTS (services));
 
-    if (!self->backend) {
-        /* No luck, try with HIDL */
-        self->backend = (FbdDroidVibraBackend *) fbd_droid_vibra_backend_hidl_new (error);
+    for (guint i = 0; i < G_N_ELEMENTS (hal_backends) && backend == NULL; i++) {
+        g_autoptr (GError) err = NULL;
 
-        if (!self->backend) {
-            g_set_error (error,
-                         G_IO_ERROR, G_IO_ERROR_FAILED,
-                         "Failed to obtain suitable vibrator hal");
-            return FALSE;
-        }
+        backend = hal_backends[i].new (&err);
+        if (backend == NULL)
+            g_debug ("Failed to init %s vibra backend: %s", hal_backends[i].name, err->message);
+        else
+            fbd_droid_vibra_backend_probe (backend);
     }
 
-    g_debug ("Droid vibra device usable");
+    for (guint i = 0; i < G_N_ELEMENTS (hal_backends); i++)
+        g_object_unref (services[i]);
+
+    if (backend == NULL) {
+        g_set_error (error,
+                     G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "Failed to obtain suitable vibrator hal");
+        return FALSE;
+    }
+
+    fbd_dev_vibra_set_backend (self, backend);
     return TRUE;
 }
 
 
+typedef struct {
+    FbdBinderService *services[G_N_ELEMENTS (hal_backends)];
+    gboolean          resolved[G_N_ELEMENTS (hal_backends)];
+    gboolean          done;
+} FbdDroidVibraProbe;
+
+
+static void
+fbd_droid_vibra_probe_free (FbdDroidVibraProbe *probe)
+{
+    for (guint i = 0; i < G_N_ELEMENTS (hal_backends); i++)
+        g_clear_object (&probe->services[i]);
+    g_free (probe);
+}
+
+
+/* Runs in a thread as querying the HAL blocks on binder transactions */
+static void
+probe_backend_thread (GTask        *task,
+                      gpointer      source_object,
+                      gpointer      task_data,
+                      GCancellable *cancellable)
+{
+    fbd_droid_vibra_backend_probe (FBD_DROID_VIBRA_BACKEND (source_object));
+
+    g_task_return_boolean (task, TRUE);
+}
+
+
+static void
+on_backend_probed (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    FbdDroidVibraBackend *backend = FBD_DROID_VIBRA_BACKEND (source_object);
+    g_autoptr (GTask) task = G_TASK (user_data);
+    FbdDevVibra *self = g_task_get_source_object (task);
+    g_autoptr (GError) err = NULL;
+
+    if (!g_task_propagate_boolean (G_TASK (res), &err)) {
+        g_task_return_error (task, g_steal_pointer (&err));
+        return;
+    }
+
+    fbd_dev_vibra_set_backend (self, g_object_ref (backend));
+    g_task_return_boolean (task, TRUE);
+}
+
+
+static void
+fbd_dev_vibra_stop_waiting (FbdDevVibra *self)
+{
+    if (self->hal_services == NULL)
+        return;
+
+    for (guint i = 0; i < self->hal_services->len; i++)
+        g_signal_handlers_disconnect_by_data (g_ptr_array_index (self->hal_services, i), self);
+    g_clear_pointer (&self->hal_services, g_ptr_array_unref);
+}
+
+
+static void
+on_late_backend_probed (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    FbdDroidVibraBackend *backend = FBD_DROID_VIBRA_BACKEND (source_object);
+    g_autoptr (FbdDevVibra) self = FBD_DEV_VIBRA (user_data);
+
+    self->creating_backend = FALSE;
+    if (!g_task_propagate_boolean (G_TASK (res), NULL))
+        return;
+
+    fbd_dev_vibra_set_backend (self, g_object_ref (backend));
+    fbd_dev_vibra_stop_waiting (self);
+}
+
+
+static void
+on_hal_service_found (FbdDevVibra *self, FbdBinderService *service)
+{
+    g_autoptr (GError) err = NULL;
+    g_autoptr (GTask) task = NULL;
+    g_autoptr (FbdDroidVibraBackend) backend = NULL;
+    guint index;
+
+    if (self->backend || self->creating_backend)
+        return;
+
+    if (!g_ptr_array_find (self->hal_services, service, &index))
+        return;
+
+    backend = hal_backends[index].new (&err);
+    if (backend == NULL) {
+        g_warning ("Failed to init %s vibra backend: %s", hal_backends[index].name, err->message);
+        return;
+    }
+
+    g_message ("Vibrator hal showed up, using %s vibra backend", hal_backends[index].name);
+    self->creating_backend = TRUE;
+    task = g_task_new (backend, NULL, on_late_backend_probed, g_object_ref (self));
+    g_task_set_source_tag (task, on_hal_service_found);
+    g_task_run_in_thread (task, probe_backend_thread);
+}
+
+
+/*
+ * The HALs might still be starting up. Their lookups are retried in
+ * the background so use the first one that shows up.
+ */
+static void
+fbd_dev_vibra_wait_for_hal (FbdDevVibra *self, FbdBinderService **services)
+{
+    g_debug ("No vibrator hal available, waiting for one to show up");
+
+    self->hal_services = g_ptr_array_new_with_free_func (g_object_unref);
+    for (guint i = 0; i < G_N_ELEMENTS (hal_backends); i++) {
+        g_ptr_array_add (self->hal_services, g_object_ref (services[i]));
+        g_signal_connect_object (services[i], "reconnected",
+                                 G_CALLBACK (on_hal_service_found),
+                                 self,
+                                 G_CONNECT_SWAPPED);
+    }
+}
+
+
+/*
+ * Pick the best backend as soon as it's known: wait for more important
+ * lookups but don't wait for less important ones. The backend is
+ * created from the resolved service right away, only querying the
+ * HAL happens in a thread.
+ */
+static void
+fbd_dev_vibra_pick_backend (GTask *task)
+{
+    FbdDevVibra *self = g_task_get_source_object (task);
+    FbdDroidVibraProbe *probe = g_task_get_task_data (task);
+
+    if (probe->done)
+        return;
+
+    for (guint i = 0; i < G_N_ELEMENTS (hal_backends); i++) {
+        g_autoptr (GError) err = NULL;
+        g_autoptr (GTask) setup = NULL;
+        g_autoptr (FbdDroidVibraBackend) backend = NULL;
+
+        if (!probe->resolved[i])
+            return;
+
+        if (!fbd_binder_service_is_available (probe->services[i]))
+            continue;
+
+        backend = hal_backends[i].new (&err);
+        if (backend == NULL) {
+            g_debug ("Failed to init %s vibra backend: %s", hal_backends[i].name, err->message);
+            continue;
+        }
+
+        g_debug ("Using %s vibra backend", hal_backends[i].name);
+        probe->done = TRUE;
+        setup = g_task_new (backend, g_task_get_cancellable (task), on_backend_probed,
+                            g_object_ref (task));
+        g_task_set_source_tag (setup, fbd_dev_vibra_pick_backend);
+        g_task_run_in_thread (setup, probe_backend_thread);
+        return;
+    }
+
+    fbd_dev_vibra_wait_for_hal (self, probe->services);
+    probe->done = TRUE;
+    g_task_return_boolean (task, TRUE);
+}
+
+
+static void
+on_service_resolved (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    FbdBinderService *service = FBD_BINDER_SERVICE (source_object);
+    g_autoptr (GTask) task = G_TASK (user_data);
+    FbdDroidVibraProbe *probe = g_task_get_task_data (task);
+    g_autoptr (GError) err = NULL;
+
+    if (!fbd_binder_service_resolve_finish (service, res, &err))
+        g_debug ("%s", err->message);
+
+    for (guint i = 0; i < G_N_ELEMENTS (hal_backends); i++) {
+        if (probe->services[i] == service)
+            probe->resolved[i] = TRUE;
+    }
+
+    fbd_dev_vibra_pick_backend (task);
+}
+
+
+/*
+ * Look up all HALs in parallel without blocking, the chosen backend
+ * queries its HAL in a thread. If no HAL is up yet the device is usable
+ * once one shows up.
+ */
+static void
+async_initable_init_async (GAsyncInitable      *initable,
+                           int                  io_priority,
+                           GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+    FbdDevVibra *self = FBD_DEV_VIBRA (initable);
+    g_autoptr (GTask) task = NULL;
+    FbdDroidVibraProbe *probe;
+
+    g_debug ("initializing droid vibra asynchronously");
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_source_tag (task, async_initable_init_async);
+
+    if (g_file_test (FBD_DROID_VIBRA_SYSFS_MARKER, G_FILE_TEST_EXISTS)) {
+        GError *err = NULL;
+        FbdDroidVibraBackend *backend;
+
+        backend = (FbdDroidVibraBackend *) fbd_droid_vibra_backend_sysfs_new (&err);
+        if (backend == NULL) {
+            g_task_return_error (task, err);
+            return;
+        }
+
+        g_debug ("Droid vibra device initialized using sysfs backend");
+        fbd_dev_vibra_set_backend (self, backend);
+        g_task_return_boolean (task, TRUE);
+        return;
+    }
+
+    probe = g_new0 (FbdDroidVibraProbe, 1);
+    g_task_set_task_data (task, probe, (GDestroyNotify) fbd_droid_vibra_probe_free);
+
+    for (guint i = 0; i < G_N_ELEMENTS (hal_backends); i++)
+        probe->services[i] = hal_backends[i].get_service ();
+
+    for (guint i = 0; i < G_N_ELEMENTS (hal_backends); i++) {
+        fbd_binder_service_resolve_async (probe->services[i],
+                                          FBD_BINDER_RESOLVE_TIMEOUT_MS,
+                                          cancellable,
+                                          on_service_resolved,
+                                          g_object_ref (task));
+    }
+}
+
+
+static gboolean
+async_initable_init_finish (GAsyncInitable  *initable,
+                            GAsyncResult    *res,
+                            GError         **error)
+{
+    g_return_val_if_fail (g_task_is_valid (res, initable), FALSE);
+
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+
 static void
 initable_iface_init (GInitableIface *iface)
 {
@@ -146,6 +486,14 @@ initable_iface_init (GInitableIface *iface)
 }
 
 
+static void
+async_initable_iface_init (GAsyncInitableIface *iface)
+{
+    iface->init_async = async_initable_init_async;
+    iface->init_finish = async_initable_init_finish;
+}
+
+
 static void
 fbd_dev_vibra_dispose (GObject *object)
 {
@@ -153,6 +501,14 @@ fbd_dev_vibra_dispose (GObject *object)
 
     g_debug("Disposing droid vibra");
 
+    if (self->transaction_id) {
+        fbd_droid_vibra_backend_cancel (self->backend, self->transaction_id);
+        self->transaction_id = 0;
+    }
+    fbd_dev_vibra_stop_waiting (self);
+    g_clear_pointer (&self->in_flight, fbd_droid_vibra_request_free);
+    g_queue_clear_full (&self->requests, (GDestroyNotify) fbd_droid_vibra_request_free);
+    g_clear_object (&self->worker);
     g_clear_object (&self->device);
     g_clear_object (&self->backend);
 
@@ -188,12 +544,29 @@ fbd_dev_vibra_class_init (FbdDevVibraClass *klass)
           G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
     g_object_class_install_properties (object_class, PROP_LAST_PROP, props);
+
+    /**
+     * FbdDevVibra::effect-ended:
+     *
+     * Emitted when the HAL reported that the last effect stopped
+     * playing. See fbd_dev_vibra_reports_completion().
+     */
+    signals[SIGNAL_EFFECT_ENDED] = g_signal_new ("effect-ended",
+                                                 G_TYPE_FROM_CLASS (klass),
+                                                 G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+                                                 NULL,
+                                                 G_TYPE_NONE,
+                                                 0);
 }
 
 
 static void
 fbd_dev_vibra_init (FbdDevVibra *self)
 {
+    self->gain = 100;
+    self->amplitude = -1.0;
+    self->motor_idle = TRUE;
+    g_queue_init (&self->requests);
 }
 
 
@@ -207,25 +580,487 @@ fbd_dev_vibra_new (GUdevDevice *device, GError **error)
                                           NULL));
 }
 
+
+void
+fbd_dev_vibra_new_async (GUdevDevice         *device,
+                         GCancellable        *cancellable,
+                         GAsyncReadyCallback  callback,
+                         gpointer             user_data)
+{
+    g_async_initable_new_async (FBD_TYPE_DEV_VIBRA,
+                                G_PRIORITY_DEFAULT,
+                                cancellable,
+                                callback,
+                                user_data,
+                                "device", device,
+                                NULL);
+}
+
+
+FbdDevVibra *
+fbd_dev_vibra_new_finish (GAsyncResult *res, GError **error)
+{
+    g_autoptr (GObject) source = g_async_result_get_source_object (res);
+    GObject *object;
+
+    object = g_async_initable_new_finish (G_ASYNC_INITABLE (source), res, error);
+    if (object == NULL)
+        return NULL;
+
+    return FBD_DEV_VIBRA (object);
+}
+
+typedef struct {
+    FbdDevVibra *self;
+    guint        duration; /* 0 turns the motor off */
+} FbdDevVibraCmd;
+
+
+static void
+fbd_dev_vibra_cmd_free (FbdDevVibraCmd *cmd)
+{
+    g_object_unref (cmd->self);
+    g_free (cmd);
+}
+
+
+/* Runs in the io worker's thread */
+static gboolean
+fbd_dev_vibra_run_cmd (gpointer data, GError **error)
+{
+    FbdDevVibraCmd *cmd = data;
+    gboolean success;
+
+    if (cmd->duration)
+        success = fbd_droid_vibra_backend_on (cmd->self->backend, cmd->duration);
+    else
+        success = fbd_droid_vibra_backend_off (cmd->self->backend);
+
+    if (!success) {
+        g_set_error (error,
+                     G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "Failed to turn vibra %s", cmd->duration ? "on" : "off");
+    }
+
+    return success;
+}
+
+
+static void
+on_cmd_done (gpointer data, const GError *error)
+{
+    if (error && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("%s", error->message);
+}
+
+
+typedef enum {
+    FBD_DROID_VIBRA_REQUEST_OFF,
+    FBD_DROID_VIBRA_REQUEST_ON,
+    FBD_DROID_VIBRA_REQUEST_PERFORM,
+    FBD_DROID_VIBRA_REQUEST_AMPLITUDE,
+    FBD_DROID_VIBRA_REQUEST_COMPOSE,
+} FbdDroidVibraRequestType;
+
+static const char * const request_names[] = {
+    [FBD_DROID_VIBRA_REQUEST_OFF] = "off",
+    [FBD_DROID_VIBRA_REQUEST_ON] = "on",
+    [FBD_DROID_VIBRA_REQUEST_PERFORM] = "perform",
+    [FBD_DROID_VIBRA_REQUEST_AMPLITUDE] = "setAmplitude",
+    [FBD_DROID_VIBRA_REQUEST_COMPOSE] = "compose",
+};
+
+struct _FbdDroidVibraRequest {
+    FbdDroidVibraRequestType     type;
+    guint                        duration;
+    FbdDroidVibraEffect          effect;
+    FbdDroidVibraEffectStrength  strength;
+    float                        amplitude;
+    GArray                      *composite;
+};
+
+
+static void
+fbd_droid_vibra_request_free (FbdDroidVibraRequest *req)
+{
+    g_clear_pointer (&req->composite, g_array_unref);
+    g_free (req);
+}
+
+
+static FbdDroidVibraRequest *
+fbd_droid_vibra_request_new (FbdDroidVibraRequestType type)
+{
+    FbdDroidVibraRequest *req = g_new0 (FbdDroidVibraRequest, 1);
+
+    req->type = type;
+    return req;
+}
+
+
+static void fbd_dev_vibra_send_next (FbdDevVibra *self);
+
+static gboolean
+fbd_dev_vibra_request_reports_completion (FbdDevVibra *self, FbdDroidVibraRequest *req)
+{
+    switch (req->type) {
+    case FBD_DROID_VIBRA_REQUEST_ON:
+        return !!(self->features & FBD_DROID_VIBRA_BACKEND_FEATURE_ON_CALLBACK);
+    case FBD_DROID_VIBRA_REQUEST_PERFORM:
+        return !!(self->features & FBD_DROID_VIBRA_BACKEND_FEATURE_PERFORM_CALLBACK);
+    case FBD_DROID_VIBRA_REQUEST_COMPOSE:
+        return TRUE;
+    case FBD_DROID_VIBRA_REQUEST_OFF:
+    case FBD_DROID_VIBRA_REQUEST_AMPLITUDE:
+    default:
+        return FALSE;
+    }
+}
+
+
+static void
+on_effect_completed (FbdDevVibra *self)
+{
+    /* Stale, e.g. the effect was turned off meanwhile */
+    if (self->n_callbacks == 0)
+        return;
+
+    self->n_callbacks--;
+    /* Newer effects are still playing or about to be played */
+    if (self->n_callbacks || !g_queue_is_empty (&self->requests))
+        return;
+
+    self->motor_idle = TRUE;
+    g_signal_emit (self, signals[SIGNAL_EFFECT_ENDED], 0);
+}
+
+
+/* The restarted HAL starts from scratch */
+static void
+on_backend_reconnected (FbdDevVibra *self)
+{
+    g_debug ("Vibrator hal is back");
+
+    self->features = fbd_droid_vibra_backend_get_features (self->backend);
+    self->amplitude = -1.0;
+    self->n_callbacks = 0;
+    self->motor_idle = TRUE;
+}
+
+
+static void
+on_transaction_done (gboolean success, gpointer user_data)
+{
+    FbdDevVibra *self = FBD_DEV_VIBRA (user_data);
+    FbdDroidVibraRequest *req = g_steal_pointer (&self->in_flight);
+
+    self->transaction_id = 0;
+    if (!success) {
+        g_warning ("Vibra %s request failed", request_names[req->type]);
+        /* Don't rely on the HAL's amplitude anymore */
+        self->amplitude = -1.0;
+        /* No completion to wait for */
+        if (fbd_dev_vibra_request_reports_completion (self, req) && self->n_callbacks)
+            self->n_callbacks--;
+    }
+    fbd_droid_vibra_request_free (req);
+
+    fbd_dev_vibra_send_next (self);
+}
+
+
+static gulong
+fbd_dev_vibra_send_request (FbdDevVibra *self, FbdDroidVibraRequest *req)
+{
+    switch (req->type) {
+    case FBD_DROID_VIBRA_REQUEST_OFF:
+        return fbd_droid_vibra_backend_off_async (self->backend, on_transaction_done, self);
+    case FBD_DROID_VIBRA_REQUEST_ON:
+        return fbd_droid_vibra_backend_on_async (self->backend, req->duration,
+                                                 on_transaction_done, self);
+    case FBD_DROID_VIBRA_REQUEST_PERFORM:
+        return fbd_droid_vibra_backend_perform_async (self->backend, req->effect, req->strength,
+                                                      on_transaction_done, self);
+    case FBD_DROID_VIBRA_REQUEST_AMPLITUDE:
+        return fbd_droid_vibra_backend_set_amplitude_async (self->backend, req->amplitude,
+                                                            on_transaction_done, self);
+    case FBD_DROID_VIBRA_REQUEST_COMPOSE:
+        return fbd_droid_vibra_backend_compose_async (self->backend,
+                                                      (FbdDroidVibraCompositeEffect *)req->composite->data,
+                                                      req->composite->len,
+                                                      on_transaction_done, self);
+    default:
+        g_assert_not_reached ();
+    }
+}
+
+
+/* Send queued requests one at a time so they never overtake each other */
+static void
+fbd_dev_vibra_send_next (FbdDevVibra *self)
+{
+    while (!self->transaction_id && !g_queue_is_empty (&self->requests)) {
+        FbdDroidVibraRequest *req = g_queue_pop_head (&self->requests);
+
+        self->transaction_id = fbd_dev_vibra_send_request (self, req);
+        if (!self->transaction_id) {
+            g_warning ("Failed to send vibra %s request", request_names[req->type]);
+            fbd_droid_vibra_request_free (req);
+            continue;
+        }
+        self->in_flight = req;
+
+        /* Only requests that made it to the HAL count, queued ones might get dropped */
+        if (req->type == FBD_DROID_VIBRA_REQUEST_AMPLITUDE)
+            self->amplitude = req->amplitude;
+
+        if (req->type == FBD_DROID_VIBRA_REQUEST_OFF)
+            self->n_callbacks = 0;
+        else if (fbd_dev_vibra_request_reports_completion (self, req))
+            self->n_callbacks++;
+    }
+}
+
+
+/*
+ * The motor only has a single state so a new effect supersedes the
+ * requests of older ones that weren't sent yet.
+ */
+static void
+fbd_dev_vibra_drop_pending (FbdDevVibra *self)
+{
+    if (!g_queue_is_empty (&self->requests))
+        g_debug ("Dropping %u superseded vibra requests", self->requests.length);
+    g_queue_clear_full (&self->requests, (GDestroyNotify) fbd_droid_vibra_request_free);
+}
+
+
+static void
+fbd_dev_vibra_queue_request (FbdDevVibra *self, FbdDroidVibraRequest *req)
+{
+    if (req->type == FBD_DROID_VIBRA_REQUEST_OFF)
+        self->motor_idle = TRUE;
+    else if (req->type != FBD_DROID_VIBRA_REQUEST_AMPLITUDE)
+        self->motor_idle = FALSE;
+
+    g_queue_push_tail (&self->requests, req);
+    fbd_dev_vibra_send_next (self);
+}
+
+
+static void
+fbd_dev_vibra_queue_amplitude (FbdDevVibra *self, float level)
+{
+    FbdDroidVibraRequest *req;
+    float amplitude;
+
+    if (!(self->features & FBD_DROID_VIBRA_BACKEND_FEATURE_AMPLITUDE))
+        return;
+
+    /* The HAL wants (0.0, 1.0] */
+    amplitude = CLAMP (level * self->gain / 100.0, 0.01, 1.0);
+    if (amplitude == self->amplitude)
+        return;
+
+    req = fbd_droid_vibra_request_new (FBD_DROID_VIBRA_REQUEST_AMPLITUDE);
+    req->amplitude = amplitude;
+    fbd_dev_vibra_queue_request (self, req);
+}
+
+
+static void
+fbd_dev_vibra_queue_on_off (FbdDevVibra *self, guint duration)
+{
+    FbdDroidVibraRequest *req;
+
+    req = fbd_droid_vibra_request_new (duration ? FBD_DROID_VIBRA_REQUEST_ON :
+                                       FBD_DROID_VIBRA_REQUEST_OFF);
+    req->duration = duration;
+    fbd_dev_vibra_queue_request (self, req);
+}
+
+
+static FbdDroidVibraEffectStrength
+fbd_dev_vibra_get_strength (FbdDevVibra *self)
+{
+    if (self->gain <= 33)
+        return FBD_DROID_VIBRA_EFFECT_STRENGTH_LIGHT;
+    else if (self->gain <= 66)
+        return FBD_DROID_VIBRA_EFFECT_STRENGTH_MEDIUM;
+
+    return FBD_DROID_VIBRA_EFFECT_STRENGTH_STRONG;
+}
+
+
+static gboolean
+fbd_dev_vibra_check_available (FbdDevVibra *self)
+{
+    if (self->backend && fbd_droid_vibra_backend_is_available (self->backend))
+        return TRUE;
+
+    g_debug ("Vibrator hal unavailable, dropping effect");
+    fbd_dev_vibra_drop_pending (self);
+    return FALSE;
+}
+
+
+/*
+ * Turn the motor on for @duration ms at @level or off if @duration is
+ * 0. This supersedes all pending requests.
+ */
+static void
+fbd_dev_vibra_push_cmd (FbdDevVibra *self, guint duration, float level)
+{
+    FbdDevVibraCmd *cmd;
+
+    if (fbd_droid_vibra_backend_supports_async (self->backend)) {
+        /* Drop once so the amplitude and on/off requests stay together */
+        fbd_dev_vibra_drop_pending (self);
+        if (duration)
+            fbd_dev_vibra_queue_amplitude (self, level);
+        fbd_dev_vibra_queue_on_off (self, duration);
+        return;
+    }
+
+    /* Only backends that block need a thread, spawn it on first use */
+    if (self->worker == NULL)
+        self->worker = fbd_io_worker_new ("fbd-vibra-io");
+
+    cmd = g_new0 (FbdDevVibraCmd, 1);
+
+    cmd->self = g_object_ref (self);
+    cmd->duration = duration;
+    /* A newer on/off request supersedes a queued one */
+    fbd_io_worker_push (self->worker,
+                        self,
+                        fbd_dev_vibra_run_cmd,
+                        on_cmd_done,
+                        cmd,
+                        (GDestroyNotify) fbd_dev_vibra_cmd_free);
+}
+
+
+/**
+ * fbd_dev_vibra_rumble:
+ * @self: The vibra device
+ * @duration: The duration in ms
+ * @upload: Unused
+ *
+ * Play a rumble effect. Short rumbles use the HAL's prebaked tick and
+ * click effects when available as they don't need to spin up the motor.
+ *
+ * Returns: %TRUE if the effect was queued
+ */
 gboolean
 fbd_dev_vibra_rumble (FbdDevVibra *self, guint duration, gboolean upload)
 {
+    FbdDroidVibraRequest *req;
+    FbdDroidVibraEffect effect;
+
     g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), FALSE);
 
+    if (!fbd_dev_vibra_check_available (self))
+        return FALSE;
+
     g_debug("Playing rumbling vibra effect");
 
-    return fbd_droid_vibra_backend_on (self->backend, duration);
+    if (duration <= FBD_DROID_VIBRA_TICK_MAX &&
+        fbd_droid_vibra_backend_supports_effect (self->backend, FBD_DROID_VIBRA_EFFECT_TICK)) {
+        effect = FBD_DROID_VIBRA_EFFECT_TICK;
+    } else if (duration <= FBD_DROID_VIBRA_CLICK_MAX &&
+               fbd_droid_vibra_backend_supports_effect (self->backend, FBD_DROID_VIBRA_EFFECT_CLICK)) {
+        effect = FBD_DROID_VIBRA_EFFECT_CLICK;
+    } else {
+        fbd_dev_vibra_push_cmd (self, duration, 1.0);
+        return TRUE;
+    }
+
+    fbd_dev_vibra_drop_pending (self);
+    req = fbd_droid_vibra_request_new (FBD_DROID_VIBRA_REQUEST_PERFORM);
+    req->effect = effect;
+    req->strength = fbd_dev_vibra_get_strength (self);
+    fbd_dev_vibra_queue_request (self, req);
+
+    return TRUE;
 }
 
 
+/**
+ * fbd_dev_vibra_periodic:
+ * @self: The vibra device
+ * @duration: The duration in ms
+ * @magnitude: The magnitude
+ * @fade_in_level: Unused
+ * @fade_in_time: Unused
+ *
+ * Play a periodic effect. The magnitude is honored if the HAL supports
+ * amplitude control.
+ *
+ * Returns: %TRUE if the effect was queued
+ */
 gboolean
 fbd_dev_vibra_periodic (FbdDevVibra *self, guint duration, guint magnitude, guint fade_in_level, guint fade_in_time)
 {
     g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), FALSE);
 
+    if (!fbd_dev_vibra_check_available (self))
+        return FALSE;
+
     g_debug("Playing periodic vibra effect");
 
-    return fbd_droid_vibra_backend_on (self->backend, duration);
+    fbd_dev_vibra_push_cmd (self, duration, (magnitude ?: 0x7FFF) / (float) 0x7FFF);
+    return TRUE;
+}
+
+
+/**
+ * fbd_dev_vibra_pulse_train:
+ * @self: The vibra device
+ * @count: The number of pulses
+ * @length: The length of a pulse in ms
+ * @pause: The pause between pulses in ms
+ *
+ * Play a train of short pulses as a single composition of click
+ * primitives if the HAL supports that.
+ *
+ * Returns: %TRUE if the pulses were queued, %FALSE if the caller
+ *  needs to play them one by one
+ */
+gboolean
+fbd_dev_vibra_pulse_train (FbdDevVibra *self, guint count, guint length, guint pause)
+{
+    FbdDroidVibraRequest *req;
+    GArray *composite;
+
+    g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), FALSE);
+
+    if (length > FBD_DROID_VIBRA_CLICK_MAX || !fbd_dev_vibra_check_available (self))
+        return FALSE;
+
+    composite = g_array_sized_new (FALSE, TRUE, sizeof (FbdDroidVibraCompositeEffect), count);
+    for (guint i = 0; i < count; i++) {
+        FbdDroidVibraCompositeEffect step = {
+            .delay = i ? pause : 0,
+            .primitive = FBD_DROID_VIBRA_PRIMITIVE_CLICK,
+            .scale = self->gain / 100.0,
+        };
+        g_array_append_val (composite, step);
+    }
+
+    if (!fbd_droid_vibra_backend_can_compose (self->backend,
+                                              (FbdDroidVibraCompositeEffect *)composite->data,
+                                              composite->len)) {
+        g_array_unref (composite);
+        return FALSE;
+    }
+
+    g_debug ("Playing %u pulses as composition", count);
+    fbd_dev_vibra_drop_pending (self);
+    req = fbd_droid_vibra_request_new (FBD_DROID_VIBRA_REQUEST_COMPOSE);
+    req->composite = composite;
+    fbd_dev_vibra_queue_request (self, req);
+
+    return TRUE;
 }
 
 
@@ -234,9 +1069,20 @@ fbd_dev_vibra_remove_effect (FbdDevVibra *self)
 {
     g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), FALSE);
 
+    /* The motor stopped along with the HAL */
+    if (!fbd_dev_vibra_check_available (self))
+        return TRUE;
+
+    /* The HAL reported completion already, spare the transaction */
+    if (fbd_droid_vibra_backend_supports_async (self->backend) && self->motor_idle) {
+        g_debug ("Vibra motor idle, not turning it off");
+        return TRUE;
+    }
+
     g_debug("Erasing vibra effect");
 
-    return fbd_droid_vibra_backend_off (self->backend);
+    fbd_dev_vibra_push_cmd (self, 0, 0.0);
+    return TRUE;
 }
 
 
@@ -256,3 +1102,131 @@ fbd_dev_vibra_get_device(FbdDevVibra *self)
 
     return self->device;
 }
+
+
+/**
+ * fbd_dev_vibra_get_features:
+ * @self: The vibra device
+ *
+ * Get the features supported by the device. The HAL emulates both rumble
+ * and periodic effects by turning on the motor. The gain is supported if
+ * the HAL has amplitude control.
+ *
+ * Returns: The features
+ */
+FbdDevVibraFeatureFlags
+fbd_dev_vibra_get_features (FbdDevVibra *self)
+{
+    FbdDevVibraFeatureFlags features = FBD_DEV_VIBRA_FEATURE_RUMBLE | FBD_DEV_VIBRA_FEATURE_PERIODIC;
+
+    g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), FBD_DEV_VIBRA_FEATURE_NONE);
+
+    if (self->features & FBD_DROID_VIBRA_BACKEND_FEATURE_AMPLITUDE)
+        features |= FBD_DEV_VIBRA_FEATURE_GAIN;
+
+    return features;
+}
+
+
+/**
+ * fbd_dev_vibra_set_gain:
+ * @self: The vibra device
+ * @gain: The gain in percent
+ *
+ * The HAL has no master gain. The value scales the amplitude, strength
+ * and composition scale of subsequent effects instead.
+ *
+ * Returns: %TRUE if the HAL has amplitude control
+ */
+gboolean
+fbd_dev_vibra_set_gain (FbdDevVibra *self, guint gain)
+{
+    g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), FALSE);
+    g_return_val_if_fail (gain <= 100, FALSE);
+
+    self->gain = gain;
+
+    return !!(self->features & FBD_DROID_VIBRA_BACKEND_FEATURE_AMPLITUDE);
+}
+
+
+/**
+ * fbd_dev_vibra_reports_completion:
+ * @self: The vibra device
+ *
+ * Whether the device emits #FbdDevVibra::effect-ended when effects
+ * stop playing.
+ *
+ * Returns: %TRUE if the HAL invokes the callback when turning the
+ *   motor on and, if short rumbles use prebaked effects, when
+ *   performing those
+ */
+gboolean
+fbd_dev_vibra_reports_completion (FbdDevVibra *self)
+{
+    FbdDroidVibraBackendFeatures needed = FBD_DROID_VIBRA_BACKEND_FEATURE_ON_CALLBACK;
+
+    g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), FALSE);
+
+    /* Still waiting for the HAL */
+    if (self->backend == NULL)
+        return FALSE;
+
+    /* Short rumbles are performed as ticks and clicks, see fbd_dev_vibra_rumble() */
+    if (fbd_droid_vibra_backend_supports_effect (self->backend, FBD_DROID_VIBRA_EFFECT_TICK) ||
+        fbd_droid_vibra_backend_supports_effect (self->backend, FBD_DROID_VIBRA_EFFECT_CLICK))
+        needed |= FBD_DROID_VIBRA_BACKEND_FEATURE_PERFORM_CALLBACK;
+
+    return (self->features & needed) == needed;
+}
+
+/**
+ * fbd_dev_vibra_get_start_delay:
+ * @self: The vibra device
+ * @effect: The effect type
+ *
+ * Get the delay in ms after which an effect of the given type starts
+ * playing on the motor.
+ *
+ * Returns: The delay in ms, the HAL starts all effects right away
+ */
+guint
+fbd_dev_vibra_get_start_delay (FbdDevVibra *self, FbdDevVibraFeatureFlags effect)
+{
+    g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), 0);
+
+    return 0;
+}
+
+/**
+ * fbd_dev_vibra_get_completion_latency:
+ * @self: The vibra device
+ *
+ * Get how long after an effect's end the HAL might report it as
+ * completed.
+ *
+ * Returns: The latency in ms
+ */
+guint
+fbd_dev_vibra_get_completion_latency (FbdDevVibra *self)
+{
+    g_return_val_if_fail (FBD_IS_DEV_VIBRA (self), 0);
+
+    return FBD_DROID_VIBRA_COMPLETION_LATENCY;
+}
+
+/**
+ * fbd_dev_vibra_flush:
+ * @self: The vibra device
+ *
+ * Blocks until all queued commands were sent to the device. This is
+ * mostly useful for tests and benchmarks.
+ */
+void
+fbd_dev_vibra_flush (FbdDevVibra *self)
+{
+    g_return_if_fail (FBD_IS_DEV_VIBRA (self));
+
+    if (self->worker)
+        fbd_io_worker_flush (self->worker);
+}
@@ -13,14 +13,15 @@
 #include "fbd-dev-leds.h"
 #include "fbd-feedback-led.h"
 #include "fbd-feedback-manager.h"
+#include "fbd-led-pattern.h"
 
 #include <gmobile.h>
 
 /**
  * FbdFeedbackLed:
  *
- * The `FbdFeedbackLed` describes a feedback via an LED. It currently
- * only supports periodic patterns.
+ * The `FbdFeedbackLed` describes a feedback via an LED. The LED either
+ * blinks periodically or plays a pattern like a breathing effect.
  */
 
 enum {
@@ -29,6 +30,8 @@ enum {
   PROP_COLOR,
   PROP_MAX_BRIGHTNESS,
   PROP_PRIORITY,
+  PROP_PATTERN,
+  PROP_CURVE,
   PROP_LAST_PROP,
 };
 static GParamSpec *props[PROP_LAST_PROP];
@@ -40,13 +43,24 @@ typedef struct _FbdFeedbackLed {
   guint            priority;
   guint            max_brightness;
   char            *color;
-  gboolean         prefer_flash;
 
-  GSettings       *settings;
+  /* Parsed from color */
+  FbdFeedbackLedColor color_type;
+  FbdLedRgbColor      rgb;
+
+  char              *pattern_desc;
+  FbdLedPatternCurve curve;
+  FbdLedPattern     *pattern;
+
+  GSettings       *settings; /* Shared, see fbd_feedback_led_get_settings () */
 } FbdFeedbackLed;
 
 G_DEFINE_TYPE (FbdFeedbackLed, fbd_feedback_led, FBD_TYPE_FEEDBACK_BASE)
 
+/* Shared by all LED feedbacks */
+static GSettings *shared_settings;
+static gboolean   prefer_flash;
+
 /**
  * ascii_to_int:
  * @c: a character
@@ -124,7 +138,7 @@ parse_hex_color (const char *color, FbdLedRgbColor *rgb)
 
 
 static FbdFeedbackLedColor
-color_string_to_color (const char *color, gboolean prefer_flash, FbdLedRgbColor *rgb)
+color_string_to_color (const char *color, FbdLedRgbColor *rgb)
 {
   FbdFeedbackLedColor type;
 
@@ -155,21 +169,33 @@ color_string_to_color (const char *color, gboolean prefer_flash, FbdLedRgbColor
     type = FBD_FEEDBACK_LED_COLOR_WHITE;
   }
 
-  /* Override the LED color type at the very end as we want rgb filled
-   * in so it can be used in case we need to fall back to non flash
-   * LED */
-  if (prefer_flash)
-    type = FBD_FEEDBACK_LED_COLOR_FLASH;
-
   return type;
 }
 
 
 static void
-on_prefer_flash_changed (FbdFeedbackLed *self)
+on_prefer_flash_changed (GSettings *settings, const char *key, gpointer unused)
 {
-  self->prefer_flash = g_settings_get_boolean (self->settings, "prefer-flash");
-  g_debug ("Prefer flash: %d", self->prefer_flash);
+  prefer_flash = g_settings_get_boolean (settings, "prefer-flash");
+  g_debug ("Prefer flash: %d", prefer_flash);
+}
+
+/* There's a single settings object (and hence subscription) for all LED feedbacks */
+static GSettings *
+fbd_feedback_led_get_settings (void)
+{
+  if (shared_settings)
+    return g_object_ref (shared_settings);
+
+  shared_settings = g_settings_new (FEEDBACKD_SCHEMA_ID);
+  g_object_add_weak_pointer (G_OBJECT (shared_settings), (gpointer *)&shared_settings);
+  g_signal_connect (shared_settings,
+                    "changed::prefer-flash",
+                    G_CALLBACK (on_prefer_flash_changed),
+                    NULL);
+  on_prefer_flash_changed (shared_settings, "prefer-flash", NULL);
+
+  return shared_settings;
 }
 
 
@@ -194,6 +220,12 @@ fbd_feedback_led_set_property (GObject      *object,
   case PROP_COLOR:
     self->color = g_value_dup_string (value);
     break;
+  case PROP_PATTERN:
+    self->pattern_desc = g_value_dup_string (value);
+    break;
+  case PROP_CURVE:
+    self->curve = g_value_get_enum (value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
@@ -222,6 +254,12 @@ fbd_feedback_led_get_property (GObject    *object,
   case PROP_COLOR:
     g_value_set_string (value, self->color);
     break;
+  case PROP_PATTERN:
+    g_value_set_string (value, self->pattern_desc);
+    break;
+  case PROP_CURVE:
+    g_value_set_enum (value, self->curve);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
@@ -236,18 +274,21 @@ fbd_feedback_led_run (FbdFeedbackBase *base)
   FbdFeedbackManager *manager = fbd_feedback_manager_get_default ();
   FbdDevLeds *dev = fbd_feedback_manager_get_dev_leds (manager);
   FbdFeedbackLedColor color;
-  FbdLedRgbColor rgb;
 
   g_return_if_fail (FBD_IS_DEV_LEDS (dev));
-  g_debug ("Periodic led feedback: max brightness: %d, freq: %d", self->max_brightness, self->frequency);
-
-  color = color_string_to_color (self->color, self->prefer_flash, &rgb);
-  /* FIXME: handle priority */
-  fbd_dev_leds_start_periodic (dev,
-                               color,
-                               &rgb,
-                               self->max_brightness,
-                               self->frequency);
+  g_debug ("Periodic led feedback: max brightness: %d, freq: %d, priority: %d",
+           self->max_brightness, self->frequency, self->priority);
+
+  /* The RGB value is still used in case we need to fall back to a non flash LED */
+  color = prefer_flash ? FBD_FEEDBACK_LED_COLOR_FLASH : self->color_type;
+  fbd_dev_leds_claim (dev,
+                      self,
+                      self->priority,
+                      color,
+                      &self->rgb,
+                      self->max_brightness,
+                      self->frequency,
+                      self->pattern);
 }
 
 
@@ -257,11 +298,9 @@ fbd_feedback_led_end (FbdFeedbackBase *base)
   FbdFeedbackLed *self = FBD_FEEDBACK_LED (base);
   FbdFeedbackManager *manager = fbd_feedback_manager_get_default ();
   FbdDevLeds *dev = fbd_feedback_manager_get_dev_leds (manager);
-  FbdFeedbackLedColor color;
 
-  color = color_string_to_color (self->color, self->prefer_flash, NULL);
   if (dev)
-    fbd_dev_leds_stop (dev, color);
+    fbd_dev_leds_release (dev, self);
   fbd_feedback_base_done (FBD_FEEDBACK_BASE (self));
 }
 
@@ -276,7 +315,7 @@ fbd_feedback_led_is_available (FbdFeedbackBase *base)
   if (!FBD_IS_DEV_LEDS (dev))
     return FALSE;
 
-  if (self->prefer_flash &&
+  if (prefer_flash &&
       fbd_dev_leds_has_led (dev, FBD_FEEDBACK_LED_COLOR_FLASH)) {
     return TRUE;
   }
@@ -285,6 +324,37 @@ fbd_feedback_led_is_available (FbdFeedbackBase *base)
 }
 
 
+static void
+fbd_feedback_led_constructed (GObject *object)
+{
+  FbdFeedbackLed *self = FBD_FEEDBACK_LED (object);
+  g_autoptr (GError) err = NULL;
+
+  G_OBJECT_CLASS (fbd_feedback_led_parent_class)->constructed (object);
+
+  if (gm_str_is_null_or_empty (self->color)) {
+    g_warning ("No LED color given, using white");
+    self->color_type = FBD_FEEDBACK_LED_COLOR_WHITE;
+    self->rgb.r = self->rgb.g = self->rgb.b = 255;
+  } else {
+    self->color_type = color_string_to_color (self->color, &self->rgb);
+  }
+
+  if (gm_str_is_null_or_empty (self->pattern_desc))
+    return;
+
+  self->pattern = fbd_led_pattern_new_from_string (self->pattern_desc, self->curve, &err);
+  if (self->pattern == NULL) {
+    g_warning ("Failed to parse LED pattern, using periodic blinking: %s", err->message);
+    return;
+  }
+
+  /* Blink at the pattern's pace if the LED can't play it */
+  if (self->frequency == 0)
+    self->frequency = 1000 * 1000 / fbd_led_pattern_get_period (self->pattern);
+}
+
+
 static void
 fbd_feedback_led_finalize (GObject *object)
 {
@@ -292,6 +362,8 @@ fbd_feedback_led_finalize (GObject *object)
 
   g_clear_object (&self->settings);
   g_clear_pointer (&self->color, g_free);
+  g_clear_pointer (&self->pattern_desc, g_free);
+  g_clear_pointer (&self->pattern, fbd_led_pattern_unref);
 
   G_OBJECT_CLASS (fbd_feedback_led_parent_class)->finalize (object);
 }
@@ -305,6 +377,7 @@ fbd_feedback_led_class_init (FbdFeedbackLedClass *klass)
 
   object_class->set_property = fbd_feedback_led_set_property;
   object_class->get_property = fbd_feedback_led_get_property;
+  object_class->constructed = fbd_feedback_led_constructed;
   object_class->finalize = fbd_feedback_led_finalize;
 
   base_class->run = fbd_feedback_led_run;
@@ -351,6 +424,28 @@ fbd_feedback_led_class_init (FbdFeedbackLedClass *klass)
     g_param_spec_uint ("max-brightness", "", "",
                        1, 100, 100,
                        G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  /**
+   * FbdFeedbackLed:pattern:
+   *
+   * An optional pattern to play instead of blinking periodically. It's
+   * given as pairs of brightness (in percent of the max brightness)
+   * and the time (in ms) it takes to get to the next pair's
+   * brightness. E.g. `0 1000 100 1000` fades in and out in two seconds.
+   */
+  props[PROP_PATTERN] =
+    g_param_spec_string ("pattern", "", "",
+                         NULL,
+                         G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  /**
+   * FbdFeedbackLed:curve:
+   *
+   * How the brightness changes between the points of the pattern.
+   */
+  props[PROP_CURVE] =
+    g_param_spec_enum ("curve", "", "",
+                       FBD_TYPE_LED_PATTERN_CURVE,
+                       FBD_LED_PATTERN_CURVE_LINEAR,
+                       G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
   g_object_class_install_properties (object_class, PROP_LAST_PROP, props);
 }
@@ -360,12 +455,5 @@ static void
 fbd_feedback_led_init (FbdFeedbackLed *self)
 {
   self->max_brightness = 100;
-  self->settings = g_settings_new (FEEDBACKD_SCHEMA_ID);
-
-  g_signal_connect_object (self->settings,
-                           "changed::prefer-flash",
-                           G_CALLBACK (on_prefer_flash_changed),
-                           self,
-                           G_CONNECT_SWAPPED);
-  on_prefer_flash_changed (self);
+  self->settings = fbd_feedback_led_get_settings ();
 }
@@ -12,9 +12,11 @@
 #ifdef WITH_DROID_SUPPORT
 #include "fbd-droid-vibra.h"
 #include "fbd-droid-leds.h"
+#define WITH_VIBRA_HOTPLUG FALSE
 #else
 #include "fbd-dev-vibra.h"
 #include "fbd-dev-leds.h"
+#define WITH_VIBRA_HOTPLUG TRUE
 #endif
 #include "fbd-event.h"
 #include "fbd-feedback-vibra.h"
@@ -62,12 +64,34 @@ typedef struct _FbdFeedbackManager {
 
   /* Hardware interaction */
   GUdevClient             *client;
-  FbdDevVibra             *vibra;
+  GPtrArray               *vibras;
   FbdDevSound             *sound;
   FbdDevLeds              *leds;
+  /* Pending device initialization */
+  GCancellable            *cancel;
+  guint                    n_pending_devices;
+  /* Vibra devices still initializing, see FbdVibraInit */
+  GPtrArray               *vibra_inits;
+  /* Events triggered while devices were initializing */
+  GQueue                   pending_events;
 } FbdFeedbackManager;
 
+typedef struct {
+  guint                   event_id;
+  FbdFeedbackProfileLevel level;
+} FbdPendingEvent;
+
+/* A vibra device that is still initializing */
+typedef struct {
+  FbdFeedbackManager     *self;
+  char                   *sysfs_path;
+  GCancellable           *cancel;
+  /* Whether events wait for the device, only true for coldplugged ones */
+  gboolean                startup;
+} FbdVibraInit;
+
 static void fbd_feedback_manager_feedback_iface_init (LfbGdbusFeedbackIface *iface);
+static void device_ready (FbdFeedbackManager *self);
 
 G_DEFINE_TYPE_WITH_CODE (FbdFeedbackManager,
                          fbd_feedback_manager,
@@ -76,30 +100,222 @@ G_DEFINE_TYPE_WITH_CODE (FbdFeedbackManager,
                            LFB_GDBUS_TYPE_FEEDBACK,
                            fbd_feedback_manager_feedback_iface_init));
 
+static gint
+find_vibra_by_path (FbdFeedbackManager *self, const char *sysfs_path)
+{
+  for (guint i = 0; i < self->vibras->len; i++) {
+    FbdDevVibra *vibra = g_ptr_array_index (self->vibras, i);
+    GUdevDevice *dev = fbd_dev_vibra_get_device (vibra);
+
+    if (dev && g_strcmp0 (g_udev_device_get_sysfs_path (dev), sysfs_path) == 0)
+      return i;
+  }
+
+  return -1;
+}
+
+static void
+fbd_vibra_init_free (FbdVibraInit *init)
+{
+  g_free (init->sysfs_path);
+  g_object_unref (init->cancel);
+  g_free (init);
+}
+
+static FbdVibraInit *
+find_vibra_init_by_path (FbdFeedbackManager *self, const char *sysfs_path)
+{
+  for (guint i = 0; i < self->vibra_inits->len; i++) {
+    FbdVibraInit *init = g_ptr_array_index (self->vibra_inits, i);
+
+    if (g_strcmp0 (init->sysfs_path, sysfs_path) == 0)
+      return init;
+  }
+
+  return NULL;
+}
+
+/*
+ * Stop tracking a vibra device that is still initializing. The device
+ * won't be added once initialization finishes.
+ */
+static void
+cancel_vibra_init (FbdFeedbackManager *self, FbdVibraInit *init)
+{
+  gboolean startup = init->startup;
+
+  g_ptr_array_remove (self->vibra_inits, init);
+  /* Frees @init once the cancellation got processed */
+  g_cancellable_cancel (init->cancel);
+  if (startup)
+    device_ready (self);
+}
+
+/*
+ * Scale vibra strength by the master gain of the profile at @level.
+ * This is the global level unless an event plays at a lower one.
+ */
+static void
+apply_vibra_gain (FbdFeedbackManager *self, FbdFeedbackProfileLevel level)
+{
+  FbdFeedbackProfile *profile = NULL;
+  guint gain = 100;
+
+  if (self->theme) {
+    profile = fbd_feedback_theme_get_profile (self->theme,
+                                              fbd_feedback_profile_level_to_string (level));
+  }
+  if (profile)
+    gain = fbd_feedback_profile_get_vibra_gain (profile);
+
+  for (guint i = 0; i < self->vibras->len; i++) {
+    FbdDevVibra *vibra = g_ptr_array_index (self->vibras, i);
+
+    if (!fbd_dev_vibra_set_gain (vibra, gain))
+      g_debug ("Vibra device doesn't support setting the gain");
+  }
+}
+
+static void
+on_vibra_ready (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  FbdVibraInit *init = user_data;
+  FbdFeedbackManager *self;
+  gboolean startup;
+  g_autoptr (GError) err = NULL;
+  FbdDevVibra *vibra;
+  GUdevDevice *device;
+
+  vibra = fbd_dev_vibra_new_finish (res, &err);
+  /* The manager is gone or the device got removed meanwhile */
+  if (g_error_matches (err, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+    fbd_vibra_init_free (init);
+    return;
+  }
+
+  self = init->self;
+  startup = init->startup;
+  g_ptr_array_remove (self->vibra_inits, init);
+  fbd_vibra_init_free (init);
+
+  if (!vibra) {
+    if (WITH_VIBRA_HOTPLUG)
+      g_warning ("Failed to init vibra device: %s", err->message);
+    else
+      g_debug ("Failed to init droid vibra device: %s", err->message);
+    if (startup)
+      device_ready (self);
+    return;
+  }
+
+  device = fbd_dev_vibra_get_device (vibra);
+  g_debug ("Adding vibra device %s, features 0x%x",
+           device ? g_udev_device_get_sysfs_path (device) : "(HAL)",
+           fbd_dev_vibra_get_features (vibra));
+  g_ptr_array_add (self->vibras, vibra);
+  apply_vibra_gain (self, self->level);
+  if (startup)
+    device_ready (self);
+}
+
+/*
+ * Initialize a vibra device. Events are only held back for the devices
+ * found at @startup, a hotplugged device joins once it's ready.
+ */
+static void
+add_vibra (FbdFeedbackManager *self, GUdevDevice *device, gboolean startup)
+{
+  FbdVibraInit *init = g_new0 (FbdVibraInit, 1);
+
+  init->self = self;
+  init->sysfs_path = device ? g_strdup (g_udev_device_get_sysfs_path (device)) : NULL;
+  init->cancel = g_cancellable_new ();
+  init->startup = startup;
+  g_ptr_array_add (self->vibra_inits, init);
+
+  if (startup)
+    self->n_pending_devices++;
+  fbd_dev_vibra_new_async (device, init->cancel, on_vibra_ready, init);
+}
+
+static void
+on_leds_ready (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  FbdFeedbackManager *self;
+  g_autoptr (GError) err = NULL;
+  FbdDevLeds *leds;
+
+  leds = fbd_dev_leds_new_finish (res, &err);
+  if (g_error_matches (err, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return;
+
+  self = FBD_FEEDBACK_MANAGER (user_data);
+  if (!leds)
+    g_debug ("Failed to init leds device: %s", err->message);
+  else
+    g_debug ("Leds device ready");
+
+  self->leds = leds;
+  device_ready (self);
+}
+
+static void
+on_sound_ready (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  FbdFeedbackManager *self;
+  g_autoptr (GError) err = NULL;
+  FbdDevSound *sound;
+
+  sound = fbd_dev_sound_new_finish (res, &err);
+  if (g_error_matches (err, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return;
+
+  self = FBD_FEEDBACK_MANAGER (user_data);
+  if (!sound)
+    g_warning ("Failed to init sound device: %s", err->message);
+
+  self->sound = sound;
+  device_ready (self);
+}
+
 static void
 device_changes (FbdFeedbackManager *self, gchar *action, GUdevDevice *device,
                 GUdevClient        *client)
 {
-  g_debug ("Device changes: action = %s, device = %s",
-           action, g_udev_device_get_sysfs_path (device));
+  const char *path = g_udev_device_get_sysfs_path (device);
+  FbdVibraInit *init;
+  gboolean startup = FALSE;
+  gint index;
+
+  g_debug ("Device changes: action = %s, device = %s", action, path);
 
-  if (g_strcmp0 (action, "remove") == 0 && self->vibra) {
-    GUdevDevice *dev = fbd_dev_vibra_get_device (self->vibra);
+  /* The HAL handles the vibra motor, nothing to track */
+  if (!WITH_VIBRA_HOTPLUG)
+    return;
 
-    if (g_strcmp0 (g_udev_device_get_sysfs_path (dev),
-                   g_udev_device_get_sysfs_path (device)) == 0) {
-      g_debug ("Vibra device %s got removed", g_udev_device_get_sysfs_path (dev));
-      g_clear_object (&self->vibra);
+  index = find_vibra_by_path (self, path);
+  init = find_vibra_init_by_path (self, path);
+  if (g_strcmp0 (action, "remove") == 0) {
+    if (init) {
+      g_debug ("Vibra device %s got removed during initialization", path);
+      cancel_vibra_init (self, init);
+    }
+    if (index >= 0) {
+      g_debug ("Vibra device %s got removed", path);
+      g_ptr_array_remove_index (self->vibras, index);
     }
   } else if (g_strcmp0 (action, "add") == 0) {
     if (!g_strcmp0 (g_udev_device_get_property (device, FEEDBACKD_UDEV_ATTR), "vibra")) {
-      g_autoptr (GError) err = NULL;
-
-      g_debug ("Found hotplugged vibra device at %s", g_udev_device_get_sysfs_path (device));
-      g_clear_object (&self->vibra);
-      self->vibra = fbd_dev_vibra_new (device, &err);
-      if (!self->vibra)
-        g_warning ("Failed to init vibra device: %s", err->message);
+      g_debug ("Found hotplugged vibra device at %s", path);
+      if (index >= 0)
+        g_ptr_array_remove_index (self->vibras, index);
+      if (init) {
+        /* Keep holding events if the replaced device was found at startup */
+        startup = init->startup;
+        init->startup = FALSE;
+        cancel_vibra_init (self, init);
+      }
+      add_vibra (self, device, startup);
     }
   }
 }
@@ -135,52 +351,35 @@ app_get_feedback_level (const gchar *app_id)
   return fbd_feedback_profile_level (profile);
 }
 
+/* Devices get added once they finished probing so we don't block on
+ * slow HALs or sound servers. Events triggered in the meantime are
+ * queued until all devices are ready. */
 static void
 init_devices (FbdFeedbackManager *self)
 {
-  GList *l;
-  g_autolist (GUdevClient) devices = NULL;
-  g_autoptr(GError) err = NULL;
-
-  devices = g_udev_client_query_by_subsystem (self->client, "input");
 
-  #ifdef WITH_DROID_SUPPORT
-  GUdevDevice *dev = g_list_last(devices)->data; /* FIXME */
-  self->vibra = fbd_dev_vibra_new (dev, &err);
+#ifdef WITH_DROID_SUPPORT
+  /* The HAL is our only vibra device */
+  add_vibra (self, NULL, TRUE);
+#else
+  g_autolist (GUdevDevice) devices = NULL;
 
-  if (!self->vibra){
-    g_debug ("Failed to init droid vibra device: %s", err->message);
-    g_clear_error (&err);
-  }
-  #else
-  for (l = devices; l != NULL; l = l->next) {
+  devices = g_udev_client_query_by_subsystem (self->client, "input");
+  for (GList *l = devices; l != NULL; l = l->next) {
     GUdevDevice *dev = l->data;
 
     if (!g_strcmp0 (g_udev_device_get_property (dev, FEEDBACKD_UDEV_ATTR), "vibra")) {
       g_debug ("Found vibra device");
-      self->vibra = fbd_dev_vibra_new (dev, &err);
-      if (!self->vibra) {
-        g_warning ("Failed to init vibra device: %s", err->message);
-        g_clear_error (&err);
-      }
+      add_vibra (self, dev, TRUE);
     }
   }
+#endif
 
-  if (!self->vibra)
-    g_debug ("No vibra capable device found");
-  #endif
-
-  self->leds = fbd_dev_leds_new (&err);
-  if (!self->leds) {
-    g_debug ("Failed to init leds device: %s", err->message);
-    g_clear_error (&err);
-  }
+  self->n_pending_devices++;
+  fbd_dev_leds_new_async (self->cancel, on_leds_ready, self);
 
-  self->sound = fbd_dev_sound_new (&err);
-  if (!self->sound) {
-    g_warning ("Failed to init sound device: %s", err->message);
-    g_clear_error (&err);
-  }
+  self->n_pending_devices++;
+  fbd_dev_sound_new_async (self->cancel, on_sound_ready, self);
 }
 
 static void
@@ -300,7 +499,8 @@ on_client_vanished (GDBusConnection *connection,
              fbd_event_get_event (event),
              fbd_event_get_id (event),
              name);
-    fbd_event_end_feedbacks (event);
+    if (!end_pending_event (self, event, FBD_EVENT_END_REASON_EXPLICIT))
+      fbd_event_end_feedbacks (event);
   }
 
   g_hash_table_remove (self->clients, name);
@@ -368,6 +568,99 @@ parse_hints (GVariant *hints, FbdFeedbackProfileLevel *level, gboolean *hint_imp
   return TRUE;
 }
 
+/*
+ * Looks up the feedbacks for @event and runs them. If there's nothing
+ * to run the event ends right away and %FALSE is returned.
+ */
+static gboolean
+start_event (FbdFeedbackManager *self, FbdEvent *event, FbdFeedbackProfileLevel level)
+{
+  GSList *feedbacks;
+  guint event_id = fbd_event_get_id (event);
+  gboolean found_fb = FALSE;
+  gboolean found_vibra = FALSE;
+
+  feedbacks = fbd_feedback_theme_lookup_feedback (self->theme, level, event);
+  for (GSList *l = feedbacks; l; l = l->next) {
+    FbdFeedbackBase *fb = FBD_FEEDBACK_BASE (l->data);
+
+    if (fbd_feedback_is_available (FBD_FEEDBACK_BASE (fb))) {
+      fbd_event_add_feedback (event, fb);
+      found_fb = TRUE;
+      found_vibra |= FBD_IS_FEEDBACK_VIBRA (fb);
+    }
+  }
+  g_slist_free_full (feedbacks, g_object_unref);
+
+  if (!found_fb) {
+    g_hash_table_remove (self->events, GUINT_TO_POINTER (event_id));
+    lfb_gdbus_feedback_emit_feedback_ended (LFB_GDBUS_FEEDBACK (self), event_id,
+                                            FBD_EVENT_END_REASON_NOT_FOUND);
+    return FALSE;
+  }
+
+  g_signal_connect_object (event, "feedbacks-ended",
+                           (GCallback) on_event_feedbacks_ended,
+                           self,
+                           G_CONNECT_SWAPPED);
+  /* The app or a hint can lower the level, play at that profile's strength */
+  if (found_vibra)
+    apply_vibra_gain (self, level);
+  fbd_event_run_feedbacks (event);
+  return TRUE;
+}
+
+/* All devices are ready, run what got triggered in the meantime */
+static void
+start_pending_events (FbdFeedbackManager *self)
+{
+  FbdPendingEvent *pending;
+
+  while ((pending = g_queue_pop_head (&self->pending_events))) {
+    FbdEvent *event = g_hash_table_lookup (self->events, GUINT_TO_POINTER (pending->event_id));
+
+    g_debug ("Starting queued event %d", pending->event_id);
+    if (event)
+      start_event (self, event, pending->level);
+    g_free (pending);
+  }
+}
+
+static void
+device_ready (FbdFeedbackManager *self)
+{
+  g_return_if_fail (self->n_pending_devices > 0);
+
+  self->n_pending_devices--;
+  if (self->n_pending_devices == 0)
+    start_pending_events (self);
+}
+
+/*
+ * Ends @event if it's still waiting for devices to get ready.
+ * Returns %TRUE if the event was pending.
+ */
+static gboolean
+end_pending_event (FbdFeedbackManager *self, FbdEvent *event, FbdEventEndReason reason)
+{
+  guint event_id = fbd_event_get_id (event);
+
+  for (GList *l = self->pending_events.head; l; l = l->next) {
+    FbdPendingEvent *pending = l->data;
+
+    if (pending->event_id != event_id)
+      continue;
+
+    g_free (pending);
+    g_queue_delete_link (&self->pending_events, l);
+    g_hash_table_remove (self->events, GUINT_TO_POINTER (event_id));
+    lfb_gdbus_feedback_emit_feedback_ended (LFB_GDBUS_FEEDBACK (self), event_id, reason);
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
 static gboolean
 fbd_feedback_manager_handle_trigger_feedback (LfbGdbusFeedback      *object,
                                               GDBusMethodInvocation *invocation,
@@ -378,11 +671,9 @@ fbd_feedback_manager_handle_trigger_feedback (LfbGdbusFeedback      *object,
 {
   FbdFeedbackManager *self;
   FbdEvent *event;
-  GSList *feedbacks, *l;
   guint event_id;
   const gchar *sender;
   FbdFeedbackProfileLevel app_level, level, hint_level = FBD_FEEDBACK_PROFILE_LEVEL_FULL;
-  gboolean found_fb = FALSE;
   gboolean hint_important = FALSE, can_important;
 
   sender = g_dbus_method_invocation_get_sender (invocation);
@@ -430,37 +721,22 @@ fbd_feedback_manager_handle_trigger_feedback (LfbGdbusFeedback      *object,
   else
     level = get_max_level (self->level, app_level, hint_level);
 
-  feedbacks = fbd_feedback_theme_lookup_feedback (self->theme, level, event);
-  if (feedbacks) {
-    for (l = feedbacks; l; l = l->next) {
-      FbdFeedbackBase *fb = FBD_FEEDBACK_BASE (l->data);
-
-      if (fbd_feedback_is_available (FBD_FEEDBACK_BASE (fb))) {
-        fbd_event_add_feedback (event, fb);
-        found_fb = TRUE;
-      }
-    }
-    g_slist_free_full (feedbacks, g_object_unref);
-  } else {
-    /* No feedbacks found at all */
-    found_fb = FALSE;
-  }
-
   lfb_gdbus_feedback_complete_trigger_feedback (object, invocation, event_id);
 
-  if (found_fb) {
-    g_signal_connect_object (event, "feedbacks-ended",
-                             (GCallback) on_event_feedbacks_ended,
-                             self,
-                             G_CONNECT_SWAPPED);
-    fbd_event_run_feedbacks (event);
+  if (self->n_pending_devices) {
+    FbdPendingEvent *pending = g_new0 (FbdPendingEvent, 1);
+
+    g_debug ("Devices not ready yet, queuing event %d", event_id);
+    pending->event_id = event_id;
+    pending->level = level;
+    g_queue_push_tail (&self->pending_events, pending);
     watch_client (self, invocation);
-  } else {
-    g_hash_table_remove (self->events, GUINT_TO_POINTER (event_id));
-    lfb_gdbus_feedback_emit_feedback_ended (LFB_GDBUS_FEEDBACK (self), event_id,
-                                            FBD_EVENT_END_REASON_NOT_FOUND);
+    return TRUE;
   }
 
+  if (start_event (self, event, level))
+    watch_client (self, invocation);
+
   return TRUE;
 }
 
@@ -483,7 +759,8 @@ fbd_feedback_manager_handle_end_feedback (LfbGdbusFeedback      *object,
   if (event) {
     /* The last feedback ending will trigger event disposal via
        `on_fb_ended` */
-    fbd_event_end_feedbacks (event);
+    if (!end_pending_event (self, event, FBD_EVENT_END_REASON_EXPLICIT))
+      fbd_event_end_feedbacks (event);
   } else {
     g_warning ("Tried to end non-existing event %d", event_id);
   }
@@ -520,10 +797,22 @@ fbd_feedback_manager_dispose (GObject *object)
 {
   FbdFeedbackManager *self = FBD_FEEDBACK_MANAGER (object);
 
+  g_cancellable_cancel (self->cancel);
+  g_clear_object (&self->cancel);
+  if (self->vibra_inits) {
+    /* Pending inits free themselves once cancelled */
+    for (guint i = 0; i < self->vibra_inits->len; i++) {
+      FbdVibraInit *init = g_ptr_array_index (self->vibra_inits, i);
+
+      g_cancellable_cancel (init->cancel);
+    }
+    g_clear_pointer (&self->vibra_inits, g_ptr_array_unref);
+  }
+  g_queue_clear_full (&self->pending_events, g_free);
   g_clear_object (&self->settings);
   g_clear_object (&self->theme);
   g_clear_object (&self->sound);
-  g_clear_object (&self->vibra);
+  g_clear_pointer (&self->vibras, g_ptr_array_unref);
   g_clear_object (&self->leds);
   g_clear_object (&self->client);
 
@@ -558,6 +847,10 @@ fbd_feedback_manager_init (FbdFeedbackManager *self)
   self->next_id = 1;
   self->level = FBD_FEEDBACK_PROFILE_LEVEL_UNKNOWN;
 
+  self->cancel = g_cancellable_new ();
+  g_queue_init (&self->pending_events);
+  self->vibras = g_ptr_array_new_with_free_func (g_object_unref);
+  self->vibra_inits = g_ptr_array_new ();
   self->client = g_udev_client_new (subsystems);
   g_signal_connect_swapped (G_OBJECT (self->client), "uevent",
                             G_CALLBACK (device_changes), self);
@@ -585,12 +878,44 @@ fbd_feedback_manager_get_default (void)
   return instance;
 }
 
+/**
+ * fbd_feedback_manager_get_dev_vibra:
+ * @self: The feedback manager
+ * @features: The features the device must support
+ *
+ * Find a vibra device suitable to play an effect. Devices supporting
+ * @features natively are preferred over ones synthesizing periodic
+ * effects, otherwise devices are tried in the order they were discovered.
+ *
+ * Returns: (transfer none) (nullable): A vibra device supporting all of
+ *   @features or %NULL if there's none.
+ */
 FbdDevVibra *
-fbd_feedback_manager_get_dev_vibra (FbdFeedbackManager *self)
+fbd_feedback_manager_get_dev_vibra (FbdFeedbackManager      *self,
+                                    FbdDevVibraFeatureFlags  features)
 {
+  FbdDevVibra *fallback = NULL;
+
   g_return_val_if_fail (FBD_IS_FEEDBACK_MANAGER (self), NULL);
 
-  return self->vibra;
+  for (guint i = 0; i < self->vibras->len; i++) {
+    FbdDevVibra *vibra = g_ptr_array_index (self->vibras, i);
+    FbdDevVibraFeatureFlags supported = fbd_dev_vibra_get_features (vibra);
+
+    if ((supported & features) != features)
+      continue;
+
+    if ((features & FBD_DEV_VIBRA_FEATURE_PERIODIC) &&
+        (supported & FBD_DEV_VIBRA_FEATURE_SYNTHESIZED)) {
+      if (!fallback)
+        fallback = vibra;
+      continue;
+    }
+
+    return vibra;
+  }
+
+  return fallback;
 }
 
 FbdDevSound *
@@ -633,6 +958,7 @@ fbd_feedback_manager_load_theme (FbdFeedbackManager *self)
   theme = fbd_theme_expander_load_theme_files (expander, &err);
   if (theme) {
     g_set_object(&self->theme, theme);
+    apply_vibra_gain (self, self->level);
   } else {
     if (self->theme)
       g_warning ("Failed to reload theme: %s", err->message);
@@ -676,6 +1002,7 @@ fbd_feedback_manager_set_profile (FbdFeedbackManager *self, const gchar *profile
   g_settings_set_string (self->settings, FEEDBACKD_KEY_PROFILE, profile);
 
   cancel_running (self);
+  apply_vibra_gain (self, self->level);
 
   return TRUE;
 }
@@ -24,7 +24,8 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE (FbdFeedbackManager, fbd_feedback_manager, FBD, FEEDBACK_MANAGER, LfbGdbusFeedbackSkeleton);
 
 FbdFeedbackManager *fbd_feedback_manager_get_default (void);
-FbdDevVibra *fbd_feedback_manager_get_dev_vibra (FbdFeedbackManager *self);
+FbdDevVibra *fbd_feedback_manager_get_dev_vibra (FbdFeedbackManager      *self,
+                                                 FbdDevVibraFeatureFlags  features);
 FbdDevSound *fbd_feedback_manager_get_dev_sound (FbdFeedbackManager *self);
 FbdDevLeds  *fbd_feedback_manager_get_dev_leds  (FbdFeedbackManager *self);
 void         fbd_feedback_manager_load_theme    (FbdFeedbackManager *self);
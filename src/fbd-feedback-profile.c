@@ -21,6 +21,7 @@ enum {
   PROP_0,
   PROP_NAME,
   PROP_FEEDBACKS,
+  PROP_VIBRA_GAIN,
   PROP_LAST_PROP,
 };
 static GParamSpec *props[PROP_LAST_PROP];
@@ -29,6 +30,10 @@ static GParamSpec *props[PROP_LAST_PROP];
  * SECTION:fbd-feedback-profile
  * @short_description: A profile in a #FbdFeedbackTheme
  * @Title: FbdFeedbackProfile
+ *
+ * Besides the feedbacks a profile can specify the strength of
+ * haptic feedback as a gain factor so the same vibra effects
+ * can be used with different strength in different profiles.
  */
 
 typedef struct _FbdFeedbackProfile {
@@ -36,6 +41,7 @@ typedef struct _FbdFeedbackProfile {
 
   gchar *name;
   GHashTable *feedbacks; /* key: event name, value: feedback */
+  guint vibra_gain;      /* in percent, 0: not set */
 } FbdFeedbackProfile;
 
 static void json_serializable_iface_init (JsonSerializableIface *iface);
@@ -167,6 +173,9 @@ fbd_feedback_profile_set_property (GObject        *object,
       g_hash_table_unref (self->feedbacks);
     self->feedbacks = g_value_get_boxed (value);
     break;
+  case PROP_VIBRA_GAIN:
+    self->vibra_gain = g_value_get_uint (value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
@@ -189,6 +198,9 @@ fbd_feedback_profile_get_property (GObject  *object,
   case PROP_FEEDBACKS:
     g_value_set_boxed (value, self->feedbacks);
     break;
+  case PROP_VIBRA_GAIN:
+    g_value_set_uint (value, self->vibra_gain);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
@@ -268,6 +280,21 @@ fbd_feedback_profile_class_init (FbdFeedbackProfileClass *klass)
       /* Can't be CONSTRUCT_ONLY since json-glib can't handle it */
       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+  /**
+   * FbdFeedbackProfile:vibra-gain:
+   *
+   * The gain (in percent) to apply to all haptic feedback while this
+   * profile is the active one. `0` means the profile doesn't set a
+   * gain (which is equivalent to `100`).
+   */
+  props[PROP_VIBRA_GAIN] =
+    g_param_spec_uint (
+      "vibra-gain",
+      "Vibra gain",
+      "The gain for haptic feedback in percent",
+      0, 100, 0,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (object_class, PROP_LAST_PROP, props);
 }
 
@@ -310,6 +337,22 @@ fbd_feedback_profile_get_feedback (FbdFeedbackProfile *self, const char *event_n
   return g_hash_table_lookup (self->feedbacks, event_name);
 }
 
+/**
+ * fbd_feedback_profile_get_vibra_gain:
+ * @self: The profile
+ *
+ * Get the gain for haptic feedback when this profile is active.
+ *
+ * Returns: The gain in percent
+ */
+guint
+fbd_feedback_profile_get_vibra_gain (FbdFeedbackProfile *self)
+{
+  g_return_val_if_fail (FBD_IS_FEEDBACK_PROFILE (self), 100);
+
+  return self->vibra_gain ?: 100;
+}
+
 FbdFeedbackProfileLevel
 fbd_feedback_profile_level (const char *name)
 {
@@ -349,7 +392,7 @@ fbd_feedback_profile_level_to_string (FbdFeedbackProfileLevel level)
  *
  * Updates a profile. Feedbacks are read from the `new` profile. If
  * feedback already exists in `self` it is overwritten with the feedback
- * from `new`.
+ * from `new`. The vibra gain is taken from `new` if it sets one.
  *
  * It is not allowed to update a profile with a profile of a different name.
  */
@@ -370,4 +413,7 @@ fbd_feedback_profile_update (FbdFeedbackProfile *self, FbdFeedbackProfile *new)
   while (g_hash_table_iter_next (&iter, (gpointer)&event_name, (gpointer)&fb)) {
     g_hash_table_insert (self->feedbacks, g_strdup (event_name), g_object_ref (fb));
   }
+
+  if (new->vibra_gain)
+    self->vibra_gain = new->vibra_gain;
 }
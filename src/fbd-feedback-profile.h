@@ -31,6 +31,7 @@ void                     fbd_feedback_profile_add_feedback (FbdFeedbackProfile *
                                                             FbdFeedbackBase *feedback);
 FbdFeedbackBase         *fbd_feedback_profile_get_feedback (FbdFeedbackProfile *self,
 							    const char *event_name);
+guint                    fbd_feedback_profile_get_vibra_gain (FbdFeedbackProfile *self);
 FbdFeedbackProfileLevel  fbd_feedback_profile_level (const char *name);
 const char*              fbd_feedback_profile_level_to_string (FbdFeedbackProfileLevel level);
 
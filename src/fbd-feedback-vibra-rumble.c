@@ -86,16 +86,17 @@ fbd_feedback_vibra_rumble_get_property (GObject  *object,
 static gboolean
 on_period_ended (FbdFeedbackVibraRumble *self)
 {
-  FbdFeedbackManager *manager = fbd_feedback_manager_get_default ();
-  FbdDevVibra *dev = fbd_feedback_manager_get_dev_vibra (manager);
+  FbdDevVibra *dev;
 
   g_return_val_if_fail (FBD_IS_FEEDBACK_VIBRA_RUMBLE (self), G_SOURCE_REMOVE);
+  dev = fbd_feedback_vibra_get_device (FBD_FEEDBACK_VIBRA (self));
 
-  if (self->periods) {
+  if (self->periods && dev) {
     fbd_dev_vibra_rumble (dev, self->rumble, FALSE);
     self->periods--;
     return G_SOURCE_CONTINUE;
   }
+  self->timer_id = 0;
   return G_SOURCE_REMOVE;
 }
 
@@ -103,19 +104,30 @@ static void
 fbd_feedback_vibra_rumble_end_vibra (FbdFeedbackVibra *vibra)
 {
   FbdFeedbackVibraRumble *self = FBD_FEEDBACK_VIBRA_RUMBLE (vibra);
-  FbdFeedbackManager *manager = fbd_feedback_manager_get_default ();
-  FbdDevVibra *dev = fbd_feedback_manager_get_dev_vibra (manager);
+  FbdDevVibra *dev = fbd_feedback_vibra_get_device (vibra);
 
   fbd_dev_vibra_stop (dev);
   g_clear_handle_id(&self->timer_id, g_source_remove);
 }
 
+static gboolean
+fbd_feedback_vibra_rumble_effect_ended (FbdFeedbackVibra *vibra)
+{
+  FbdFeedbackVibraRumble *self = FBD_FEEDBACK_VIBRA_RUMBLE (vibra);
+
+  /* Only the last rumble ends the feedback */
+  if (self->periods)
+    return FALSE;
+
+  g_clear_handle_id (&self->timer_id, g_source_remove);
+  return TRUE;
+}
+
 static void
 fbd_feedback_vibra_rumble_start_vibra (FbdFeedbackVibra *vibra)
 {
   FbdFeedbackVibraRumble *self = FBD_FEEDBACK_VIBRA_RUMBLE (vibra);
-  FbdFeedbackManager *manager = fbd_feedback_manager_get_default ();
-  FbdDevVibra *dev = fbd_feedback_manager_get_dev_vibra (manager);
+  FbdDevVibra *dev = fbd_feedback_vibra_get_device (vibra);
   guint duration = fbd_feedback_vibra_get_duration (vibra);
   guint period;
 
@@ -130,6 +142,13 @@ fbd_feedback_vibra_rumble_start_vibra (FbdFeedbackVibra *vibra)
 
   g_debug ("Rumble Vibra event: duration %d, rumble: %d, pause: %d, period: %d",
 	   duration, self->rumble, self->pause, period);
+
+  /* Let the device play all rumbles at once if it can */
+  if (self->count > 1 && fbd_dev_vibra_pulse_train (dev, self->count, self->rumble, self->pause)) {
+    self->periods = 0;
+    return;
+  }
+
   fbd_dev_vibra_rumble (dev, self->rumble, TRUE);
   self->periods--;
   if (self->periods) {
@@ -137,29 +156,19 @@ fbd_feedback_vibra_rumble_start_vibra (FbdFeedbackVibra *vibra)
   }
 }
 
-static gboolean
-fbd_feedback_vibra_rumble_is_available (FbdFeedbackBase *base)
-{
-  FbdFeedbackManager *manager = fbd_feedback_manager_get_default ();
-  FbdDevVibra *dev = fbd_feedback_manager_get_dev_vibra (manager);
-
-  return FBD_IS_DEV_VIBRA (dev);
-}
-
 static void
 fbd_feedback_vibra_rumble_class_init (FbdFeedbackVibraRumbleClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
-  FbdFeedbackBaseClass *base_class = FBD_FEEDBACK_BASE_CLASS (klass);
   FbdFeedbackVibraClass *vibra_class = FBD_FEEDBACK_VIBRA_CLASS (klass);
 
   object_class->set_property = fbd_feedback_vibra_rumble_set_property;
   object_class->get_property = fbd_feedback_vibra_rumble_get_property;
 
-  base_class->is_available = fbd_feedback_vibra_rumble_is_available;
-
+  vibra_class->features = FBD_DEV_VIBRA_FEATURE_RUMBLE;
   vibra_class->start_vibra = fbd_feedback_vibra_rumble_start_vibra;
   vibra_class->end_vibra = fbd_feedback_vibra_rumble_end_vibra;
+  vibra_class->effect_ended = fbd_feedback_vibra_rumble_effect_ended;
 
   props[PROP_COUNT] =
     g_param_spec_uint (
@@ -17,7 +17,15 @@
  *
  * The #FbdVibraVibra describes the properties of a haptic feedback
  * event. It knows nothing about the hardware itself but calls
- * #FbdDevVibra for that.
+ * #FbdDevVibra for that. When run it picks the first vibra device
+ * that supports the feedback's effect natively and sticks with it
+ * until the feedback ends.
+ *
+ * If the device reports when effects end the feedback completes on
+ * that. Otherwise (and as a fallback) a timer based on the feedback's
+ * duration and the device's start delay is used. Devices reporting
+ * completion get their completion latency on top before the timer
+ * gives up on them.
  */
 
 enum {
@@ -30,34 +38,86 @@ static GParamSpec *props[PROP_LAST_PROP];
 typedef struct _FbdFeedbackVibraPrivate {
   guint duration;
   guint timer_id;
+
+  FbdDevVibra *dev;
 } FbdFeedbackVibraPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (FbdFeedbackVibra, fbd_feedback_vibra, FBD_TYPE_FEEDBACK_BASE);
 
 
+static void
+clear_dev (FbdFeedbackVibra *self)
+{
+  FbdFeedbackVibraPrivate *priv = fbd_feedback_vibra_get_instance_private (self);
+
+  if (priv->dev)
+    g_signal_handlers_disconnect_by_data (priv->dev, self);
+  g_clear_object (&priv->dev);
+}
+
+
 static gboolean
 on_timeout_expired (FbdFeedbackVibra *self)
 {
-  FbdFeedbackManager *manager = fbd_feedback_manager_get_default ();
-  FbdDevVibra *dev = fbd_feedback_manager_get_dev_vibra (manager);
+  FbdFeedbackVibraPrivate *priv = fbd_feedback_vibra_get_instance_private (self);
 
-  fbd_dev_vibra_remove_effect (dev);
+  priv->timer_id = 0;
+  if (priv->dev)
+    fbd_dev_vibra_remove_effect (priv->dev);
+  clear_dev (self);
   fbd_feedback_base_done (FBD_FEEDBACK_BASE(self));
   return G_SOURCE_REMOVE;
 }
 
+
+static void
+on_effect_ended (FbdFeedbackVibra *self)
+{
+  FbdFeedbackVibraPrivate *priv = fbd_feedback_vibra_get_instance_private (self);
+  FbdFeedbackVibraClass *klass = FBD_FEEDBACK_VIBRA_GET_CLASS (self);
+
+  if (!priv->timer_id)
+    return;
+
+  /* More effects to come */
+  if (klass->effect_ended && !klass->effect_ended (self))
+    return;
+
+  g_debug ("Vibra feedback ended");
+  g_clear_handle_id (&priv->timer_id, g_source_remove);
+  clear_dev (self);
+  fbd_feedback_base_done (FBD_FEEDBACK_BASE(self));
+}
+
 static void
 fbd_feedback_vibra_run (FbdFeedbackBase *base)
 {
   FbdFeedbackVibra *self = FBD_FEEDBACK_VIBRA (base);
   FbdFeedbackVibraPrivate *priv = fbd_feedback_vibra_get_instance_private (self);
+  FbdFeedbackManager *manager = fbd_feedback_manager_get_default ();
   FbdFeedbackVibraClass *klass;
+  guint timeout = priv->duration;
 
   klass = FBD_FEEDBACK_VIBRA_GET_CLASS (self);
   g_return_if_fail (klass->start_vibra);
-  klass->start_vibra (self);
 
-  priv->timer_id = g_timeout_add (priv->duration,
+  g_set_object (&priv->dev, fbd_feedback_manager_get_dev_vibra (manager, klass->features));
+  /* The device might have vanished, keep the timing nevertheless */
+  if (priv->dev) {
+    timeout += fbd_dev_vibra_get_start_delay (priv->dev, klass->features);
+    if (fbd_dev_vibra_reports_completion (priv->dev)) {
+      g_signal_connect_object (priv->dev, "effect-ended",
+                               G_CALLBACK (on_effect_ended),
+                               self,
+                               G_CONNECT_SWAPPED);
+      timeout += fbd_dev_vibra_get_completion_latency (priv->dev);
+    }
+    klass->start_vibra (self);
+  } else {
+    g_debug ("No vibra device for feedback, features 0x%x", klass->features);
+  }
+
+  priv->timer_id = g_timeout_add (timeout,
 				  (GSourceFunc)on_timeout_expired,
 				  self);
   g_source_set_name_by_id (priv->timer_id, "feedback-vibra-timer");
@@ -75,12 +135,24 @@ fbd_feedback_vibra_end (FbdFeedbackBase *base)
     return;
 
   g_return_if_fail (klass->end_vibra);
-  klass->end_vibra(self);
+  if (priv->dev)
+    klass->end_vibra(self);
   g_clear_handle_id(&priv->timer_id, g_source_remove);
+  clear_dev (self);
   fbd_feedback_base_done (FBD_FEEDBACK_BASE(self));
 }
 
 
+static gboolean
+fbd_feedback_vibra_is_available (FbdFeedbackBase *base)
+{
+  FbdFeedbackManager *manager = fbd_feedback_manager_get_default ();
+  FbdFeedbackVibraClass *klass = FBD_FEEDBACK_VIBRA_GET_CLASS (base);
+
+  return !!fbd_feedback_manager_get_dev_vibra (manager, klass->features);
+}
+
+
 static void
 fbd_feedback_vibra_set_property (GObject      *object,
                                 guint         property_id,
@@ -119,6 +191,17 @@ fbd_feedback_vibra_get_property (GObject    *object,
   }
 }
 
+static void
+fbd_feedback_vibra_dispose (GObject *object)
+{
+  FbdFeedbackVibra *self = FBD_FEEDBACK_VIBRA (object);
+
+  G_OBJECT_CLASS (fbd_feedback_vibra_parent_class)->dispose (object);
+
+  /* Parent's dispose ends a running feedback, so drop the device afterwards */
+  clear_dev (self);
+}
+
 static void
 fbd_feedback_vibra_class_init (FbdFeedbackVibraClass *klass)
 {
@@ -127,9 +210,11 @@ fbd_feedback_vibra_class_init (FbdFeedbackVibraClass *klass)
 
   object_class->set_property = fbd_feedback_vibra_set_property;
   object_class->get_property = fbd_feedback_vibra_get_property;
+  object_class->dispose = fbd_feedback_vibra_dispose;
 
   base_class->run = fbd_feedback_vibra_run;
   base_class->end = fbd_feedback_vibra_end;
+  base_class->is_available = fbd_feedback_vibra_is_available;
 
   props[PROP_DURATION] =
     g_param_spec_uint (
@@ -156,3 +241,21 @@ fbd_feedback_vibra_get_duration (FbdFeedbackVibra *self)
   priv = fbd_feedback_vibra_get_instance_private (self);
   return priv->duration;
 }
+
+/**
+ * fbd_feedback_vibra_get_device:
+ * @self: The vibra feedback
+ *
+ * Get the device the currently running feedback plays on.
+ *
+ * Returns: (transfer none) (nullable): The vibra device
+ */
+FbdDevVibra *
+fbd_feedback_vibra_get_device (FbdFeedbackVibra *self)
+{
+  FbdFeedbackVibraPrivate *priv;
+
+  g_return_val_if_fail (FBD_IS_FEEDBACK_VIBRA (self), NULL);
+  priv = fbd_feedback_vibra_get_instance_private (self);
+  return priv->dev;
+}
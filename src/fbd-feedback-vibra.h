@@ -15,14 +15,22 @@ G_BEGIN_DECLS
 
 G_DECLARE_DERIVABLE_TYPE (FbdFeedbackVibra, fbd_feedback_vibra, FBD, FEEDBACK_VIBRA, FbdFeedbackBase);
 
+typedef struct _FbdDevVibra FbdDevVibra;
+
 struct _FbdFeedbackVibraClass
 {
   FbdFeedbackBaseClass parent_class;
 
+  /* The FbdDevVibraFeatureFlags a device needs to play the feedback natively */
+  guint features;
+
   void (*start_vibra) (FbdFeedbackVibra *self);
   void (*end_vibra) (FbdFeedbackVibra *self);
+  /* Device reported an effect ended, return %TRUE if the feedback is done */
+  gboolean (*effect_ended) (FbdFeedbackVibra *self);
 };
 
-guint fbd_feedback_vibra_get_duration (FbdFeedbackVibra *self);
+guint        fbd_feedback_vibra_get_duration (FbdFeedbackVibra *self);
+FbdDevVibra *fbd_feedback_vibra_get_device (FbdFeedbackVibra *self);
 
 G_END_DECLS
@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#define G_LOG_DOMAIN "fbd-io-worker"
+
+#include "fbd-io-worker.h"
+
+#include <gio/gio.h>
+
+/**
+ * FbdIoWorker:
+ *
+ * A command queue drained by a worker thread
+ *
+ * Writing to sysfs, issuing ioctls on evdev nodes or doing synchronous
+ * binder transactions can block for a noticeable amount of time. A
+ * device hands these operations to its #FbdIoWorker so the main loop
+ * (and hence the DBus interface) stays responsive. Commands are run in
+ * the order they were queued. A command queued with a coalesce key
+ * replaces a not yet started command with the same key (e.g. a new LED
+ * state supersedes a pending one). Completion is reported back in the
+ * main context the worker was created in.
+ */
+
+enum {
+  PROP_0,
+  PROP_NAME,
+  PROP_LAST_PROP,
+};
+static GParamSpec *props[PROP_LAST_PROP];
+
+typedef struct {
+  gconstpointer        key;
+  FbdIoWorkerFunc      func;
+  FbdIoWorkerDoneFunc  done;
+  gpointer             data;
+  GDestroyNotify       destroy;
+  GError              *error;
+} FbdIoCmd;
+
+typedef struct _FbdIoWorker {
+  GObject       parent;
+
+  char         *name;
+  GMainContext *context;
+  GThread      *thread;
+
+  /* Protected by mutex */
+  GMutex        mutex;
+  GCond         cond;
+  GQueue        queue;
+  gboolean      busy;
+  gboolean      quit;
+} FbdIoWorker;
+
+G_DEFINE_TYPE (FbdIoWorker, fbd_io_worker, G_TYPE_OBJECT)
+
+
+static void
+fbd_io_cmd_free (FbdIoCmd *cmd)
+{
+  if (cmd->destroy)
+    cmd->destroy (cmd->data);
+  g_clear_error (&cmd->error);
+  g_free (cmd);
+}
+
+
+static gboolean
+on_cmd_done (gpointer user_data)
+{
+  FbdIoCmd *cmd = user_data;
+
+  if (cmd->done)
+    cmd->done (cmd->data, cmd->error);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Hands the command over to the main context. The command must not be
+ * touched afterwards as it's freed there. */
+static void
+fbd_io_worker_complete (FbdIoWorker *self, FbdIoCmd *cmd)
+{
+  GSource *source = g_idle_source_new ();
+
+  g_source_set_priority (source, G_PRIORITY_DEFAULT);
+  g_source_set_callback (source, on_cmd_done, cmd, (GDestroyNotify) fbd_io_cmd_free);
+  g_source_set_name (source, "[feedbackd] io worker completion");
+  g_source_attach (source, self->context);
+  g_source_unref (source);
+}
+
+
+static gpointer
+fbd_io_worker_thread (gpointer user_data)
+{
+  FbdIoWorker *self = FBD_IO_WORKER (user_data);
+
+  g_mutex_lock (&self->mutex);
+  while (TRUE) {
+    FbdIoCmd *cmd;
+
+    while (!self->quit && g_queue_is_empty (&self->queue))
+      g_cond_wait (&self->cond, &self->mutex);
+
+    if (self->quit)
+      break;
+
+    cmd = g_queue_pop_head (&self->queue);
+    self->busy = TRUE;
+    g_mutex_unlock (&self->mutex);
+
+    if (!cmd->func (cmd->data, &cmd->error) && cmd->error == NULL) {
+      g_set_error (&cmd->error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "I/O operation failed");
+    }
+    fbd_io_worker_complete (self, cmd);
+
+    g_mutex_lock (&self->mutex);
+    self->busy = FALSE;
+    g_cond_broadcast (&self->cond);
+  }
+  g_mutex_unlock (&self->mutex);
+
+  return NULL;
+}
+
+
+static void
+fbd_io_worker_set_property (GObject      *object,
+                            guint         property_id,
+                            const GValue *value,
+                            GParamSpec   *pspec)
+{
+  FbdIoWorker *self = FBD_IO_WORKER (object);
+
+  switch (property_id) {
+  case PROP_NAME:
+    self->name = g_value_dup_string (value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    break;
+  }
+}
+
+
+static void
+fbd_io_worker_get_property (GObject    *object,
+                            guint       property_id,
+                            GValue     *value,
+                            GParamSpec *pspec)
+{
+  FbdIoWorker *self = FBD_IO_WORKER (object);
+
+  switch (property_id) {
+  case PROP_NAME:
+    g_value_set_string (value, self->name);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    break;
+  }
+}
+
+
+static void
+fbd_io_worker_constructed (GObject *object)
+{
+  FbdIoWorker *self = FBD_IO_WORKER (object);
+
+  G_OBJECT_CLASS (fbd_io_worker_parent_class)->constructed (object);
+
+  self->thread = g_thread_new (self->name ?: "fbd-io", fbd_io_worker_thread, self);
+}
+
+
+static void
+fbd_io_worker_finalize (GObject *object)
+{
+  FbdIoWorker *self = FBD_IO_WORKER (object);
+
+  g_mutex_lock (&self->mutex);
+  self->quit = TRUE;
+  g_cond_broadcast (&self->cond);
+  g_mutex_unlock (&self->mutex);
+  g_thread_join (self->thread);
+
+  /* Commands that never ran */
+  g_queue_clear_full (&self->queue, (GDestroyNotify) fbd_io_cmd_free);
+
+  g_mutex_clear (&self->mutex);
+  g_cond_clear (&self->cond);
+  g_main_context_unref (self->context);
+  g_free (self->name);
+
+  G_OBJECT_CLASS (fbd_io_worker_parent_class)->finalize (object);
+}
+
+
+static void
+fbd_io_worker_class_init (FbdIoWorkerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->set_property = fbd_io_worker_set_property;
+  object_class->get_property = fbd_io_worker_get_property;
+  object_class->constructed = fbd_io_worker_constructed;
+  object_class->finalize = fbd_io_worker_finalize;
+
+  props[PROP_NAME] =
+    g_param_spec_string ("name",
+                         "Name",
+                         "The worker thread's name",
+                         NULL,
+                         G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (object_class, PROP_LAST_PROP, props);
+}
+
+
+static void
+fbd_io_worker_init (FbdIoWorker *self)
+{
+  g_mutex_init (&self->mutex);
+  g_cond_init (&self->cond);
+  g_queue_init (&self->queue);
+  self->context = g_main_context_ref_thread_default ();
+}
+
+
+FbdIoWorker *
+fbd_io_worker_new (const char *name)
+{
+  return g_object_new (FBD_TYPE_IO_WORKER, "name", name, NULL);
+}
+
+/**
+ * fbd_io_worker_push:
+ * @self: The io worker
+ * @coalesce_key: (nullable): Key to coalesce commands with
+ * @func: The operation to run in the worker thread
+ * @done: (nullable): Invoked in the main context once the command finished
+ * @data: Data passed to @func and @done
+ * @destroy: (nullable): Destroy notify for @data
+ *
+ * Queues @func to be run in the worker thread. If @coalesce_key is not
+ * %NULL and there's a queued command with the same key that didn't start
+ * yet the new command takes its place in the queue and the old one
+ * completes with %G_IO_ERROR_CANCELLED. @destroy is invoked in the main
+ * context.
+ */
+void
+fbd_io_worker_push (FbdIoWorker         *self,
+                    gconstpointer        coalesce_key,
+                    FbdIoWorkerFunc      func,
+                    FbdIoWorkerDoneFunc  done,
+                    gpointer             data,
+                    GDestroyNotify       destroy)
+{
+  FbdIoCmd *cmd, *superseded = NULL;
+
+  g_return_if_fail (FBD_IS_IO_WORKER (self));
+  g_return_if_fail (func);
+
+  cmd = g_new0 (FbdIoCmd, 1);
+  cmd->key = coalesce_key;
+  cmd->func = func;
+  cmd->done = done;
+  cmd->data = data;
+  cmd->destroy = destroy;
+
+  g_mutex_lock (&self->mutex);
+  if (coalesce_key) {
+    for (GList *l = self->queue.head; l; l = l->next) {
+      FbdIoCmd *queued = l->data;
+
+      if (queued->key == coalesce_key) {
+        superseded = queued;
+        l->data = cmd;
+        break;
+      }
+    }
+  }
+  if (superseded == NULL)
+    g_queue_push_tail (&self->queue, cmd);
+  g_cond_broadcast (&self->cond);
+  g_mutex_unlock (&self->mutex);
+
+  if (superseded) {
+    g_set_error (&superseded->error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                 "Superseded by a newer command");
+    fbd_io_worker_complete (self, superseded);
+  }
+}
+
+/**
+ * fbd_io_worker_flush:
+ * @self: The io worker
+ *
+ * Blocks until all queued commands ran. Completion callbacks are
+ * dispatched by the main context as usual.
+ */
+void
+fbd_io_worker_flush (FbdIoWorker *self)
+{
+  g_return_if_fail (FBD_IS_IO_WORKER (self));
+
+  g_mutex_lock (&self->mutex);
+  while (self->busy || !g_queue_is_empty (&self->queue))
+    g_cond_wait (&self->cond, &self->mutex);
+  g_mutex_unlock (&self->mutex);
+}
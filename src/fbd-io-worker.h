@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+#pragma once
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/**
+ * FbdIoWorkerFunc:
+ * @data: The data passed to fbd_io_worker_push()
+ * @error: Return location for an error
+ *
+ * A potentially blocking operation. It's invoked in the worker's thread.
+ *
+ * Returns: %TRUE on success, otherwise %FALSE with @error set.
+ */
+typedef gboolean (*FbdIoWorkerFunc) (gpointer data, GError **error);
+
+/**
+ * FbdIoWorkerDoneFunc:
+ * @data: The data passed to fbd_io_worker_push()
+ * @error: (nullable): The error of the operation or %NULL on success
+ *
+ * Invoked in the main context the worker was created in once the
+ * operation completed, failed or got superseded by a newer one
+ * (%G_IO_ERROR_CANCELLED).
+ */
+typedef void (*FbdIoWorkerDoneFunc) (gpointer data, const GError *error);
+
+#define FBD_TYPE_IO_WORKER (fbd_io_worker_get_type ())
+
+G_DECLARE_FINAL_TYPE (FbdIoWorker, fbd_io_worker, FBD, IO_WORKER, GObject);
+
+FbdIoWorker *fbd_io_worker_new   (const char          *name);
+void         fbd_io_worker_push  (FbdIoWorker         *self,
+                                  gconstpointer        coalesce_key,
+                                  FbdIoWorkerFunc      func,
+                                  FbdIoWorkerDoneFunc  done,
+                                  gpointer             data,
+                                  GDestroyNotify       destroy);
+void         fbd_io_worker_flush (FbdIoWorker         *self);
+
+G_END_DECLS
@@ -0,0 +1,462 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ *
+ * See Documentation/ABI/testing/sysfs-class-led-trigger-pattern
+ */
+
+#define G_LOG_DOMAIN "fbd-led-pattern"
+
+#include "fbd.h"
+#include "fbd-led-pattern.h"
+
+#include <math.h>
+
+/* Max number of ramp steps approximating a curve between two points */
+#define MAX_CURVE_STEPS      16
+/* Number of brightness values used if the hardware doesn't limit them */
+#define DEFAULT_HOLD_ENTRIES 64
+
+/**
+ * FbdLedPattern:
+ *
+ * A LED pattern described by a list of points, each given by a
+ * brightness (in percent) and the time (in ms) it takes to get to the
+ * next point. The last point leads back to the first one. The
+ * #FbdLedPatternCurve determines how the brightness changes between
+ * points.
+ *
+ * fbd_led_pattern_render() turns the description into the
+ * `brightness duration` pairs written to a LED's (hw_)pattern
+ * attribute taking the driver's #FbdLedPatternLimits into account.
+ * Curves the hardware can't ramp along are approximated by several
+ * steps so the effect runs entirely in hardware. The result is cached
+ * so rendering the same pattern again is cheap.
+ */
+
+typedef struct {
+  guint brightness;
+  guint duration;
+} FbdLedPatternPoint;
+
+struct _FbdLedPattern {
+  gatomicrefcount     ref_count;
+
+  FbdLedPatternCurve  curve;
+  GArray             *points;
+  guint               period;
+
+  /* Rendered patterns, key: limits and max brightness */
+  GMutex              mutex;
+  GHashTable         *rendered;
+};
+
+G_DEFINE_BOXED_TYPE (FbdLedPattern, fbd_led_pattern, fbd_led_pattern_ref, fbd_led_pattern_unref)
+
+
+static double
+interpolate (FbdLedPatternCurve curve, double from, double to, double x)
+{
+  switch (curve) {
+  case FBD_LED_PATTERN_CURVE_STEP:
+    return from;
+  case FBD_LED_PATTERN_CURVE_SINE:
+    return from + (to - from) * (1.0 - cos (G_PI * x)) / 2.0;
+  case FBD_LED_PATTERN_CURVE_LINEAR:
+  default:
+    return from + (to - from) * x;
+  }
+}
+
+
+static FbdLedPatternPoint *
+get_point (FbdLedPattern *self, guint i)
+{
+  return &g_array_index (self->points, FbdLedPatternPoint, i % self->points->len);
+}
+
+/* The brightness in percent at @t ms into the pattern */
+static double
+fbd_led_pattern_get_level (FbdLedPattern *self, double t)
+{
+  double start = 0;
+
+  t = fmod (t, self->period);
+  for (guint i = 0; i < self->points->len; i++) {
+    FbdLedPatternPoint *point = get_point (self, i);
+    FbdLedPatternPoint *next = get_point (self, i + 1);
+
+    if (t < start + point->duration) {
+      return interpolate (self->curve, point->brightness, next->brightness,
+                          (t - start) / point->duration);
+    }
+    start += point->duration;
+  }
+
+  return get_point (self, 0)->brightness;
+}
+
+
+static guint
+to_value (const FbdLedPatternLimits *limits, double level, guint max_brightness)
+{
+  guint value = round (level * max_brightness / 100.0);
+
+  if (limits->brightness_step > 1) {
+    value = (value + limits->brightness_step / 2) / limits->brightness_step;
+    value *= limits->brightness_step;
+    if (value > max_brightness)
+      value -= limits->brightness_step;
+  }
+
+  return value;
+}
+
+
+static void
+append_entry (GString *str, guint value, guint duration)
+{
+  g_string_append_printf (str, "%s%u %u", str->len ? " " : "", value, duration);
+}
+
+/* For hardware that ramps linearly from one entry to the next */
+static gboolean
+render_ramp (FbdLedPattern *self, const FbdLedPatternLimits *limits, guint max_brightness,
+             GString *str)
+{
+  guint n_entries = 0;
+
+  for (guint i = 0; i < self->points->len; i++) {
+    FbdLedPatternPoint *point = get_point (self, i);
+    FbdLedPatternPoint *next = get_point (self, i + 1);
+    guint steps = 1;
+
+    if (self->curve == FBD_LED_PATTERN_CURVE_SINE && point->brightness != next->brightness) {
+      steps = MAX_CURVE_STEPS;
+      if (limits->min_duration_ms)
+        steps = MIN (steps, point->duration / limits->min_duration_ms);
+    }
+    if (limits->max_duration_ms) {
+      steps = MAX (steps, (point->duration + limits->max_duration_ms - 1) /
+                   limits->max_duration_ms);
+    }
+    steps = MAX (steps, 1);
+
+    for (guint j = 0; j < steps; j++) {
+      guint start = point->duration * j / steps;
+      guint end = point->duration * (j + 1) / steps;
+      double level;
+
+      level = interpolate (self->curve, point->brightness, next->brightness,
+                           (double) start / point->duration);
+      append_entry (str, to_value (limits, level, max_brightness), end - start);
+      n_entries++;
+    }
+
+    /* Jump to the next point's brightness right away */
+    if (self->curve == FBD_LED_PATTERN_CURVE_STEP) {
+      append_entry (str, to_value (limits, point->brightness, max_brightness), 0);
+      n_entries++;
+    }
+  }
+
+  if (limits->max_entries && n_entries > limits->max_entries) {
+    g_warning ("Pattern needs %u entries, hardware supports %u", n_entries, limits->max_entries);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* For hardware that holds each value for the same amount of time */
+static gboolean
+render_hold (FbdLedPattern *self, const FbdLedPatternLimits *limits, guint max_brightness,
+             GString *str)
+{
+  guint n_entries = limits->max_entries ?: DEFAULT_HOLD_ENTRIES;
+  guint duration;
+  double dt;
+
+  n_entries = MIN (n_entries, self->period);
+  if (limits->min_duration_ms)
+    n_entries = MIN (n_entries, self->period / limits->min_duration_ms);
+  n_entries = MAX (n_entries, 1);
+
+  dt = (double) self->period / n_entries;
+  if (limits->max_duration_ms && dt > limits->max_duration_ms) {
+    dt = limits->max_duration_ms;
+    n_entries = ceil (self->period / dt);
+    if (limits->max_entries && n_entries > limits->max_entries) {
+      g_debug ("Pattern period %ums exceeds hardware limits, shortening it", self->period);
+      n_entries = limits->max_entries;
+    }
+  }
+  duration = MAX ((guint) round (dt), 1);
+
+  for (guint i = 0; i < n_entries; i++) {
+    guint value = to_value (limits, fbd_led_pattern_get_level (self, (i + 0.5) * dt),
+                            max_brightness);
+
+    append_entry (str, value, duration);
+    append_entry (str, value, 0);
+  }
+
+  return TRUE;
+}
+
+
+/* The shortest point of a step pattern, 0 if the pattern has curves to sample */
+static guint
+get_shortest_step (FbdLedPattern *self)
+{
+  guint shortest = G_MAXUINT;
+
+  if (self->curve != FBD_LED_PATTERN_CURVE_STEP)
+    return 0;
+
+  for (guint i = 0; i < self->points->len; i++) {
+    FbdLedPatternPoint *point = get_point (self, i);
+
+    if (point->duration)
+      shortest = MIN (shortest, point->duration);
+  }
+
+  return shortest;
+}
+
+
+static void
+fbd_led_pattern_free (FbdLedPattern *self)
+{
+  g_array_unref (self->points);
+  g_hash_table_destroy (self->rendered);
+  g_mutex_clear (&self->mutex);
+  g_free (self);
+}
+
+/**
+ * fbd_led_pattern_new_from_string:
+ * @pattern: The pattern's points as `brightness duration` pairs
+ * @curve: How the brightness changes between points
+ * @error: Return location for an error
+ *
+ * Parses a pattern description like `0 1000 100 1000` (ramping from
+ * off to full brightness in one second and back in another one).
+ * Brightness is given in percent, durations in ms.
+ *
+ * Returns: (transfer full): The pattern or %NULL on error
+ */
+FbdLedPattern *
+fbd_led_pattern_new_from_string (const char *pattern, FbdLedPatternCurve curve, GError **error)
+{
+  g_autoptr (FbdLedPattern) self = NULL;
+  g_auto (GStrv) tokens = NULL;
+  FbdLedPatternPoint point = { 0 };
+  gboolean have_brightness = FALSE;
+
+  g_return_val_if_fail (pattern, NULL);
+
+  self = g_new0 (FbdLedPattern, 1);
+  g_atomic_ref_count_init (&self->ref_count);
+  g_mutex_init (&self->mutex);
+  self->curve = curve;
+  self->points = g_array_new (FALSE, FALSE, sizeof (FbdLedPatternPoint));
+  self->rendered = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  tokens = g_strsplit_set (pattern, " \t\n", -1);
+  for (guint i = 0; tokens[i]; i++) {
+    guint64 val;
+
+    if (tokens[i][0] == '\0')
+      continue;
+
+    if (!g_ascii_string_to_unsigned (tokens[i], 10, 0,
+                                     have_brightness ? G_MAXUINT : 100,
+                                     &val, error)) {
+      return NULL;
+    }
+
+    if (!have_brightness) {
+      point.brightness = val;
+    } else {
+      point.duration = val;
+      self->period += val;
+      g_array_append_val (self->points, point);
+    }
+    have_brightness = !have_brightness;
+  }
+
+  if (have_brightness || self->period == 0) {
+    g_set_error (error, fbd_error_quark (), FBD_ERROR_FAILED,
+                 "'%s' is not a valid LED pattern", pattern);
+    return NULL;
+  }
+
+  return g_steal_pointer (&self);
+}
+
+
+FbdLedPattern *
+fbd_led_pattern_ref (FbdLedPattern *self)
+{
+  g_return_val_if_fail (self, NULL);
+
+  g_atomic_ref_count_inc (&self->ref_count);
+  return self;
+}
+
+
+void
+fbd_led_pattern_unref (FbdLedPattern *self)
+{
+  g_return_if_fail (self);
+
+  if (g_atomic_ref_count_dec (&self->ref_count))
+    fbd_led_pattern_free (self);
+}
+
+/**
+ * fbd_led_pattern_get_period:
+ * @self: The pattern
+ *
+ * Returns: The duration of one iteration of the pattern in ms
+ */
+guint
+fbd_led_pattern_get_period (FbdLedPattern *self)
+{
+  g_return_val_if_fail (self, 0);
+
+  return self->period;
+}
+
+/**
+ * fbd_led_pattern_render:
+ * @self: The pattern
+ * @limits: The driver's limits, must stay valid as long as @self
+ * @max_brightness: The absolute brightness corresponding to 100%
+ *
+ * Renders the pattern as `brightness duration` pairs suitable for the
+ * LED driver described by @limits. No trailing newline is added so
+ * several patterns can be concatenated.
+ *
+ * This can be called from any thread.
+ *
+ * Returns: (transfer none) (nullable): The rendered pattern or %NULL if
+ *   it can't be represented within the driver's limits.
+ */
+const char *
+fbd_led_pattern_render (FbdLedPattern             *self,
+                        const FbdLedPatternLimits *limits,
+                        guint                      max_brightness)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+  g_autoptr (GString) str = NULL;
+  g_autofree char *key = NULL;
+  char *rendered = NULL;
+  gboolean success;
+
+  g_return_val_if_fail (self, NULL);
+  g_return_val_if_fail (limits, NULL);
+
+  key = g_strdup_printf ("%p:%u", limits, max_brightness);
+
+  locker = g_mutex_locker_new (&self->mutex);
+  if (g_hash_table_lookup_extended (self->rendered, key, NULL, (gpointer *)&rendered))
+    return rendered;
+
+  str = g_string_new (NULL);
+  if (limits->hold)
+    success = render_hold (self, limits, max_brightness, str);
+  else
+    success = render_ramp (self, limits, max_brightness, str);
+
+  if (success)
+    rendered = g_string_free (g_steal_pointer (&str), FALSE);
+
+  g_debug ("Rendered LED pattern: %s", rendered);
+  g_hash_table_insert (self->rendered, g_steal_pointer (&key), rendered);
+
+  return rendered;
+}
+
+/**
+ * fbd_led_pattern_render_sequence:
+ * @patterns: (array length=n_patterns): The patterns to play one after another
+ * @max_brightness: (array length=n_patterns): The absolute brightness
+ *   corresponding to 100% for each pattern
+ * @n_patterns: The number of patterns
+ * @limits: The driver's limits, must be for hardware that holds values
+ *
+ * Renders several patterns as a single one for hardware that holds
+ * each value for the same amount of time. Unlike concatenating
+ * fbd_led_pattern_render() results all entries use one time step and
+ * the driver's entry limit applies to the whole sequence. Pattern
+ * durations are rounded to multiples of that time step.
+ *
+ * Returns: (transfer full) (nullable): The rendered sequence or %NULL if
+ *   the patterns can't be represented together within the driver's limits.
+ */
+char *
+fbd_led_pattern_render_sequence (FbdLedPattern             **patterns,
+                                 const guint                *max_brightness,
+                                 guint                       n_patterns,
+                                 const FbdLedPatternLimits  *limits)
+{
+  g_autoptr (GString) str = g_string_new (NULL);
+  g_autofree guint *n_steps = g_new0 (guint, n_patterns);
+  guint budget = limits->max_entries ?: DEFAULT_HOLD_ENTRIES;
+  guint period = 0, shortest = G_MAXUINT, n_entries = 0;
+  guint duration;
+  double dt;
+
+  g_return_val_if_fail (patterns, NULL);
+  g_return_val_if_fail (max_brightness, NULL);
+  g_return_val_if_fail (n_patterns > 0, NULL);
+  g_return_val_if_fail (limits && limits->hold, NULL);
+
+  for (guint i = 0; i < n_patterns; i++) {
+    period += patterns[i]->period;
+    /* Curves want the finest step the budget allows, steps the coarsest */
+    shortest = MIN (shortest, get_shortest_step (patterns[i]));
+  }
+
+  dt = (double) period / budget;
+  if (shortest != G_MAXUINT)
+    dt = MAX (dt, shortest);
+  if (limits->min_duration_ms)
+    dt = MAX (dt, limits->min_duration_ms);
+  if (limits->max_duration_ms)
+    dt = MIN (dt, limits->max_duration_ms);
+  duration = MAX ((guint) round (dt), 1);
+
+  for (guint i = 0; i < n_patterns; i++) {
+    n_steps[i] = MAX ((guint) round ((double) patterns[i]->period / duration), 1);
+
+    /* Every point needs at least one entry, otherwise the pattern degrades */
+    if (n_steps[i] < patterns[i]->points->len) {
+      g_debug ("Pattern %u too short for a %ums time step", i, duration);
+      return NULL;
+    }
+    n_entries += n_steps[i];
+  }
+
+  if (n_entries > budget) {
+    g_debug ("Sequence needs %u entries, hardware supports %u", n_entries, budget);
+    return NULL;
+  }
+
+  for (guint i = 0; i < n_patterns; i++) {
+    double step = (double) patterns[i]->period / n_steps[i];
+
+    for (guint j = 0; j < n_steps[i]; j++) {
+      double level = fbd_led_pattern_get_level (patterns[i], (j + 0.5) * step);
+      guint value = to_value (limits, level, max_brightness[i]);
+
+      append_entry (str, value, duration);
+      append_entry (str, value, 0);
+    }
+  }
+
+  return g_string_free (g_steal_pointer (&str), FALSE);
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+#pragma once
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/**
+ * FbdLedPatternCurve:
+ * @FBD_LED_PATTERN_CURVE_LINEAR: Ramp linearly from one point to the next
+ * @FBD_LED_PATTERN_CURVE_STEP: Keep a point's brightness until the next point
+ * @FBD_LED_PATTERN_CURVE_SINE: Ease in and out between points (e.g. for breathing effects)
+ *
+ * How the brightness changes between the points of a #FbdLedPattern.
+ */
+typedef enum _FbdLedPatternCurve {
+  FBD_LED_PATTERN_CURVE_LINEAR = 0,
+  FBD_LED_PATTERN_CURVE_STEP   = 1,
+  FBD_LED_PATTERN_CURVE_SINE   = 2,
+} FbdLedPatternCurve;
+
+/**
+ * FbdLedPatternLimits:
+ * @max_entries: The max number of brightness values in a pattern, 0 if unlimited
+ * @min_duration_ms: The min duration of a ramp step in ms
+ * @max_duration_ms: The max duration of a single entry in ms, 0 if unlimited
+ * @hold: Whether the hardware holds each brightness value instead of ramping
+ *   to the next one. All entries then use the same duration.
+ * @brightness_step: The granularity of brightness values, 0 or 1 if any
+ *   value up to the max brightness is fine
+ *
+ * The constraints a LED driver puts on patterns.
+ */
+typedef struct {
+  guint    max_entries;
+  guint    min_duration_ms;
+  guint    max_duration_ms;
+  gboolean hold;
+  guint    brightness_step;
+} FbdLedPatternLimits;
+
+typedef struct _FbdLedPattern FbdLedPattern;
+
+#define FBD_TYPE_LED_PATTERN (fbd_led_pattern_get_type ())
+
+GType          fbd_led_pattern_get_type        (void) G_GNUC_CONST;
+FbdLedPattern *fbd_led_pattern_new_from_string (const char                *pattern,
+                                                FbdLedPatternCurve         curve,
+                                                GError                   **error);
+FbdLedPattern *fbd_led_pattern_ref             (FbdLedPattern             *self);
+void           fbd_led_pattern_unref           (FbdLedPattern             *self);
+guint          fbd_led_pattern_get_period      (FbdLedPattern             *self);
+const char    *fbd_led_pattern_render          (FbdLedPattern             *self,
+                                                const FbdLedPatternLimits *limits,
+                                                guint                      max_brightness);
+char          *fbd_led_pattern_render_sequence (FbdLedPattern            **patterns,
+                                                const guint               *max_brightness,
+                                                guint                      n_patterns,
+                                                const FbdLedPatternLimits *limits);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FbdLedPattern, fbd_led_pattern_unref)
+
+G_END_DECLS
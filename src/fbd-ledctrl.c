@@ -6,6 +6,9 @@
 
 #define G_LOG_DOMAIN "fbd-ledctrl"
 
+#include "fbd.h"
+
+#include <gudev/gudev.h>
 #include <glib.h>
 
 #include <errno.h>
@@ -23,6 +26,8 @@
 #define LED_TRIGGER_ATTR         "trigger"
 #define LED_TRIGGER_PATTERN      "pattern"
 #define LED_TRIGGER_HW_PATTERN   "hw_pattern"
+#define LED_SUBSYSTEM            "leds"
+#define LED_ATTR_MODE            0664
 
 enum {
   FBD_LEDCTRL_ERR_CMDLINE = 1,
@@ -75,20 +80,30 @@ read_sysfs_attr (const char *sysfs_path, const char *attr)
 }
 
 static gboolean
-set_sysfs_attr_perm (const char *sysfs_path, const char *attr, gid_t gid)
+set_sysfs_attr_perm (const char *sysfs_path, const char *attr, gid_t gid, gboolean optional)
 {
   g_autofree gchar *path = g_strjoin ("/", sysfs_path, attr, NULL);
-  
-  if (chown(path, -1, gid) < 0) {
+  struct stat st;
+
+  if (stat (path, &st) < 0) {
+    if (optional && errno == ENOENT)
+      return TRUE;
+
+    fprintf (stderr, "Failed to stat %s: %s\n", path, strerror (errno));
+    return FALSE;
+  }
+
+  /* Only touch attributes that need it, this runs for every LED on each uevent */
+  if (st.st_gid != gid && chown (path, -1, gid) < 0) {
     fprintf (stderr, "Failed to set perms of %s to %d: %s\n", path, gid, strerror (errno));
     return FALSE;
   }
 
-  if (chmod(path, 0664) < 0) {
+  if ((st.st_mode & 07777) != LED_ATTR_MODE && chmod (path, LED_ATTR_MODE) < 0) {
     fprintf (stderr, "Failed to set mode of %s: %s\n", path, strerror (errno));
     return FALSE;
   }
-  
+
   return TRUE;
 }
 
@@ -104,6 +119,9 @@ set_trigger (const char *sysfs_path, const char *trigger)
    * same trigger over and over again in a udev rule.
    */
   val = read_sysfs_attr (sysfs_path, LED_TRIGGER_ATTR);
+  if (val == NULL)
+    return FALSE;
+
   g_strstrip(val);
   triggers = g_strsplit (val, " ", 0);
 
@@ -118,44 +136,82 @@ set_trigger (const char *sysfs_path, const char *trigger)
 }
 
 static gboolean
-set_perms (const char *sysfs_path, const char *trigger, const char *gname)
+set_perms (const char *sysfs_path, const char *trigger, gid_t gid)
 {
-  struct group *group;
   gboolean success = TRUE;
 
-  group = getgrnam (gname);
-
-  if (!set_sysfs_attr_perm (sysfs_path, LED_BRIGHTNESS_ATTR, group->gr_gid))
+  if (!set_sysfs_attr_perm (sysfs_path, LED_BRIGHTNESS_ATTR, gid, FALSE))
       return FALSE;
 
-  /* Attribute is optional */
-  set_sysfs_attr_perm (sysfs_path, LED_MULTI_INTENSITY_ATTR, group->gr_gid);
+  set_sysfs_attr_perm (sysfs_path, LED_MULTI_INTENSITY_ATTR, gid, TRUE);
 
   if (!g_strcmp0 (trigger, LED_TRIGGER_PATTERN)) {
-    if (!set_sysfs_attr_perm (sysfs_path, LED_PATTERN_ATTR, group->gr_gid))
+    if (!set_sysfs_attr_perm (sysfs_path, LED_PATTERN_ATTR, gid, FALSE))
       success = FALSE;
-    if (!set_sysfs_attr_perm (sysfs_path, LED_REPEAT_ATTR, group->gr_gid))
+    if (!set_sysfs_attr_perm (sysfs_path, LED_REPEAT_ATTR, gid, FALSE))
       success = FALSE;
 
-    /* Attribute is optional */
-    set_sysfs_attr_perm (sysfs_path, LED_TRIGGER_HW_PATTERN, group->gr_gid);
+    set_sysfs_attr_perm (sysfs_path, LED_TRIGGER_HW_PATTERN, gid, TRUE);
   }
 
   /* specific setup for other triggers goes here */
   return success;
 }
 
+/* Add all LEDs udev marked for use by feedbackd */
+static void
+scan_leds (GPtrArray *paths)
+{
+  g_autoptr (GUdevClient) client = g_udev_client_new (NULL);
+  g_autolist (GUdevDevice) leds = NULL;
+
+  leds = g_udev_client_query_by_subsystem (client, LED_SUBSYSTEM);
+  for (GList *l = leds; l != NULL; l = l->next) {
+    GUdevDevice *dev = G_UDEV_DEVICE (l->data);
+
+    if (g_strcmp0 (g_udev_device_get_property (dev, FEEDBACKD_UDEV_ATTR),
+                   FEEDBACKD_UDEV_VAL_LED)) {
+      continue;
+    }
+
+    g_ptr_array_add (paths, g_strdup (g_udev_device_get_sysfs_path (dev)));
+  }
+}
+
+static int
+setup_led (const char *sysfs_path, const char *trigger, const struct group *group)
+{
+  g_debug ("Configuring LED at %s for trigger %s", sysfs_path, trigger);
+
+  if (!set_trigger (sysfs_path, trigger))
+    return FBD_LEDCTRL_ERR_TRIGGER;
+
+  if (group) {
+    g_debug ("Setting permission of %s to %s", sysfs_path, group->gr_name);
+    if (!set_perms (sysfs_path, trigger, group->gr_gid))
+      return FBD_LEDCTRL_ERR_PERMS;
+  }
+
+  return 0;
+}
+
 int main(int argc, char *argv[])
 {
   g_autoptr(GError) err = NULL;
   g_autoptr(GOptionContext) opt_context = NULL;
-  g_autofree gchar *sysfs_path = NULL;
+  g_auto(GStrv) sysfs_paths = NULL;
+  g_autoptr(GPtrArray) paths = g_ptr_array_new_with_free_func (g_free);
   g_autofree gchar *group = NULL;
   g_autofree gchar *trigger = NULL;
+  struct group *grp = NULL;
+  gboolean scan = FALSE;
+  int ret = 0;
 
   const GOptionEntry options [] = {
-    {"path", 'p', 0, G_OPTION_ARG_STRING, &sysfs_path,
-     "Path to LEDs sysfs dir", NULL},
+    {"path", 'p', 0, G_OPTION_ARG_STRING_ARRAY, &sysfs_paths,
+     "Path to LEDs sysfs dir, can be given multiple times", NULL},
+    {"scan", 's', 0, G_OPTION_ARG_NONE, &scan,
+     "Configure all LEDs marked for use by feedbackd", NULL},
     {"group", 'G', 0, G_OPTION_ARG_STRING, &group,
      "Group to set permissions to", NULL},
     {"trigger", 't', 0, G_OPTION_ARG_STRING, &trigger,
@@ -171,7 +227,13 @@ int main(int argc, char *argv[])
     return 1;
   }
 
-  if (!sysfs_path) {
+  for (guint i = 0; sysfs_paths && sysfs_paths[i]; i++)
+    g_ptr_array_add (paths, g_strdup (sysfs_paths[i]));
+
+  if (scan)
+    scan_leds (paths);
+
+  if (!sysfs_paths && !scan) {
     fprintf (stderr, "No sysfs path given\n");
     return FBD_LEDCTRL_ERR_CMDLINE;
   }
@@ -180,16 +242,22 @@ int main(int argc, char *argv[])
     fprintf (stderr, "No trigger specified\n");
     return FBD_LEDCTRL_ERR_CMDLINE;;
   }
-  g_debug ("Configuring LED at %s for trigger %s", sysfs_path, trigger);
-
-  if (!set_trigger (sysfs_path, trigger))
-    return FBD_LEDCTRL_ERR_TRIGGER;
 
   if (group) {
-    g_debug ("Setting permission of %s to %s", sysfs_path, group);
-    if (!set_perms (sysfs_path, trigger, group))
+    grp = getgrnam (group);
+    if (grp == NULL) {
+      fprintf (stderr, "Unknown group %s\n", group);
       return FBD_LEDCTRL_ERR_PERMS;
+    }
   }
-    
-  return 0;
+
+  /* Configure as many LEDs as possible, report the first failure */
+  for (guint i = 0; i < paths->len; i++) {
+    int r = setup_led (g_ptr_array_index (paths, i), trigger, grp);
+
+    if (ret == 0)
+      ret = r;
+  }
+
+  return ret;
 }
@@ -15,6 +15,23 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * FbdUdevAttr:
+ *
+ * A writable sysfs attribute of a device. The attribute is opened on
+ * first use and kept open, values are written with a single `pwrite()`.
+ * Writing the value that was written last is a no-op. If the attribute
+ * went away in the meantime (e.g. because the LED's trigger changed) it
+ * is reopened.
+ */
+struct _FbdUdevAttr {
+  char *path;
+  int   fd;
+  char *value;  /* Last written value, %NULL if unknown */
+};
 
 gboolean
 fbd_udev_set_sysfs_path_attr_as_string (GUdevDevice *dev, const gchar *attr,
@@ -84,3 +101,155 @@ fbd_udev_set_sysfs_path_attr_as_int (GUdevDevice *dev, const gchar *attr,
 
   return TRUE;
 }
+
+/**
+ * fbd_udev_attr_new:
+ * @dev: The device
+ * @attr: The attribute's name
+ *
+ * Creates a handle for the sysfs attribute @attr of @dev. The attribute
+ * doesn't need to exist yet.
+ *
+ * Returns: (transfer full): The attribute handle
+ */
+FbdUdevAttr *
+fbd_udev_attr_new (GUdevDevice *dev, const char *attr)
+{
+  FbdUdevAttr *self;
+
+  g_return_val_if_fail (G_UDEV_IS_DEVICE (dev), NULL);
+  g_return_val_if_fail (attr, NULL);
+
+  self = g_new0 (FbdUdevAttr, 1);
+  self->path = g_strjoin ("/", g_udev_device_get_sysfs_path (dev), attr, NULL);
+  self->fd = -1;
+
+  return self;
+}
+
+
+static void
+fbd_udev_attr_close (FbdUdevAttr *self)
+{
+  if (self->fd < 0)
+    return;
+
+  close (self->fd);
+  self->fd = -1;
+}
+
+
+void
+fbd_udev_attr_free (FbdUdevAttr *self)
+{
+  if (self == NULL)
+    return;
+
+  fbd_udev_attr_close (self);
+  g_free (self->value);
+  g_free (self->path);
+  g_free (self);
+}
+
+
+const char *
+fbd_udev_attr_get_path (FbdUdevAttr *self)
+{
+  g_return_val_if_fail (self, NULL);
+
+  return self->path;
+}
+
+/* Returns 0 on success, otherwise a negative errno */
+static int
+fbd_udev_attr_write (FbdUdevAttr *self, const char *s, gsize len)
+{
+  gssize ret;
+
+  if (self->fd < 0) {
+    self->fd = open (self->path, O_WRONLY | O_CLOEXEC);
+    if (self->fd < 0)
+      return -errno;
+  }
+
+  do {
+    ret = pwrite (self->fd, s, len, 0);
+  } while (ret < 0 && errno == EINTR);
+
+  if (ret < 0)
+    return -errno;
+  if ((gsize) ret != len)
+    return -EIO;
+
+  return 0;
+}
+
+/**
+ * fbd_udev_attr_set_string:
+ * @self: The attribute
+ * @s: The value to write
+ * @err: Return location for an error
+ *
+ * Writes @s to the attribute unless it's the value that was written
+ * last.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+fbd_udev_attr_set_string (FbdUdevAttr *self, const char *s, GError **err)
+{
+  gsize len;
+  int ret;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (s, FALSE);
+
+  if (g_strcmp0 (self->value, s) == 0)
+    return TRUE;
+
+  g_clear_pointer (&self->value, g_free);
+  len = strlen (s);
+
+  ret = fbd_udev_attr_write (self, s, len);
+  if (ret == -ENODEV) {
+    /* The attribute got removed and possibly recreated */
+    fbd_udev_attr_close (self);
+    ret = fbd_udev_attr_write (self, s, len);
+  }
+
+  if (ret < 0) {
+    fbd_udev_attr_close (self);
+    g_set_error (err, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to write %s to %s: %s",
+                 s, self->path, g_strerror (-ret));
+    return FALSE;
+  }
+
+  self->value = g_strdup (s);
+  return TRUE;
+}
+
+
+gboolean
+fbd_udev_attr_set_int (FbdUdevAttr *self, gint val, GError **err)
+{
+  char s[16];
+
+  g_snprintf (s, sizeof (s), "%d", val);
+
+  return fbd_udev_attr_set_string (self, s, err);
+}
+
+/**
+ * fbd_udev_attr_invalidate:
+ * @self: The attribute
+ *
+ * Forget the last written value. Use this when the attribute's value
+ * can change behind our back so the next write isn't skipped.
+ */
+void
+fbd_udev_attr_invalidate (FbdUdevAttr *self)
+{
+  g_return_if_fail (self);
+
+  g_clear_pointer (&self->value, g_free);
+}
@@ -16,4 +16,15 @@ gboolean fbd_udev_set_sysfs_path_attr_as_string (GUdevDevice *dev, const gchar *
 gboolean fbd_udev_set_sysfs_path_attr_as_int (GUdevDevice *dev, const gchar *attr,
 					      gint val, GError **err);
 
+typedef struct _FbdUdevAttr FbdUdevAttr;
+
+FbdUdevAttr *fbd_udev_attr_new        (GUdevDevice *dev, const char *attr);
+void         fbd_udev_attr_free       (FbdUdevAttr *self);
+const char  *fbd_udev_attr_get_path   (FbdUdevAttr *self);
+gboolean     fbd_udev_attr_set_string (FbdUdevAttr *self, const char *s, GError **err);
+gboolean     fbd_udev_attr_set_int    (FbdUdevAttr *self, gint val, GError **err);
+void         fbd_udev_attr_invalidate (FbdUdevAttr *self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FbdUdevAttr, fbd_udev_attr_free)
+
 G_END_DECLS
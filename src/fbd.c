@@ -101,15 +101,10 @@ int main(int argc, char *argv[])
     return 1;
   }
 
-  manager = fbd_feedback_manager_get_default ();
-  fbd_feedback_manager_load_theme (manager);
-
-  g_unix_signal_add (SIGTERM, quit_cb, NULL);
-  g_unix_signal_add (SIGINT, quit_cb, NULL);
-  g_unix_signal_add (SIGHUP, reload_cb, NULL);
-
   loop = g_main_loop_new (NULL, FALSE);
 
+  /* Request the name right away, devices get initialized in the
+   * background and events are queued until they're ready */
   g_bus_own_name (FB_DBUS_TYPE,
                   FB_DBUS_NAME,
                   G_BUS_NAME_OWNER_FLAGS_NONE,
@@ -119,6 +114,13 @@ int main(int argc, char *argv[])
                   NULL,
                   NULL);
 
+  manager = fbd_feedback_manager_get_default ();
+  fbd_feedback_manager_load_theme (manager);
+
+  g_unix_signal_add (SIGTERM, quit_cb, NULL);
+  g_unix_signal_add (SIGINT, quit_cb, NULL);
+  g_unix_signal_add (SIGHUP, reload_cb, NULL);
+
   g_main_loop_run (loop);
   g_main_loop_unref (loop);
 }
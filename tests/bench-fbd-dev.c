@@ -0,0 +1,502 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ * SPDX-License-Identifier: GPL-3.0+
+ *
+ * Measures the cost of the device layer: syscalls, bytes written and
+ * wall time per operation. Syscalls are counted by wrapping them at
+ * link time (`-Wl,--wrap=…`) so only calls made by feedbackd's code
+ * show up, not those of the libraries it uses. The force feedback
+ * ioctls of the umockdev vibra device are emulated.
+ */
+
+#include "fbd-feedback-led.h"
+#include "fbd-dev-led.h"
+#include "fbd-dev-led-flash.h"
+#include "fbd-dev-led-multicolor.h"
+#include "fbd-dev-leds.h"
+#include "fbd-dev-vibra.h"
+#include "fbd-led-pattern.h"
+
+#include "testlib.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <stdarg.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#define BENCH_ITERATIONS 100
+#define BENCH_FF_DEVICE  "/dev/input/event"
+#define BENCH_FF_EFFECTS 16
+
+#define BITS_PER_LONG (8 * sizeof (long))
+
+typedef struct {
+  gint opens;
+  gint closes;
+  gint writes;
+  gint ioctls;
+  gint bytes;
+} FbdBenchCounters;
+
+typedef struct {
+  const char       *name;
+  FbdBenchCounters  start;
+  FbdBenchCounters  total;
+  gint64            start_us;
+  gint64            total_us;
+  guint             runs;
+} FbdBench;
+
+/* Updated from the io workers' threads too */
+static FbdBenchCounters counters;
+static gint ff_fd = -1;
+static gint ff_next_id;
+
+/*
+ * With large file support (the default in meson) the code under test
+ * references open64 and pwrite64 instead of open and pwrite, so wrap
+ * both. off_t is 64 bit then.
+ */
+int     __real_open     (const char *path, int flags, ...);
+int     __real_open64   (const char *path, int flags, ...);
+int     __real_close    (int fd);
+ssize_t __real_write    (int fd, const void *buf, size_t count);
+ssize_t __real_pwrite   (int fd, const void *buf, size_t count, off_t offset);
+ssize_t __real_pwrite64 (int fd, const void *buf, size_t count, off_t offset);
+int     __real_ioctl    (int fd, unsigned long request, ...);
+
+int     __wrap_open     (const char *path, int flags, ...);
+int     __wrap_open64   (const char *path, int flags, ...);
+int     __wrap_close    (int fd);
+ssize_t __wrap_write    (int fd, const void *buf, size_t count);
+ssize_t __wrap_pwrite   (int fd, const void *buf, size_t count, off_t offset);
+ssize_t __wrap_pwrite64 (int fd, const void *buf, size_t count, off_t offset);
+int     __wrap_ioctl    (int fd, unsigned long request, ...);
+
+
+static mode_t
+get_mode (int flags, va_list ap)
+{
+  if (flags & O_CREAT)
+    return va_arg (ap, int);
+
+  return 0;
+}
+
+
+static int
+track_open (const char *path, int fd)
+{
+  g_atomic_int_inc (&counters.opens);
+
+  if (fd >= 0 && g_str_has_prefix (path, BENCH_FF_DEVICE))
+    g_atomic_int_set (&ff_fd, fd);
+
+  return fd;
+}
+
+
+int
+__wrap_open (const char *path, int flags, ...)
+{
+  va_list ap;
+  mode_t mode;
+
+  va_start (ap, flags);
+  mode = get_mode (flags, ap);
+  va_end (ap);
+
+  return track_open (path, __real_open (path, flags, mode));
+}
+
+
+int
+__wrap_open64 (const char *path, int flags, ...)
+{
+  va_list ap;
+  mode_t mode;
+
+  va_start (ap, flags);
+  mode = get_mode (flags, ap);
+  va_end (ap);
+
+  return track_open (path, __real_open64 (path, flags, mode));
+}
+
+
+int
+__wrap_close (int fd)
+{
+  g_atomic_int_inc (&counters.closes);
+  g_atomic_int_compare_and_exchange (&ff_fd, fd, -1);
+
+  return __real_close (fd);
+}
+
+
+ssize_t
+__wrap_write (int fd, const void *buf, size_t count)
+{
+  g_atomic_int_inc (&counters.writes);
+  g_atomic_int_add (&counters.bytes, count);
+
+  return __real_write (fd, buf, count);
+}
+
+
+ssize_t
+__wrap_pwrite (int fd, const void *buf, size_t count, off_t offset)
+{
+  g_atomic_int_inc (&counters.writes);
+  g_atomic_int_add (&counters.bytes, count);
+
+  return __real_pwrite (fd, buf, count, offset);
+}
+
+
+ssize_t
+__wrap_pwrite64 (int fd, const void *buf, size_t count, off_t offset)
+{
+  g_atomic_int_inc (&counters.writes);
+  g_atomic_int_add (&counters.bytes, count);
+
+  return __real_pwrite64 (fd, buf, count, offset);
+}
+
+
+static void
+set_bit (void *bits, guint bit)
+{
+  ((unsigned long *) bits)[bit / BITS_PER_LONG] |= 1UL << (bit % BITS_PER_LONG);
+}
+
+/* A vibra motor supporting rumble, sine and gain but no effect status */
+static int
+ff_ioctl (unsigned long request, void *arg)
+{
+  if (_IOC_TYPE (request) == 'E' && _IOC_NR (request) == _IOC_NR (EVIOCGBIT (0, 0))) {
+    memset (arg, 0, _IOC_SIZE (request));
+    set_bit (arg, EV_FF);
+    return 0;
+  }
+
+  if (_IOC_TYPE (request) == 'E' && _IOC_NR (request) == _IOC_NR (EVIOCGBIT (EV_FF, 0))) {
+    memset (arg, 0, _IOC_SIZE (request));
+    set_bit (arg, FF_RUMBLE);
+    set_bit (arg, FF_PERIODIC);
+    set_bit (arg, FF_SINE);
+    set_bit (arg, FF_GAIN);
+    return 0;
+  }
+
+  switch (request) {
+  case EVIOCGEFFECTS:
+    *(int *) arg = BENCH_FF_EFFECTS;
+    return 0;
+  case EVIOCSFF: {
+    struct ff_effect *effect = arg;
+
+    if (effect->id == -1)
+      effect->id = g_atomic_int_add (&ff_next_id, 1) % BENCH_FF_EFFECTS;
+    return 0;
+  }
+  case EVIOCRMFF:
+    return 0;
+  default:
+    errno = ENOTTY;
+    return -1;
+  }
+}
+
+
+int
+__wrap_ioctl (int fd, unsigned long request, ...)
+{
+  va_list ap;
+  void *arg;
+
+  va_start (ap, request);
+  arg = va_arg (ap, void *);
+  va_end (ap);
+
+  g_atomic_int_inc (&counters.ioctls);
+
+  if (fd >= 0 && fd == g_atomic_int_get (&ff_fd))
+    return ff_ioctl (request, arg);
+
+  return __real_ioctl (fd, request, arg);
+}
+
+
+static void
+get_counters (FbdBenchCounters *c)
+{
+  c->opens = g_atomic_int_get (&counters.opens);
+  c->closes = g_atomic_int_get (&counters.closes);
+  c->writes = g_atomic_int_get (&counters.writes);
+  c->ioctls = g_atomic_int_get (&counters.ioctls);
+  c->bytes = g_atomic_int_get (&counters.bytes);
+}
+
+
+static void
+fbd_bench_begin (FbdBench *bench)
+{
+  get_counters (&bench->start);
+  bench->start_us = g_get_monotonic_time ();
+}
+
+
+static void
+fbd_bench_end (FbdBench *bench)
+{
+  FbdBenchCounters now;
+
+  bench->total_us += g_get_monotonic_time () - bench->start_us;
+  get_counters (&now);
+
+  bench->total.opens += now.opens - bench->start.opens;
+  bench->total.closes += now.closes - bench->start.closes;
+  bench->total.writes += now.writes - bench->start.writes;
+  bench->total.ioctls += now.ioctls - bench->start.ioctls;
+  bench->total.bytes += now.bytes - bench->start.bytes;
+  bench->runs++;
+}
+
+
+static void
+fbd_bench_report (const char *prefix, FbdBench *bench)
+{
+  double runs = bench->runs;
+  FbdBenchCounters *t = &bench->total;
+
+  g_assert_cmpint (bench->runs, >, 0);
+
+  g_test_message ("%-22s %-10s open %5.2f close %5.2f write %5.2f ioctl %5.2f "
+                  "bytes %7.1f time %8.1fµs",
+                  prefix, bench->name,
+                  t->opens / runs, t->closes / runs, t->writes / runs, t->ioctls / runs,
+                  t->bytes / runs, bench->total_us / runs);
+}
+
+
+static GUdevDevice *
+get_device (GUdevClient *client, const char *subsystem)
+{
+  g_autolist (GUdevDevice) devices = NULL;
+
+  devices = g_udev_client_query_by_subsystem (client, subsystem);
+  g_assert_cmpint (g_list_length (devices), ==, 1);
+
+  return g_object_ref (devices->data);
+}
+
+
+static void
+bench_led (const char *mockname, FbdDevLed *led)
+{
+  g_autoptr (FbdLedPattern) pattern = NULL;
+  FbdBench start = { "start" }, restart = { "restart" }, blinks = { "pattern" };
+  FbdBench stop = { "stop" };
+  FbdDevLedBlink blink = { 100, 0 };
+
+  pattern = fbd_led_pattern_new_from_string ("0 1000 100 1000", FBD_LED_PATTERN_CURVE_SINE, NULL);
+  blink.pattern = pattern;
+
+  for (guint i = 0; i < BENCH_ITERATIONS; i++) {
+    /* A new frequency each time so nothing is cached */
+    fbd_bench_begin (&start);
+    g_assert_true (fbd_dev_led_start_periodic (led, 50, 1000 + i));
+    fbd_bench_end (&start);
+
+    fbd_bench_begin (&restart);
+    g_assert_true (fbd_dev_led_start_periodic (led, 50, 1000 + i));
+    fbd_bench_end (&restart);
+
+    fbd_bench_begin (&blinks);
+    g_assert_true (fbd_dev_led_start_pattern (led, &blink, 1));
+    fbd_bench_end (&blinks);
+
+    fbd_bench_begin (&stop);
+    g_assert_true (fbd_dev_led_set_brightness (led, 0));
+    fbd_bench_end (&stop);
+  }
+
+  fbd_bench_report (mockname, &start);
+  fbd_bench_report (mockname, &restart);
+  fbd_bench_report (mockname, &blinks);
+  fbd_bench_report (mockname, &stop);
+}
+
+
+static void
+bench_fbd_dev_led (FbdUmockdevFixture *fixture, gconstpointer mockname)
+{
+  g_autoptr (GUdevClient) client = g_udev_client_new ((const char *const []){ "leds", NULL});
+  g_autoptr (GUdevDevice) dev = get_device (client, "leds");
+  g_autoptr (GError) err = NULL;
+  FbdDevLed *led;
+
+  led = fbd_dev_led_new (dev, &err);
+  g_assert_no_error (err);
+
+  bench_led (mockname, led);
+  g_assert_finalize_object (led);
+}
+
+
+static void
+bench_fbd_dev_led_multicolor (FbdUmockdevFixture *fixture, gconstpointer mockname)
+{
+  g_autoptr (GUdevClient) client = g_udev_client_new ((const char *const []){ "leds", NULL});
+  g_autoptr (GUdevDevice) dev = get_device (client, "leds");
+  g_autoptr (GError) err = NULL;
+  FbdLedRgbColor rgb = { 10, 20, 30 };
+  FbdDevLed *led;
+
+  led = fbd_dev_led_multicolor_new (dev, &err);
+  g_assert_no_error (err);
+
+  g_assert_true (fbd_dev_led_set_color (led, FBD_FEEDBACK_LED_COLOR_RGB, &rgb));
+  bench_led (mockname, led);
+  g_assert_finalize_object (led);
+}
+
+
+static void
+bench_fbd_dev_led_flash (FbdUmockdevFixture *fixture, gconstpointer mockname)
+{
+  g_autoptr (GUdevClient) client = g_udev_client_new ((const char *const []){ "leds", NULL});
+  g_autoptr (GUdevDevice) dev = get_device (client, "leds");
+  g_autoptr (GError) err = NULL;
+  FbdDevLed *led;
+
+  led = fbd_dev_led_flash_new (dev, &err);
+  g_assert_no_error (err);
+
+  bench_led (mockname, led);
+  g_assert_finalize_object (led);
+}
+
+
+static void
+bench_fbd_dev_leds (FbdUmockdevFixture *fixture, gconstpointer mockname)
+{
+  g_autoptr (GError) err = NULL;
+  FbdBench claim = { "claim" }, reclaim = { "reclaim" }, release = { "release" };
+  FbdDevLeds *leds;
+  int owner;
+
+  leds = fbd_dev_leds_new (&err);
+  g_assert_no_error (err);
+  g_assert_true (fbd_dev_leds_has_led (leds, FBD_FEEDBACK_LED_COLOR_BLUE));
+
+  for (guint i = 0; i < BENCH_ITERATIONS; i++) {
+    fbd_bench_begin (&claim);
+    g_assert_true (fbd_dev_leds_claim (leds, &owner, 0, FBD_FEEDBACK_LED_COLOR_BLUE, NULL,
+                                       50, 1000 + i, NULL));
+    fbd_dev_leds_flush (leds);
+    fbd_bench_end (&claim);
+
+    fbd_bench_begin (&reclaim);
+    g_assert_true (fbd_dev_leds_claim (leds, &owner, 0, FBD_FEEDBACK_LED_COLOR_BLUE, NULL,
+                                       50, 1000 + i, NULL));
+    fbd_dev_leds_flush (leds);
+    fbd_bench_end (&reclaim);
+
+    fbd_bench_begin (&release);
+    g_assert_true (fbd_dev_leds_release (leds, &owner));
+    fbd_dev_leds_flush (leds);
+    fbd_bench_end (&release);
+
+    /* Dispatch completion callbacks */
+    while (g_main_context_iteration (NULL, FALSE));
+  }
+
+  fbd_bench_report (mockname, &claim);
+  fbd_bench_report (mockname, &reclaim);
+  fbd_bench_report (mockname, &release);
+
+  g_assert_finalize_object (leds);
+}
+
+
+static void
+bench_fbd_dev_vibra (FbdUmockdevFixture *fixture, gconstpointer mockname)
+{
+  g_autoptr (GUdevClient) client = g_udev_client_new ((const char *const []){ "input", NULL});
+  g_autoptr (GUdevDevice) dev = get_device (client, "input");
+  g_autoptr (GError) err = NULL;
+  FbdBench rumble = { "rumble" }, replay = { "replay" }, periodic = { "periodic" };
+  FbdBench stop = { "stop" };
+  FbdDevVibra *vibra;
+
+  vibra = fbd_dev_vibra_new (dev, &err);
+  g_assert_no_error (err);
+  g_assert_true (fbd_dev_vibra_get_features (vibra) & FBD_DEV_VIBRA_FEATURE_RUMBLE);
+
+  for (guint i = 0; i < BENCH_ITERATIONS; i++) {
+    fbd_bench_begin (&rumble);
+    g_assert_true (fbd_dev_vibra_rumble (vibra, 100 + i, TRUE));
+    fbd_dev_vibra_flush (vibra);
+    fbd_bench_end (&rumble);
+
+    /* Effects stay resident so this shouldn't need an upload */
+    fbd_bench_begin (&replay);
+    g_assert_true (fbd_dev_vibra_rumble (vibra, 100 + i, TRUE));
+    fbd_dev_vibra_flush (vibra);
+    fbd_bench_end (&replay);
+
+    fbd_bench_begin (&periodic);
+    g_assert_true (fbd_dev_vibra_periodic (vibra, 500 + i, 0x7FFF, 0x1000, 100));
+    fbd_dev_vibra_flush (vibra);
+    fbd_bench_end (&periodic);
+
+    fbd_bench_begin (&stop);
+    g_assert_true (fbd_dev_vibra_stop (vibra));
+    fbd_dev_vibra_flush (vibra);
+    fbd_bench_end (&stop);
+
+    while (g_main_context_iteration (NULL, FALSE));
+  }
+
+  fbd_bench_report (mockname, &rumble);
+  fbd_bench_report (mockname, &replay);
+  fbd_bench_report (mockname, &periodic);
+  fbd_bench_report (mockname, &stop);
+
+  g_assert_finalize_object (vibra);
+}
+
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  FBD_UMOCKDEV_TEST_ADD ("/feedbackd/fbd/bench/dev/led/simple",
+                         bench_fbd_dev_led,
+                         "led-simple");
+  FBD_UMOCKDEV_TEST_ADD ("/feedbackd/fbd/bench/dev/led/multicolor",
+                         bench_fbd_dev_led_multicolor,
+                         "led-multicolor");
+  FBD_UMOCKDEV_TEST_ADD ("/feedbackd/fbd/bench/dev/led/flash",
+                         bench_fbd_dev_led_flash,
+                         "led-flash");
+  FBD_UMOCKDEV_TEST_ADD ("/feedbackd/fbd/bench/dev/led/hw-pattern",
+                         bench_fbd_dev_led,
+                         "led-qcom-simple");
+  FBD_UMOCKDEV_TEST_ADD ("/feedbackd/fbd/bench/dev/led/hw-pattern-multicolor",
+                         bench_fbd_dev_led_multicolor,
+                         "led-qcom-multicolor");
+  FBD_UMOCKDEV_TEST_ADD ("/feedbackd/fbd/bench/dev/leds",
+                         bench_fbd_dev_leds,
+                         "led-simple");
+  FBD_UMOCKDEV_TEST_ADD ("/feedbackd/fbd/bench/dev/vibra",
+                         bench_fbd_dev_vibra,
+                         "vibra-ff");
+
+  return g_test_run();
+}
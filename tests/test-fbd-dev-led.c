@@ -9,12 +9,26 @@
 #include "fbd-dev-led.h"
 #include "fbd-dev-led-flash.h"
 #include "fbd-dev-led-multicolor.h"
-#include "fbd-dev-led-qcom.h"
-#include "fbd-dev-led-qcom-multicolor.h"
+#include "fbd-udev.h"
 
 #include "testlib.h"
 
 
+static char *
+read_sysfs_attr (GUdevDevice *dev, const char *name)
+{
+  g_autofree char *path = NULL;
+  g_autoptr (GError) err = NULL;
+  char *contents = NULL;
+
+  path = g_build_filename (g_udev_device_get_sysfs_path (dev), name, NULL);
+  g_file_get_contents (path, &contents, NULL, &err);
+  g_assert_no_error (err);
+
+  return contents;
+}
+
+
 static void
 test_fbd_dev_led_simple (FbdUmockdevFixture *fixture, gconstpointer unused)
 {
@@ -105,6 +119,7 @@ test_fbd_dev_led_qcom_simple (FbdUmockdevFixture *fixture, gconstpointer unused)
   g_autolist (GUdevDevice) leds = NULL;
   FbdDevLed *led;
   g_autoptr (GError) err = NULL;
+  g_autofree char *pattern = NULL;
   GUdevDevice *dev;
 
   client = g_udev_client_new ((const char *const []){ "leds", NULL});
@@ -116,11 +131,13 @@ test_fbd_dev_led_qcom_simple (FbdUmockdevFixture *fixture, gconstpointer unused)
 
   g_assert_cmpstr (g_udev_device_get_property (dev, "FEEDBACKD_TYPE"), ==, "led");
 
-  led = fbd_dev_led_qcom_new (dev, &err);
+  led = fbd_dev_led_new (dev, &err);
   g_assert_no_error (err);
   g_assert_cmpint (fbd_dev_led_get_max_brightness (led), ==, 511);
   g_assert_true (fbd_dev_led_supports_color (led, FBD_FEEDBACK_LED_COLOR_WHITE));
   g_assert_true (fbd_dev_led_start_periodic (led, 50, 50));
+  pattern = read_sysfs_attr (dev, "hw_pattern");
+  g_assert_cmpstr (pattern, ==, "0 511 0 0 255 511 255 0\n");
   g_assert_finalize_object (led);
 }
 
@@ -132,6 +149,7 @@ test_fbd_dev_led_qcom_multicolor (FbdUmockdevFixture *fixture, gconstpointer unu
   g_autolist (GUdevDevice) leds = NULL;
   FbdDevLed *led;
   g_autoptr (GError) err = NULL;
+  g_autofree char *pattern = NULL;
   GUdevDevice *dev;
 
   client = g_udev_client_new ((const char *const []){ "leds", NULL});
@@ -143,11 +161,120 @@ test_fbd_dev_led_qcom_multicolor (FbdUmockdevFixture *fixture, gconstpointer unu
 
   g_assert_cmpstr (g_udev_device_get_property (dev, "FEEDBACKD_TYPE"), ==, "led");
 
-  led = fbd_dev_led_qcom_multicolor_new (dev, &err);
+  led = fbd_dev_led_multicolor_new (dev, &err);
   g_assert_no_error (err);
   g_assert_cmpint (fbd_dev_led_get_max_brightness (led), ==, 511);
   g_assert_true (fbd_dev_led_supports_color (led, FBD_FEEDBACK_LED_COLOR_BLUE));
   g_assert_true (fbd_dev_led_start_periodic (led, 50, 50));
+  pattern = read_sysfs_attr (dev, "hw_pattern");
+  g_assert_cmpstr (pattern, ==, "0 511 0 0 255 511 255 0\n");
+
+  g_assert_finalize_object (led);
+}
+
+
+static void
+test_fbd_dev_led_pattern (FbdUmockdevFixture *fixture, gconstpointer unused)
+{
+  GUdevClient *client;
+  g_autolist (GUdevDevice) leds = NULL;
+  FbdDevLed *led;
+  g_autoptr (GError) err = NULL;
+  g_autofree char *pattern = NULL;
+  FbdDevLedBlink blinks[] = { { 50, 500 }, { 100, 1000 } };
+
+  client = g_udev_client_new ((const char *const []){ "leds", NULL});
+  leds = g_udev_client_query_by_subsystem (client, "leds");
+  g_assert_cmpint (g_list_length (leds), ==, 1);
+
+  led = fbd_dev_led_new (G_UDEV_DEVICE (leds->data), &err);
+  g_assert_no_error (err);
+
+  /* All blinks end up in a single pattern */
+  g_assert_true (fbd_dev_led_start_pattern (led, blinks, G_N_ELEMENTS (blinks)));
+  pattern = read_sysfs_attr (G_UDEV_DEVICE (leds->data), "pattern");
+  g_assert_cmpstr (pattern, ==, "0 1000 127 1000 0 500 255 500\n");
+
+  g_assert_finalize_object (led);
+}
+
+
+static void
+test_fbd_dev_led_qcom_pattern (FbdUmockdevFixture *fixture, gconstpointer unused)
+{
+  GUdevClient *client;
+  g_autolist (GUdevDevice) leds = NULL;
+  FbdDevLed *led;
+  g_autoptr (GError) err = NULL;
+  g_autofree char *pattern = NULL;
+  FbdDevLedBlink blinks[] = { { 50, 500 }, { 100, 1000 } };
+  FbdDevLedBlink fast[] = { { 50, 500 }, { 100, 25000 } };
+
+  client = g_udev_client_new ((const char *const []){ "leds", NULL});
+  leds = g_udev_client_query_by_subsystem (client, "leds");
+  g_assert_cmpint (g_list_length (leds), ==, 1);
+
+  led = fbd_dev_led_new (G_UDEV_DEVICE (leds->data), &err);
+  g_assert_no_error (err);
+
+  /* Pauses are capped at 511ms and all blinks share one time step */
+  g_assert_true (fbd_dev_led_start_pattern (led, blinks, G_N_ELEMENTS (blinks)));
+  pattern = read_sysfs_attr (G_UDEV_DEVICE (leds->data), "hw_pattern");
+  g_assert_cmpstr (pattern, ==, "0 500 0 0 255 500 255 0 0 500 0 0 511 500 511 0\n");
+  g_clear_pointer (&pattern, g_free);
+
+  /* A 20ms blink doesn't fit a common time step, only the top one is shown */
+  g_assert_true (fbd_dev_led_start_pattern (led, fast, G_N_ELEMENTS (fast)));
+  pattern = read_sysfs_attr (G_UDEV_DEVICE (leds->data), "hw_pattern");
+  g_assert_cmpstr (pattern, ==, "0 511 0 0 255 511 255 0\n");
+
+  g_assert_finalize_object (led);
+}
+
+
+static void
+test_fbd_dev_led_unchanged (FbdUmockdevFixture *fixture, gconstpointer unused)
+{
+  GUdevClient *client;
+  g_autolist (GUdevDevice) leds = NULL;
+  FbdDevLed *led;
+  g_autoptr (GError) err = NULL;
+  g_autofree char *brightness = NULL;
+  g_autofree char *intensity = NULL;
+  FbdLedRgbColor rgb = { 10, 20, 30 };
+  GUdevDevice *dev;
+
+  client = g_udev_client_new ((const char *const []){ "leds", NULL});
+  leds = g_udev_client_query_by_subsystem (client, "leds");
+  g_assert_cmpint (g_list_length (leds), ==, 1);
+  dev = G_UDEV_DEVICE (leds->data);
+
+  led = fbd_dev_led_multicolor_new (dev, &err);
+  g_assert_no_error (err);
+
+  g_assert_true (fbd_dev_led_set_color (led, FBD_FEEDBACK_LED_COLOR_RGB, &rgb));
+  g_assert_true (fbd_dev_led_start_periodic (led, 50, 1000));
+
+  /* Showing the same state again doesn't touch the hardware */
+  fbd_udev_set_sysfs_path_attr_as_string (dev, "brightness", "1", &err);
+  g_assert_no_error (err);
+  g_assert_true (fbd_dev_led_set_color (led, FBD_FEEDBACK_LED_COLOR_RGB, &rgb));
+  g_assert_true (fbd_dev_led_start_periodic (led, 50, 1000));
+  brightness = read_sysfs_attr (dev, "brightness");
+  g_assert_cmpstr (brightness, ==, "1");
+
+  /* Turning the LED off forgets the state */
+  g_assert_true (fbd_dev_led_set_brightness (led, 0));
+  g_assert_true (fbd_dev_led_set_color (led, FBD_FEEDBACK_LED_COLOR_RGB, &rgb));
+  g_clear_pointer (&brightness, g_free);
+  brightness = read_sysfs_attr (dev, "brightness");
+  g_assert_cmpstr (brightness, ==, "248");
+
+  /* A different color is written */
+  rgb.b = 40;
+  g_assert_true (fbd_dev_led_set_color (led, FBD_FEEDBACK_LED_COLOR_RGB, &rgb));
+  intensity = read_sysfs_attr (dev, "multi_intensity");
+  g_assert_cmpstr (intensity, ==, "40 20 10\n");
 
   g_assert_finalize_object (led);
 }
@@ -173,6 +300,15 @@ main (gint argc, gchar *argv[])
   FBD_UMOCKDEV_TEST_ADD ("/feedbackd/fbd/dev/led/qcom/multicolor",
                          test_fbd_dev_led_qcom_multicolor,
                          "led-qcom-multicolor");
+  FBD_UMOCKDEV_TEST_ADD ("/feedbackd/fbd/dev/led/pattern",
+                         test_fbd_dev_led_pattern,
+                         "led-simple");
+  FBD_UMOCKDEV_TEST_ADD ("/feedbackd/fbd/dev/led/qcom/pattern",
+                         test_fbd_dev_led_qcom_pattern,
+                         "led-qcom-simple");
+  FBD_UMOCKDEV_TEST_ADD ("/feedbackd/fbd/dev/led/unchanged",
+                         test_fbd_dev_led_unchanged,
+                         "led-multicolor");
 
   return g_test_run();
 }
@@ -38,22 +38,64 @@ test_fbd_feedback_led_color_string_to_color (void)
 {
   FbdLedRgbColor rgb = { 0 };
 
-  g_assert_cmpint (color_string_to_color ("red", FALSE, NULL), ==, FBD_FEEDBACK_LED_COLOR_RED);
+  g_assert_cmpint (color_string_to_color ("red", NULL), ==, FBD_FEEDBACK_LED_COLOR_RED);
 
-  g_assert_cmpint (color_string_to_color ("#11aaBB", FALSE, &rgb), ==, FBD_FEEDBACK_LED_COLOR_RGB);
+  g_assert_cmpint (color_string_to_color ("#11aaBB", &rgb), ==, FBD_FEEDBACK_LED_COLOR_RGB);
   g_assert_cmpint (rgb.r, ==, 0x11);
   g_assert_cmpint (rgb.g, ==, 0xaa);
   g_assert_cmpint (rgb.b, ==, 0xbb);
 
-  g_assert_cmpint (color_string_to_color ("#00FF00", FALSE, &rgb), ==, FBD_FEEDBACK_LED_COLOR_RGB);
+  g_assert_cmpint (color_string_to_color ("#00FF00", &rgb), ==, FBD_FEEDBACK_LED_COLOR_RGB);
   g_assert_cmpint (rgb.r, ==, 0x00);
   g_assert_cmpint (rgb.g, ==, 0xFF);
   g_assert_cmpint (rgb.b, ==, 0x00);
+}
 
-  g_assert_cmpint (color_string_to_color ("#00FF00", TRUE, &rgb), ==, FBD_FEEDBACK_LED_COLOR_FLASH);
-  g_assert_cmpint (rgb.r, ==, 0x00);
-  g_assert_cmpint (rgb.g, ==, 0xFF);
-  g_assert_cmpint (rgb.b, ==, 0x00);
+
+static void
+test_fbd_feedback_led_pattern (void)
+{
+  g_autoptr (FbdFeedbackLed) led = NULL;
+
+  led = g_object_new (FBD_TYPE_FEEDBACK_LED,
+                      "color", "blue",
+                      "pattern", "0 1000 100 1000",
+                      "curve", FBD_LED_PATTERN_CURVE_SINE,
+                      NULL);
+  g_assert_nonnull (led->pattern);
+  g_assert_cmpint (fbd_led_pattern_get_period (led->pattern), ==, 2000);
+  /* Blinking falls back to the pattern's pace */
+  g_assert_cmpint (led->frequency, ==, 500);
+}
+
+
+static void
+test_fbd_feedback_led_shared_settings (void)
+{
+  FbdFeedbackLed *led1, *led2;
+
+  led1 = g_object_new (FBD_TYPE_FEEDBACK_LED, "color", "#00ff00", NULL);
+  led2 = g_object_new (FBD_TYPE_FEEDBACK_LED, "color", "red", NULL);
+
+  /* Colors are parsed on construction */
+  g_assert_cmpint (led1->color_type, ==, FBD_FEEDBACK_LED_COLOR_RGB);
+  g_assert_cmpint (led1->rgb.g, ==, 0xFF);
+  g_assert_cmpint (led2->color_type, ==, FBD_FEEDBACK_LED_COLOR_RED);
+
+  g_assert_true (led1->settings == led2->settings);
+  g_assert_true (led1->settings == shared_settings);
+
+  g_settings_set_boolean (led1->settings, "prefer-flash", TRUE);
+  while (!prefer_flash)
+    g_main_context_iteration (NULL, TRUE);
+  g_settings_set_boolean (led1->settings, "prefer-flash", FALSE);
+  while (prefer_flash)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_finalize_object (led1);
+  g_assert_nonnull (shared_settings);
+  g_assert_finalize_object (led2);
+  g_assert_null (shared_settings);
 }
 
 
@@ -65,6 +107,9 @@ main (gint argc, gchar *argv[])
   g_test_add_func("/feedbackd/fbd/feedback-led/parse-color", test_fbd_feedback_led_parse_color);
   g_test_add_func("/feedbackd/fbd/feedback-led/color-string-to-color",
                   test_fbd_feedback_led_color_string_to_color);
+  g_test_add_func("/feedbackd/fbd/feedback-led/pattern", test_fbd_feedback_led_pattern);
+  g_test_add_func("/feedbackd/fbd/feedback-led/shared-settings",
+                  test_fbd_feedback_led_shared_settings);
 
   return g_test_run();
 }
@@ -55,6 +55,7 @@ test_fbd_feedback_profile_parse (void)
   const char *json ="                             "
         "    {                                    "
         "      \"name\" : \"full\",               "
+        "      \"vibra-gain\" : 60,               "
         "      \"feedbacks\" : [                  "
         "        {                                "
         "          \"type\" : \"vibra\",          "
@@ -79,6 +80,7 @@ test_fbd_feedback_profile_parse (void)
   g_assert_true (FBD_IS_FEEDBACK_DUMMY(fb));
   fb = fbd_feedback_profile_get_feedback (profile, "event1");
   g_assert_true (FBD_IS_FEEDBACK_VIBRA(fb));
+  g_assert_cmpuint (fbd_feedback_profile_get_vibra_gain (profile), ==, 60);
 }
 
 
@@ -110,7 +112,13 @@ test_fbd_feedback_profile_update (void)
   fbd_feedback_profile_add_feedback (b, FBD_FEEDBACK_BASE(fb_b_1));
   fbd_feedback_profile_add_feedback (b, FBD_FEEDBACK_BASE(fb_b_2));
 
+  /* Unset gain doesn't override, set one does */
+  g_object_set (a, "vibra-gain", 50, NULL);
   fbd_feedback_profile_update (a,b);
+  g_assert_cmpuint (fbd_feedback_profile_get_vibra_gain (a), ==, 50);
+  g_object_set (b, "vibra-gain", 70, NULL);
+  fbd_feedback_profile_update (a,b);
+  g_assert_cmpuint (fbd_feedback_profile_get_vibra_gain (a), ==, 70);
 
   fb = fbd_feedback_profile_get_feedback (a, "a-1");
   g_assert_true (FBD_IS_FEEDBACK_DUMMY(fb));
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#include "fbd-io-worker.h"
+
+#include <gio/gio.h>
+
+typedef struct {
+  GMutex   gate;
+  GString *log;         /* only touched by the worker thread */
+  guint    n_done;
+  guint    n_cancelled;
+} TestData;
+
+typedef struct {
+  TestData *td;
+  char      id;
+} TestCmd;
+
+
+static gboolean
+record_cmd (gpointer data, GError **error)
+{
+  TestCmd *cmd = data;
+
+  /* Block the worker until the test opens the gate */
+  if (cmd->id == 'g') {
+    g_mutex_lock (&cmd->td->gate);
+    g_mutex_unlock (&cmd->td->gate);
+  }
+
+  g_string_append_c (cmd->td->log, cmd->id);
+  return TRUE;
+}
+
+
+static void
+on_cmd_done (gpointer data, const GError *error)
+{
+  TestCmd *cmd = data;
+
+  cmd->td->n_done++;
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    cmd->td->n_cancelled++;
+  else
+    g_assert_no_error (error);
+}
+
+
+static void
+push_cmd (FbdIoWorker *worker, TestData *td, gconstpointer key, char id)
+{
+  TestCmd *cmd = g_new0 (TestCmd, 1);
+
+  cmd->td = td;
+  cmd->id = id;
+  fbd_io_worker_push (worker, key, record_cmd, on_cmd_done, cmd, g_free);
+}
+
+
+static void
+test_fbd_io_worker_coalesce (void)
+{
+  g_autoptr (FbdIoWorker) worker = fbd_io_worker_new ("test-io");
+  TestData td = { 0 };
+  int key;
+
+  g_mutex_init (&td.gate);
+  td.log = g_string_new (NULL);
+
+  g_mutex_lock (&td.gate);
+  push_cmd (worker, &td, NULL, 'g');
+  push_cmd (worker, &td, &key, 'a');
+  push_cmd (worker, &td, NULL, 'b');
+  /* Replaces 'a' */
+  push_cmd (worker, &td, &key, 'c');
+  g_mutex_unlock (&td.gate);
+
+  fbd_io_worker_flush (worker);
+  g_assert_cmpstr (td.log->str, ==, "gcb");
+
+  /* Completions are delivered via the main context */
+  while (td.n_done < 4)
+    g_main_context_iteration (NULL, TRUE);
+  g_assert_cmpint (td.n_cancelled, ==, 1);
+
+  g_string_free (td.log, TRUE);
+  g_mutex_clear (&td.gate);
+}
+
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/feedbackd/fbd/io-worker/coalesce", test_fbd_io_worker_coalesce);
+
+  return g_test_run ();
+}
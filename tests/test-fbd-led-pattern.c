@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#include "fbd-led-pattern.h"
+
+#include <glib.h>
+
+static const FbdLedPatternLimits ramp_limits = {
+  .max_entries = 1024,
+  .min_duration_ms = 50,
+};
+
+static const FbdLedPatternLimits hold_limits = {
+  .max_entries = 24,
+  .max_duration_ms = 511,
+  .hold = TRUE,
+};
+
+
+static guint
+count_entries (const char *rendered)
+{
+  g_auto (GStrv) tokens = g_strsplit (rendered, " ", -1);
+
+  g_assert_cmpint (g_strv_length (tokens) % 2, ==, 0);
+  return g_strv_length (tokens) / 2;
+}
+
+
+static void
+test_fbd_led_pattern_parse (void)
+{
+  const char *invalid[] = { "", "0", "101 100", "0 0", "a 100", "0 100 50" };
+  g_autoptr (FbdLedPattern) pattern = NULL;
+  g_autoptr (GError) err = NULL;
+
+  pattern = fbd_led_pattern_new_from_string (" 0 1000\t100 500\n", FBD_LED_PATTERN_CURVE_LINEAR,
+                                             &err);
+  g_assert_no_error (err);
+  g_assert_nonnull (pattern);
+  g_assert_cmpint (fbd_led_pattern_get_period (pattern), ==, 1500);
+
+  for (int i = 0; i < G_N_ELEMENTS (invalid); i++) {
+    g_autoptr (FbdLedPattern) p = NULL;
+
+    p = fbd_led_pattern_new_from_string (invalid[i], FBD_LED_PATTERN_CURVE_LINEAR, &err);
+    g_assert_null (p);
+    g_assert_nonnull (err);
+    g_clear_error (&err);
+  }
+}
+
+
+static void
+test_fbd_led_pattern_ramp (void)
+{
+  g_autoptr (FbdLedPattern) linear = NULL;
+  g_autoptr (FbdLedPattern) step = NULL;
+  g_autoptr (FbdLedPattern) sine = NULL;
+
+  linear = fbd_led_pattern_new_from_string ("0 1000 100 1000", FBD_LED_PATTERN_CURVE_LINEAR, NULL);
+  g_assert_cmpstr (fbd_led_pattern_render (linear, &ramp_limits, 255), ==, "0 1000 255 1000");
+
+  step = fbd_led_pattern_new_from_string ("0 1000 100 1000", FBD_LED_PATTERN_CURVE_STEP, NULL);
+  g_assert_cmpstr (fbd_led_pattern_render (step, &ramp_limits, 255), ==,
+                   "0 1000 0 0 255 1000 255 0");
+
+  /* Curves are approximated by steps not shorter than the min duration */
+  sine = fbd_led_pattern_new_from_string ("0 400 100 400", FBD_LED_PATTERN_CURVE_SINE, NULL);
+  g_assert_cmpstr (fbd_led_pattern_render (sine, &ramp_limits, 100), ==,
+                   "0 50 4 50 15 50 31 50 50 50 69 50 85 50 96 50 "
+                   "100 50 96 50 85 50 69 50 50 50 31 50 15 50 4 50");
+}
+
+
+static void
+test_fbd_led_pattern_hold (void)
+{
+  g_autoptr (FbdLedPattern) pattern = NULL;
+  g_autoptr (FbdLedPattern) slow = NULL;
+  const char *rendered;
+
+  pattern = fbd_led_pattern_new_from_string ("0 1200 100 1200", FBD_LED_PATTERN_CURVE_LINEAR, NULL);
+  rendered = fbd_led_pattern_render (pattern, &hold_limits, 100);
+  /* Each value is held for the same time */
+  g_assert_true (g_str_has_prefix (rendered, "4 100 4 0 13 100 13 0 "));
+  g_assert_cmpint (count_entries (rendered), ==, 2 * hold_limits.max_entries);
+
+  /* Entries can't be longer than the max duration */
+  slow = fbd_led_pattern_new_from_string ("0 10000 100 10000", FBD_LED_PATTERN_CURVE_STEP, NULL);
+  rendered = fbd_led_pattern_render (slow, &hold_limits, 100);
+  g_assert_true (g_str_has_prefix (rendered, "0 511 0 0 "));
+  g_assert_cmpint (count_entries (rendered), ==, 2 * hold_limits.max_entries);
+}
+
+
+static void
+test_fbd_led_pattern_limits (void)
+{
+  const FbdLedPatternLimits tiny = { .max_entries = 2 };
+  g_autoptr (FbdLedPattern) pattern = NULL;
+
+  pattern = fbd_led_pattern_new_from_string ("0 100 50 100 100 100", FBD_LED_PATTERN_CURVE_LINEAR,
+                                             NULL);
+  g_test_expect_message ("fbd-led-pattern", G_LOG_LEVEL_WARNING, "*entries*");
+  g_assert_null (fbd_led_pattern_render (pattern, &tiny, 255));
+  g_test_assert_expected_messages ();
+}
+
+
+static void
+test_fbd_led_pattern_granularity (void)
+{
+  const FbdLedPatternLimits coarse = { .brightness_step = 64 };
+  g_autoptr (FbdLedPattern) pattern = NULL;
+
+  pattern = fbd_led_pattern_new_from_string ("0 100 50 100 100 100", FBD_LED_PATTERN_CURVE_LINEAR,
+                                             NULL);
+  /* Values are rounded to the hardware's granularity without exceeding the max */
+  g_assert_cmpstr (fbd_led_pattern_render (pattern, &coarse, 255), ==, "0 100 128 100 192 100");
+}
+
+
+static void
+test_fbd_led_pattern_sequence (void)
+{
+  g_autoptr (FbdLedPattern) breathe = NULL;
+  g_autoptr (FbdLedPattern) blink = NULL;
+  g_autoptr (FbdLedPattern) flicker = NULL;
+  g_autofree char *rendered = NULL;
+  g_auto (GStrv) tokens = NULL;
+  const guint max[] = { 255, 255 };
+
+  breathe = fbd_led_pattern_new_from_string ("0 4800 100 4800", FBD_LED_PATTERN_CURVE_SINE, NULL);
+  blink = fbd_led_pattern_new_from_string ("0 500 100 500", FBD_LED_PATTERN_CURVE_STEP, NULL);
+  flicker = fbd_led_pattern_new_from_string ("0 20 100 20", FBD_LED_PATTERN_CURVE_STEP, NULL);
+
+  /* One time step and one entry budget for the whole sequence */
+  rendered = fbd_led_pattern_render_sequence ((FbdLedPattern *[]) { breathe, blink }, max, 2,
+                                              &hold_limits);
+  g_assert_nonnull (rendered);
+  g_assert_true (g_str_has_suffix (rendered, "0 442 0 0 255 442 255 0"));
+  g_assert_cmpint (count_entries (rendered), ==, 2 * hold_limits.max_entries);
+  tokens = g_strsplit (rendered, " ", -1);
+  for (guint i = 1; tokens[i]; i += 2)
+    g_assert_cmpstr (tokens[i], ==, i % 4 == 1 ? "442" : "0");
+
+  /* The flicker can't use the blink's time step */
+  g_assert_null (fbd_led_pattern_render_sequence ((FbdLedPattern *[]) { blink, flicker }, max, 2,
+                                                  &hold_limits));
+}
+
+
+static void
+test_fbd_led_pattern_cache (void)
+{
+  g_autoptr (FbdLedPattern) pattern = NULL;
+  const char *rendered;
+
+  pattern = fbd_led_pattern_new_from_string ("0 400 100 400", FBD_LED_PATTERN_CURVE_SINE, NULL);
+  rendered = fbd_led_pattern_render (pattern, &ramp_limits, 255);
+
+  g_assert_true (fbd_led_pattern_render (pattern, &ramp_limits, 255) == rendered);
+  g_assert_false (fbd_led_pattern_render (pattern, &ramp_limits, 100) == rendered);
+  g_assert_false (fbd_led_pattern_render (pattern, &hold_limits, 255) == rendered);
+}
+
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/feedbackd/fbd/led-pattern/parse", test_fbd_led_pattern_parse);
+  g_test_add_func ("/feedbackd/fbd/led-pattern/ramp", test_fbd_led_pattern_ramp);
+  g_test_add_func ("/feedbackd/fbd/led-pattern/hold", test_fbd_led_pattern_hold);
+  g_test_add_func ("/feedbackd/fbd/led-pattern/limits", test_fbd_led_pattern_limits);
+  g_test_add_func ("/feedbackd/fbd/led-pattern/granularity", test_fbd_led_pattern_granularity);
+  g_test_add_func ("/feedbackd/fbd/led-pattern/sequence", test_fbd_led_pattern_sequence);
+  g_test_add_func ("/feedbackd/fbd/led-pattern/cache", test_fbd_led_pattern_cache);
+
+  return g_test_run();
+}
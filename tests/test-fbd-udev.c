@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#include "fbd-udev.h"
+
+#include "testlib.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+
+static char *
+read_attr (FbdUdevAttr *attr)
+{
+  g_autoptr (GError) err = NULL;
+  char *contents = NULL;
+
+  g_file_get_contents (fbd_udev_attr_get_path (attr), &contents, NULL, &err);
+  g_assert_no_error (err);
+
+  return contents;
+}
+
+/* Modify the attribute behind the handle's back, keeping the inode */
+static void
+write_attr (FbdUdevAttr *attr, const char *value)
+{
+  int fd;
+
+  fd = open (fbd_udev_attr_get_path (attr), O_WRONLY | O_TRUNC);
+  g_assert_cmpint (fd, >=, 0);
+  g_assert_cmpint (write (fd, value, strlen (value)), ==, strlen (value));
+  close (fd);
+}
+
+
+static void
+test_fbd_udev_attr (FbdUmockdevFixture *fixture, gconstpointer unused)
+{
+  g_autoptr (GUdevClient) client = NULL;
+  g_autolist (GUdevDevice) leds = NULL;
+  g_autoptr (FbdUdevAttr) attr = NULL;
+  g_autoptr (GError) err = NULL;
+  g_autofree char *value = NULL;
+
+  client = g_udev_client_new ((const char *const []){ "leds", NULL});
+  leds = g_udev_client_query_by_subsystem (client, "leds");
+  g_assert_cmpint (g_list_length (leds), ==, 1);
+
+  attr = fbd_udev_attr_new (G_UDEV_DEVICE (leds->data), "brightness");
+  g_assert_true (g_str_has_suffix (fbd_udev_attr_get_path (attr), "/brightness"));
+
+  g_assert_true (fbd_udev_attr_set_int (attr, 42, &err));
+  g_assert_no_error (err);
+  value = read_attr (attr);
+  g_assert_cmpstr (value, ==, "42");
+  g_clear_pointer (&value, g_free);
+
+  /* Writing the same value again is skipped */
+  write_attr (attr, "10");
+  g_assert_true (fbd_udev_attr_set_int (attr, 42, &err));
+  g_assert_no_error (err);
+  value = read_attr (attr);
+  g_assert_cmpstr (value, ==, "10");
+  g_clear_pointer (&value, g_free);
+
+  /* Unless the value got invalidated */
+  fbd_udev_attr_invalidate (attr);
+  g_assert_true (fbd_udev_attr_set_string (attr, "42", &err));
+  g_assert_no_error (err);
+  value = read_attr (attr);
+  g_assert_cmpstr (value, ==, "42");
+  g_clear_pointer (&value, g_free);
+
+  g_assert_true (fbd_udev_attr_set_int (attr, 17, &err));
+  g_assert_no_error (err);
+  value = read_attr (attr);
+  g_assert_cmpstr (value, ==, "17");
+}
+
+
+static void
+test_fbd_udev_attr_missing (FbdUmockdevFixture *fixture, gconstpointer unused)
+{
+  g_autoptr (GUdevClient) client = NULL;
+  g_autolist (GUdevDevice) leds = NULL;
+  g_autoptr (FbdUdevAttr) attr = NULL;
+  g_autoptr (GError) err = NULL;
+
+  client = g_udev_client_new ((const char *const []){ "leds", NULL});
+  leds = g_udev_client_query_by_subsystem (client, "leds");
+  g_assert_cmpint (g_list_length (leds), ==, 1);
+
+  attr = fbd_udev_attr_new (G_UDEV_DEVICE (leds->data), "doesnotexist");
+  g_assert_false (fbd_udev_attr_set_int (attr, 1, &err));
+  g_assert_error (err, G_IO_ERROR, G_IO_ERROR_FAILED);
+}
+
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  FBD_UMOCKDEV_TEST_ADD ("/feedbackd/fbd/udev/attr",
+                         test_fbd_udev_attr,
+                         "led-simple");
+  FBD_UMOCKDEV_TEST_ADD ("/feedbackd/fbd/udev/attr/missing",
+                         test_fbd_udev_attr_missing,
+                         "led-simple");
+
+  return g_test_run();
+}